@@ -0,0 +1,159 @@
+#include "corpus.hpp"
+#include <filesystem>
+#include <fstream>
+
+std::string generateWide(size_t members) {
+    std::string out;
+    for (size_t i = 0; i < members; i++) {
+        switch (i % 4) {
+            case 0: out += "key" + std::to_string(i) + " = " + std::to_string(i) + "\n"; break;
+            case 1: out += "key" + std::to_string(i) + " = \"value " + std::to_string(i) + "\"\n"; break;
+            case 2: out += "key" + std::to_string(i) + " : " + std::to_string(i) + ".25\n"; break;
+            case 3: out += "key" + std::to_string(i) + " = true\n"; break;
+        }
+    }
+    return out;
+}
+
+std::string generateDeep(size_t chains, size_t depth) {
+    std::string out;
+    for (size_t c = 0; c < chains; c++) {
+        out += "chain" + std::to_string(c) + " ";
+        for (size_t d = 0; d < depth; d++) {
+            out += "{ level" + std::to_string(d) + " = " + std::to_string(d) + ", next ";
+        }
+        out += "{ leaf = end }";
+        for (size_t d = 0; d < depth; d++) {
+            out += " }";
+        }
+        out += "\n";
+    }
+    return out;
+}
+
+std::string generateLongArrays(size_t arrays, size_t length) {
+    std::string out;
+    for (size_t a = 0; a < arrays; a++) {
+        out += "array" + std::to_string(a) + " = [\n";
+        for (size_t i = 0; i < length; i++) {
+            if (i % 8 == 7) {
+                out += "    { id = " + std::to_string(i) + ", name = item" + std::to_string(i) + " },\n";
+            } else {
+                out += "    " + std::to_string(i * 3) + ",\n";
+            }
+        }
+        out += "]\n";
+    }
+    return out;
+}
+
+std::string generateConcatenation(size_t members) {
+    std::string out;
+    for (size_t i = 0; i < members; i++) {
+        out += "text" + std::to_string(i) + " = the quick " + std::to_string(i) + " brown \"fox\" jumps 1.5 over\n";
+    }
+    return out;
+}
+
+std::string generateSubstitutions(size_t members) {
+    std::string out = "base {\n";
+    for (size_t i = 0; i < 100; i++) {
+        out += "    value" + std::to_string(i) + " = " + std::to_string(i) + "\n";
+    }
+    out += "    host = example.org\n}\n";
+    for (size_t i = 0; i < members; i++) {
+        switch (i % 3) {
+            case 0: out += "ref" + std::to_string(i) + " = ${base.value" + std::to_string(i % 100) + "}\n"; break;
+            case 1: out += "ref" + std::to_string(i) + " = ${base.host} port ${base.value" + std::to_string(i % 100) + "}\n"; break;
+            case 2: out += "ref" + std::to_string(i) + " = ${?missing" + std::to_string(i) + "}\n"; break;
+        }
+    }
+    return out;
+}
+
+std::string generateSelfReferential(size_t keys, size_t appends) {
+    std::string out = "data {\n"; // += is only accepted inside an object.
+    for (size_t k = 0; k < keys; k++) {
+        out += "    list" + std::to_string(k) + " = [start]\n";
+        out += "    path" + std::to_string(k) + " = root\n";
+    }
+    for (size_t a = 0; a < appends; a++) {
+        for (size_t k = 0; k < keys; k++) {
+            out += "    list" + std::to_string(k) + " += [" + std::to_string(a) + "]\n";
+            out += "    path" + std::to_string(k) + " = ${data.path" + std::to_string(k) + "}/" + std::to_string(a) + "\n";
+        }
+    }
+    return out + "}\n";
+}
+
+std::string generateIncludeFanOut(size_t files, size_t membersPerFile, std::string const& directory) {
+    std::string out;
+    for (size_t f = 0; f < files; f++) {
+        std::string name = directory + "/bench_include_" + std::to_string(f) + ".conf";
+        std::ofstream file(name, std::ios::trunc);
+        file << "{\n";
+        for (size_t i = 0; i < membersPerFile; i++) {
+            file << "    a" << i << " = " << i << "\n";
+            file << "    b" << i << " = value" << i << "\n";
+        }
+        file << "}";
+        out += "included" + std::to_string(f) + " = { include file(\"" + name + "\") }\n";
+    }
+    return out;
+}
+
+static void appendNested(std::string& out, size_t width, size_t depth, size_t& counter) {
+    if (depth == 0) {
+        out += "{ i = " + std::to_string(counter) + ", s = \"text " + std::to_string(counter) + "\" }";
+        counter++;
+        return;
+    }
+    out += "{\n";
+    for (size_t i = 0; i < width; i++) {
+        out += "k" + std::to_string(i) + " ";
+        appendNested(out, width, depth - 1, counter);
+        out += "\n";
+    }
+    out += "}";
+}
+
+std::string generateNested(size_t width, size_t depth) {
+    std::string out;
+    size_t counter = 0;
+    appendNested(out, width, depth, counter);
+    return out;
+}
+
+/*
+    The self referential corpus grows in keys rather than in appends: resolving a chain of n appends to the same key
+    currently takes time exponential in n, so longer chains would only measure that.
+*/
+std::vector<Corpus> generateCorpora(size_t scale, std::string const& includeDirectory) {
+    std::vector<Corpus> corpora = {
+        {"wide", generateWide(50000 * scale)},
+        {"deep", generateDeep(40 * scale, 100)},
+        {"long_arrays", generateLongArrays(4, 40000 * scale)},
+        {"concatenation", generateConcatenation(20000 * scale)},
+        {"substitutions", generateSubstitutions(10000 * scale)},
+        {"self_referential", generateSelfReferential(10 * scale, 10)},
+        {"include_fan_out", generateIncludeFanOut(200 * scale, 100, includeDirectory)},
+    };
+    for (auto const& entry : std::filesystem::directory_iterator(includeDirectory)) {
+        corpora.back().includedBytes += entry.file_size();
+    }
+    return corpora;
+}
+
+size_t countNodes(std::variant<HTree*, HArray*, HSimpleValue*, HSubstitution*> const& value) {
+    size_t count = 1;
+    if (std::holds_alternative<HTree*>(value)) {
+        for (auto const& member : std::get<HTree*>(value)->members) {
+            count += countNodes(member.second);
+        }
+    } else if (std::holds_alternative<HArray*>(value)) {
+        for (auto const& element : std::get<HArray*>(value)->elements) {
+            count += countNodes(element);
+        }
+    }
+    return count;
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <hocon-p.hpp>
+#include <string>
+#include <variant>
+#include <vector>
+
+/*
+    Synthetic configurations for the benchmarks. Every generator is deterministic, so the same scale always produces the
+    same text and results stay comparable across versions. Corpora grow linearly with the scale.
+*/
+struct Corpus {
+    std::string name;
+    std::string text;
+    size_t includedBytes = 0; // size of the files the text includes.
+};
+
+std::string generateWide(size_t members);                       // one object with many scalar members.
+std::string generateDeep(size_t chains, size_t depth);          // many object chains nested depth levels deep.
+std::string generateLongArrays(size_t arrays, size_t length);   // a few arrays of scalars and small objects.
+std::string generateConcatenation(size_t members);              // values concatenated from several tokens.
+std::string generateSubstitutions(size_t members);              // members that mostly reference other members.
+std::string generateSelfReferential(size_t keys, size_t appends); // keys extended over and over with +=.
+// a root that includes files fan-out wide files, written to directory like the tests/*.conf fixtures.
+std::string generateIncludeFanOut(size_t files, size_t membersPerFile, std::string const& directory);
+
+// objects nested depth levels deep with width members each, ending in { i = <int>, s = <string> } leaves.
+std::string generateNested(size_t width, size_t depth);
+
+std::vector<Corpus> generateCorpora(size_t scale, std::string const& includeDirectory);
+
+size_t countNodes(std::variant<HTree*, HArray*, HSimpleValue*, HSubstitution*> const& value);
@@ -0,0 +1,255 @@
+#include "corpus.hpp"
+#include <reader.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <optional>
+#include <thread>
+
+/*
+    Getter latency benchmark. For every configuration shape and format, each getter is timed call by call on one thread
+    and then on N threads reading the same ConfigFile at once. One JSON object per shape, format, getter and thread
+    count is printed on its own line, for example:
+
+        {"version":"1.0","config":"w32_d3","format":"hocon","op":"getIntByPath","threads":1,"samples":200000,
+         "p50_ns":301,"p99_ns":652,"p999_ns":1493,"allocs_per_op":4.00}
+
+    Latencies include reading the clock twice, which is reported once as timer_ns. allocs_per_op counts calls to the
+    global operator new, which this file replaces with a counting one.
+
+    usage: bench_lookup [--threads N] [--samples N]
+*/
+
+#ifndef HOCON_VERSION
+#define HOCON_VERSION "unknown"
+#endif
+
+static thread_local size_t allocations = 0;
+
+/*
+    The replaced operators only call these, which are never inlined: otherwise the compiler sees memory from operator
+    new reach free, and warns about a mismatched deallocation (-Wmismatched-new-delete).
+*/
+[[gnu::noinline]] static void * countedAlloc(size_t size) {
+    allocations++;
+    if (void * ptr = std::malloc(size ? size : 1)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+[[gnu::noinline]] static void countedFree(void * ptr) noexcept {
+    std::free(ptr);
+}
+
+void * operator new(size_t size) {
+    return countedAlloc(size);
+}
+
+void * operator new[](size_t size) {
+    return countedAlloc(size);
+}
+
+void operator delete(void * ptr) noexcept {
+    countedFree(ptr);
+}
+
+void operator delete[](void * ptr) noexcept {
+    countedFree(ptr);
+}
+
+void operator delete(void * ptr, size_t) noexcept {
+    countedFree(ptr);
+}
+
+void operator delete[](void * ptr, size_t) noexcept {
+    countedFree(ptr);
+}
+
+struct LookupPaths {
+    std::vector<std::string> ints;      // k.k.i
+    std::vector<std::string> strings;   // k.k.s
+    std::vector<std::string> objects;   // k.k
+    std::vector<std::string> missing;   // k.k.missing
+    std::vector<ConfigPath> handles;    // compiled from ints.
+    std::optional<ConfigView> root;     // view of the config being measured.
+};
+
+struct LookupOp {
+    std::string name;
+    bool compiledSupported;
+    std::function<size_t(ConfigFile const&, LookupPaths const&, size_t)> run; // returns something to keep the call alive.
+};
+
+const size_t PATH_COUNT = 1024;
+
+static LookupPaths makePaths(size_t width, size_t depth) {
+    LookupPaths paths;
+    uint64_t state = 0x9E3779B97F4A7C15ull;
+    for (size_t p = 0; p < PATH_COUNT; p++) {
+        std::string prefix;
+        for (size_t d = 0; d < depth; d++) {
+            state = state * 6364136223846793005ull + 1442695040888963407ull;
+            prefix += (d ? ".k" : "k") + std::to_string((state >> 33) % width);
+        }
+        paths.ints.push_back(prefix + ".i");
+        paths.strings.push_back(prefix + ".s");
+        paths.objects.push_back(prefix);
+        paths.missing.push_back(prefix + ".missing");
+    }
+    return paths;
+}
+
+static std::vector<LookupOp> makeOps() {
+    return {
+        {"getIntByPath", true, [](ConfigFile const& c, LookupPaths const& p, size_t i) { return (size_t) c.getIntByPath(p.ints[i]); }},
+        {"getStringByPath", true, [](ConfigFile const& c, LookupPaths const& p, size_t i) { return c.getStringByPath(p.strings[i]).size(); }},
+        {"pathExists", true, [](ConfigFile const& c, LookupPaths const& p, size_t i) { return (size_t) c.pathExists(p.objects[i]); }},
+        {"pathExists_miss", true, [](ConfigFile const& c, LookupPaths const& p, size_t i) { return (size_t) c.pathExists(p.missing[i]); }},
+        {"getIntByPath_miss_catch", true, [](ConfigFile const& c, LookupPaths const& p, size_t i) {
+            try {
+                return (size_t) c.getIntByPath(p.missing[i]);
+            } catch (std::exception const&) {
+                return (size_t) 0;
+            }
+        }},
+        {"tryGetIntByPath", true, [](ConfigFile const& c, LookupPaths const& p, size_t i) { return (size_t) c.tryGetIntByPath(p.ints[i]).value_or(0); }},
+        {"tryGetIntByPath_miss", true, [](ConfigFile const& c, LookupPaths const& p, size_t i) { return (size_t) c.tryGetIntByPath(p.missing[i]).value_or(0); }},
+        {"getConfig", false, [](ConfigFile const& c, LookupPaths const& p, size_t i) { return (size_t) c.getConfig(p.objects[i]).pathExists("i"); }},
+        {"getView", true, [](ConfigFile const&, LookupPaths const& p, size_t i) { return (size_t) p.root->getView(p.objects[i]).pathExists("i"); }},
+        {"getIntByPath_handle", true, [](ConfigFile const& c, LookupPaths const& p, size_t i) { return (size_t) c.getIntByPath(p.handles[i]); }},
+    };
+}
+
+struct ThreadResult {
+    std::vector<uint32_t> latencies;
+    size_t allocations = 0;
+    size_t sink = 0;
+};
+
+static void runReader(ConfigFile const& config, LookupPaths const& paths, LookupOp const& op, size_t samples, size_t offset,
+                      std::atomic<bool>& go, ThreadResult& result) {
+    result.latencies.reserve(samples);
+    while (!go.load()) {
+        std::this_thread::yield();
+    }
+    size_t before = allocations;
+    for (size_t s = 0; s < samples; s++) {
+        size_t index = (s + offset) % PATH_COUNT;
+        auto start = std::chrono::steady_clock::now();
+        result.sink += op.run(config, paths, index);
+        auto end = std::chrono::steady_clock::now();
+        result.latencies.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+    }
+    result.allocations = allocations - before;
+}
+
+static uint32_t percentile(std::vector<uint32_t> const& sorted, double p) {
+    return sorted[std::min(sorted.size() - 1, (size_t) (p * sorted.size()))];
+}
+
+static void measure(std::string const& name, std::string const& format, ConfigFile const& config, LookupPaths const& paths,
+                    LookupOp const& op, size_t threads, size_t samples) {
+    std::vector<ThreadResult> results(threads);
+    std::vector<std::thread> readers;
+    std::atomic<bool> go{false};
+    for (size_t t = 0; t < threads; t++) {
+        readers.emplace_back(runReader, std::cref(config), std::cref(paths), std::cref(op), samples, t * 97, std::ref(go), std::ref(results[t]));
+    }
+    go.store(true);
+    for (auto& reader : readers) {
+        reader.join();
+    }
+    std::vector<uint32_t> all;
+    size_t totalAllocations = 0;
+    for (auto const& result : results) {
+        all.insert(all.end(), result.latencies.begin(), result.latencies.end());
+        totalAllocations += result.allocations;
+    }
+    std::sort(all.begin(), all.end());
+    std::printf("{\"version\":\"%s\",\"config\":\"%s\",\"format\":\"%s\",\"op\":\"%s\",\"threads\":%zu,\"samples\":%zu,"
+        "\"p50_ns\":%u,\"p99_ns\":%u,\"p999_ns\":%u,\"allocs_per_op\":%.2f}\n",
+        HOCON_VERSION, name.c_str(), format.c_str(), op.name.c_str(), threads, all.size(), percentile(all, 0.5),
+        percentile(all, 0.99), percentile(all, 0.999), (double) totalAllocations / all.size());
+    std::fflush(stdout);
+}
+
+static uint64_t timerOverhead() {
+    std::vector<uint32_t> samples;
+    for (int i = 0; i < 100000; i++) {
+        auto start = std::chrono::steady_clock::now();
+        auto end = std::chrono::steady_clock::now();
+        samples.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+    }
+    std::sort(samples.begin(), samples.end());
+    return percentile(samples, 0.5);
+}
+
+int main(int argc, char * argv[]) {
+    size_t threads = std::max(2u, std::thread::hardware_concurrency());
+    size_t samples = 200000;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string flag = argv[i];
+        if (flag == "--threads") {
+            threads = std::max<size_t>(1, std::stoul(argv[i + 1]));
+        } else if (flag == "--samples") {
+            samples = std::max<size_t>(1, std::stoul(argv[i + 1]));
+        } else {
+            std::cerr << "usage: bench_lookup [--threads N] [--samples N]" << std::endl;
+            return 1;
+        }
+    }
+    std::printf("{\"version\":\"%s\",\"timer_ns\":%llu}\n", HOCON_VERSION, (unsigned long long) timerOverhead());
+
+    std::filesystem::path directory = std::filesystem::temp_directory_path() / "hocon-bench-lookup";
+    std::filesystem::create_directories(directory);
+    std::vector<std::pair<size_t, size_t>> shapes = {{4096, 1}, {64, 2}, {32, 3}, {4, 8}};
+    std::vector<LookupOp> ops = makeOps();
+    for (auto [width, depth] : shapes) {
+        std::string name = "w" + std::to_string(width) + "_d" + std::to_string(depth);
+        std::string source = (directory / (name + ".conf")).string();
+        std::string binary = (directory / (name + ".hcb")).string();
+        std::ofstream(source, std::ios::trunc) << generateNested(width, depth);
+
+        auto hocon = std::make_shared<ConfigFile>(source, std::make_shared<IncludeCache>());
+        if (!hocon->reload() || !hocon->writeCompiled(binary)) {
+            std::cerr << "could not load " << source << std::endl;
+            return 1;
+        }
+        auto indexed = std::make_shared<ConfigFile>(source, std::make_shared<IncludeCache>());
+        indexed->setPathIndexEnabled(true);
+        indexed->setStatsEnabled(true);
+        if (!indexed->reload() || !indexed->hasPathIndex()) {
+            std::cerr << "could not index " << source << std::endl;
+            return 1;
+        }
+        MemoryUsage memory = indexed->getStats().phaseMemory[PHASE_INDEX];
+        std::printf("{\"version\":\"%s\",\"config\":\"%s\",\"paths\":%llu,\"index_bytes\":%llu,\"total_bytes\":%llu}\n",
+            HOCON_VERSION, name.c_str(), (unsigned long long) memory.counts[MEM_PATH_INDEX],
+            (unsigned long long) memory.bytes[MEM_PATH_INDEX], (unsigned long long) memory.total());
+        auto compiled = std::make_shared<ConfigFile>(binary.data(), COMPILED);
+        for (auto const& [format, config] : {std::make_pair("hocon", hocon), std::make_pair("indexed", indexed), std::make_pair("compiled", compiled)}) {
+            LookupPaths paths = makePaths(width, depth);
+            paths.root.emplace(config);
+            for (auto const& path : paths.ints) {
+                paths.handles.push_back(config->compile(path));
+            }
+            for (auto const& op : ops) {
+                if (!op.compiledSupported && std::string(format) == "compiled") {
+                    continue;
+                }
+                measure(name, format, *config, paths, op, 1, samples);
+                measure(name, format, *config, paths, op, threads, samples);
+            }
+        }
+    }
+    std::filesystem::remove_all(directory);
+    return 0;
+}
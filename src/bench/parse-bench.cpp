@@ -0,0 +1,144 @@
+#include "corpus.hpp"
+#include <lexer.hpp>
+#include <hocon-p.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <malloc.h>
+#include <sstream>
+
+/*
+    Load-time benchmark. For every corpus the three load phases (Lexer::run, HParser::parseTokens and
+    HParser::resolveSubstitutions) are timed separately, and one JSON object per corpus and phase is printed on its own
+    line, for example:
+
+        {"version":"1.0","corpus":"wide","phase":"lex","valid":true,"bytes":955557,"tokens":250001,"nodes":50001,
+         "seconds":0.079656,"mb_per_s":12.00,"nodes_per_s":627714,"peak_rss_kb":63776}
+
+    bytes includes the files the corpus includes, seconds is the median over the repetitions and nodes counts the nodes
+    of the resolved tree. peak_rss_kb is the peak
+    resident set size reached during the phase: freed heap is trimmed and the kernel's peak reset before each phase through
+    /proc/self/clear_refs, and it is -1 where that is not supported.
+
+    usage: bench [--scale N] [--repeat N] [--corpus name]
+*/
+
+#ifndef HOCON_VERSION
+#define HOCON_VERSION "unknown"
+#endif
+
+enum BenchPhase {
+    BENCH_LEX, BENCH_PARSE, BENCH_RESOLVE, BENCH_PHASE_COUNT
+};
+
+const char * BENCH_PHASE_NAMES[BENCH_PHASE_COUNT] = {"lex", "parse", "resolve"};
+
+struct PhaseResult {
+    std::vector<double> seconds;
+    long peakRssKb = -1;
+};
+
+static bool resetPeakRss() {
+    malloc_trim(0); // return freed heap first, so memory from earlier phases does not count toward this one.
+    std::ofstream clearRefs("/proc/self/clear_refs");
+    clearRefs << "5";
+    clearRefs.flush();
+    return clearRefs.good();
+}
+
+static long readPeakRssKb() {
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.rfind("VmHWM:", 0) == 0) {
+            return std::stol(line.substr(6));
+        }
+    }
+    return -1;
+}
+
+/*
+    Runs fn as one phase.
+    @returns the elapsed seconds, recording the peak RSS of the phase in result.
+*/
+template<typename F>
+static double timePhase(PhaseResult& result, F fn) {
+    bool canReset = resetPeakRss();
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (canReset) {
+        result.peakRssKb = std::max(result.peakRssKb, readPeakRssKb());
+    }
+    result.seconds.push_back(seconds);
+    return seconds;
+}
+
+static double median(std::vector<double> values) {
+    std::sort(values.begin(), values.end());
+    return values[values.size() / 2];
+}
+
+int main(int argc, char * argv[]) {
+    size_t scale = 1;
+    size_t repeat = 5;
+    std::string only;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string flag = argv[i];
+        if (flag == "--scale") {
+            scale = std::stoul(argv[i + 1]);
+        } else if (flag == "--repeat") {
+            repeat = std::max<size_t>(1, std::stoul(argv[i + 1]));
+        } else if (flag == "--corpus") {
+            only = argv[i + 1];
+        } else {
+            std::cerr << "usage: bench [--scale N] [--repeat N] [--corpus name]" << std::endl;
+            return 1;
+        }
+    }
+
+    std::filesystem::path includeDirectory = std::filesystem::temp_directory_path() / "hocon-bench";
+    std::filesystem::create_directories(includeDirectory);
+    for (auto const& corpus : generateCorpora(scale, includeDirectory.string())) {
+        if (!only.empty() && corpus.name != only) {
+            continue;
+        }
+        PhaseResult results[BENCH_PHASE_COUNT];
+        size_t tokenCount = 0;
+        size_t nodeCount = 0;
+        bool valid = true;
+        for (size_t r = 0; r < repeat; r++) {
+            std::vector<Token> tokens;
+            Lexer lexer(corpus.text);
+            timePhase(results[BENCH_LEX], [&]() { tokens = lexer.run(); });
+            tokenCount = tokens.size();
+            HParser * parser = new HParser(tokens);
+            tokens.clear();
+            timePhase(results[BENCH_PARSE], [&]() { parser->parseTokens(); });
+            timePhase(results[BENCH_RESOLVE], [&]() {
+                if (parser->validConf) parser->resolveSubstitutions();
+            });
+            valid = valid && !lexer.hasError && parser->validConf;
+            std::visit([&nodeCount](auto root) {
+                nodeCount = countNodes(root);
+                delete root;
+            }, parser->rootObject);
+            delete parser;
+        }
+        for (int phase = 0; phase < BENCH_PHASE_COUNT; phase++) {
+            double seconds = std::max(median(results[phase].seconds), 1e-9);
+            size_t bytes = corpus.text.size() + corpus.includedBytes;
+            std::printf("{\"version\":\"%s\",\"corpus\":\"%s\",\"phase\":\"%s\",\"valid\":%s,\"bytes\":%zu,\"tokens\":%zu,"
+                "\"nodes\":%zu,\"seconds\":%.6f,\"mb_per_s\":%.2f,\"nodes_per_s\":%.0f,\"peak_rss_kb\":%ld}\n",
+                HOCON_VERSION, corpus.name.c_str(), BENCH_PHASE_NAMES[phase], valid ? "true" : "false", bytes,
+                tokenCount, nodeCount, seconds, bytes / seconds / 1e6, nodeCount / seconds,
+                results[phase].peakRssKb);
+        }
+        std::fflush(stdout);
+    }
+    std::filesystem::remove_all(includeDirectory);
+    return 0;
+}
@@ -0,0 +1,33 @@
+#include "diagnostic.hpp"
+
+const char * diagnosticCodeName(DiagnosticCode code) {
+    static const char * names[] = {"io", "lex", "parse", "json", "include", "substitution"};
+    return names[code];
+}
+
+std::string Diagnostic::str() const {
+    std::string out = file.empty() ? "<input>" : file;
+    if (line > 0) {
+        out += ":" + std::to_string(line);
+    }
+    return out + ": " + diagnosticCodeName(code) + " error: " + message;
+}
+
+void locateDiagnostics(std::vector<Diagnostic>& diagnostics, size_t first, std::string const& file, std::string_view source) {
+    std::vector<size_t> lineStarts;
+    for (size_t i = first; i < diagnostics.size(); i++) {
+        Diagnostic& diagnostic = diagnostics[i];
+        if (diagnostic.offset != NO_OFFSET || diagnostic.line <= 0 || diagnostic.file != file) {
+            continue;
+        }
+        if (lineStarts.empty()) {
+            lineStarts.push_back(0);
+            for (size_t pos = source.find('\n'); pos != std::string_view::npos; pos = source.find('\n', pos + 1)) {
+                lineStarts.push_back(pos + 1);
+            }
+        }
+        if ((size_t) diagnostic.line <= lineStarts.size()) {
+            diagnostic.offset = lineStarts[diagnostic.line - 1];
+        }
+    }
+}
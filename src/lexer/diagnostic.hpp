@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+    What stage of a load reported a diagnostic. INCLUDE covers include files that could not be read or spliced, errors
+    inside an included file carry the code of the stage that found them and the include link as their file.
+*/
+enum DiagnosticCode {
+    DIAG_IO, DIAG_LEX, DIAG_PARSE, DIAG_JSON, DIAG_INCLUDE, DIAG_SUBSTITUTION
+};
+
+const size_t NO_OFFSET = (size_t) -1;
+
+/*
+    An error found while loading a configuration. line is 1 based and 0 when the error has no position, as for most
+    substitution errors. offset is the byte offset of the error in file: exact for lexer errors, the start of the line
+    for parser errors, and NO_OFFSET when there is no line.
+*/
+struct Diagnostic {
+    DiagnosticCode code;
+    std::string message;
+    std::string file;
+    int line = 0;
+    size_t offset = NO_OFFSET;
+    std::string str() const; // "file:line: error: message", as printed by the command line tools.
+};
+
+const char * diagnosticCodeName(DiagnosticCode code);
+
+/*
+    Fills the offset of every diagnostic from index first on that was reported for file with a line but no offset, using
+    one scan of source however many diagnostics there are.
+*/
+void locateDiagnostics(std::vector<Diagnostic>& diagnostics, size_t first, std::string const& file, std::string_view source);
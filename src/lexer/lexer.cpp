@@ -1,13 +1,16 @@
 #include "lexer.hpp"
 
-Lexer::Lexer(std::string text) : length(text.length()), source(text) {}
+Lexer::Lexer(std::string text) : length(text.length()), ownedSource(text), source(ownedSource) {}
+
+Lexer::Lexer(const char * data, size_t size) : length(size), source(data, size) {}
 
 std::string Token::str() {
     return std::to_string(type) + " " + lexeme;
 }
 
 void Lexer::setSource(std::string newSource) {
-    source = newSource;
+    ownedSource = newSource;
+    source = ownedSource;
     tokens.clear();
 }
 
@@ -20,28 +23,28 @@ char Lexer::advance() {
 }
 
 void Lexer::addToken(TokenType type) {
-    std::string text = source.substr(start, current-start);
+    std::string text(source.substr(start, current-start));
     //if (type == WHITESPACE) text = "'" + text + "'"; debug
     tokens.push_back(Token(type, text, 0, line)); 
 }
 
 void Lexer::addToken(TokenType type, std::string literal) {
-    std::string text = source.substr(start, current-start);
+    std::string text(source.substr(start, current-start));
     tokens.push_back(Token(type, text, literal, line));
 }
 
 void Lexer::addToken(TokenType type, int literal) {
-    std::string text = source.substr(start, current-start);
+    std::string text(source.substr(start, current-start));
     tokens.push_back(Token(type, text, literal, line));
 }
 
 void Lexer::addToken(TokenType type, double literal) {
-    std::string text = source.substr(start, current-start);
+    std::string text(source.substr(start, current-start));
     tokens.push_back(Token(type, text, literal, line));
 }
 
 void Lexer::addToken(TokenType type, bool b) {
-    std::string text = source.substr(start, current-start);
+    std::string text(source.substr(start, current-start));
     tokens.push_back(Token(type, text, b, line));
 }
 
@@ -230,9 +233,9 @@ void Lexer::number() {
         isDouble = true;
     }
     if (isDouble) {
-            addToken(NUMBER, std::strtod(source.substr(start, current-start).c_str(), nullptr));
+            addToken(NUMBER, std::strtod(std::string(source.substr(start, current-start)).c_str(), nullptr));
     } else {
-            addToken(NUMBER, std::stoi(source.substr(start, current-start)));
+            addToken(NUMBER, std::stoi(std::string(source.substr(start, current-start))));
     }
 } 
 
@@ -337,10 +340,10 @@ void Lexer::substitution(bool optional) {
         advance();
     }
     if (optional) {
-        std::string text = source.substr(start+3, current-start-4);
+        std::string text(source.substr(start+3, current-start-4));
         addToken(SUB_OPTIONAL, text);
     } else {
-        std::string text = source.substr(start+2, current-start-3);
+        std::string text(source.substr(start+2, current-start-3));
         addToken(SUB, text);
     }
 }
@@ -381,7 +384,7 @@ void Lexer::comment() {
 
 void Lexer::keyword() {
     while (isAlpha(peek())) advance() ;
-    std::string text = source.substr(start, current - start);
+    std::string text(source.substr(start, current - start));
     if (text == "true") {
         addToken(TRUE, true);
     } else if (text == "false") {
@@ -409,11 +412,34 @@ std::vector<Token> Lexer::run() {
     return tokens;
 }
 
+/*
+    Incremental form of run(): scans only as far as the next token, so a caller that consumes tokens as they come never
+    holds more than one of them. Keeps returning the ENDFILE token once the source is exhausted.
+*/
+Token Lexer::next() {
+    if (consumed == tokens.size()) {
+        tokens.clear(); // tokens are immutable, so drained tokens are dropped together rather than erased one by one.
+        consumed = 0;
+        while (tokens.empty() && !atEnd()) {
+            start = current;
+            scanToken();
+        }
+        if (tokens.empty()) {
+            return Token(ENDFILE, "EOF", "", line);
+        }
+    }
+    return tokens[consumed++];
+}
+
 void Lexer::error(int line, std::string message) {
     report(line, "", message);
     hasError = true;
 }
 
 void Lexer::report(int line, std::string where, std::string message) {
+    if (diagnostics) {
+        diagnostics->push_back(Diagnostic{DIAG_LEX, message, sourceName, line, (size_t) start});
+        return;
+    }
     std::cerr << "[line " << line << "] Error" << where << ": " << message << std::endl;
 }
\ No newline at end of file
@@ -2,23 +2,33 @@
 
 #include <iostream>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <variant>
 #include <sstream>
 #include "token.hpp"
+#include "diagnostic.hpp"
 
 class Lexer {
     public:
         Lexer(std::string text);
+        Lexer(const char * data, size_t size); // lexes data in place (e.g. a mapped file), which must outlive the lexer.
+        Lexer(Lexer const&) = delete;
+        Lexer& operator=(Lexer const&) = delete;
         std::vector<Token> run();
+        Token next();
     //private: temporary to dbug.
         int start = 0; //TODO Refactor to size_t later.
         int current = 0;
         int line = 1;
         int length;
         bool hasError = false;
-        std::string source;
+        std::string ownedSource;
+        std::string_view source;
         std::vector<Token> tokens;
+        size_t consumed = 0; // tokens already handed out by next().
+        std::vector<Diagnostic> * diagnostics = nullptr; // when set, errors are collected here instead of printed.
+        std::string sourceName; // file name reported with the diagnostics.
 
         void setSource(std::string newSource);
         bool atEnd();
@@ -1,9 +1,146 @@
 #include <lexer.hpp>
 #include <reader.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <thread>
+
+const char * USAGE = "Expected: tester <scriptName>, tester --compile <scriptName> <outputName>, tester --stats <scriptName> [traceName]"
+                     " or tester [--check] [--jobs N] <scriptName or directory>...";
+
+struct CheckResult {
+    bool valid = false;
+    double seconds = 0;
+    std::vector<Diagnostic> diagnostics;
+};
+
+/*
+    Expands the arguments of a batch check into the files to load: files are taken as given, directories are searched
+    recursively for .conf and .json files, in sorted order so the report is stable.
+*/
+static std::vector<std::string> collectFiles(std::vector<std::string> const& paths) {
+    std::vector<std::string> files;
+    for (auto const& path : paths) {
+        if (!std::filesystem::is_directory(path)) {
+            files.push_back(path);
+            continue;
+        }
+        std::vector<std::string> found;
+        for (auto const& entry : std::filesystem::recursive_directory_iterator(path)) {
+            std::string extension = entry.path().extension().string();
+            if (entry.is_regular_file() && (extension == ".conf" || extension == ".json")) {
+                found.push_back(entry.path().string());
+            }
+        }
+        std::sort(found.begin(), found.end());
+        files.insert(files.end(), found.begin(), found.end());
+    }
+    return files;
+}
+
+/*
+    Loads every file on a pool of jobs threads, sharing one include cache, and prints the errors of each invalid file
+    followed by a summary. Nothing is printed for valid files.
+    @returns the process exit code, 1 if any file is invalid.
+*/
+static int checkFiles(std::vector<std::string> const& paths, size_t jobs) {
+    std::vector<std::string> files = collectFiles(paths);
+    std::vector<CheckResult> results(files.size());
+    std::shared_ptr<IncludeCache> cache = std::make_shared<IncludeCache>();
+    std::atomic<size_t> next{0};
+
+    auto started = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (size_t j = 0; j < std::min(jobs, files.size()); j++) {
+        workers.emplace_back([&files, &results, &cache, &next]() {
+            for (size_t i = next++; i < files.size(); i = next++) {
+                auto start = std::chrono::steady_clock::now();
+                ConfigFile file = ConfigFile(files[i], cache);
+                LoadResult loaded = file.load();
+                results[i].valid = loaded.ok();
+                results[i].diagnostics = std::move(loaded.diagnostics);
+                results[i].seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+    size_t failed = 0;
+    double loadSeconds = 0;
+    size_t slowest = 0;
+    for (size_t i = 0; i < files.size(); i++) {
+        loadSeconds += results[i].seconds;
+        slowest = results[i].seconds > results[slowest].seconds ? i : slowest;
+        if (results[i].valid) {
+            continue;
+        }
+        failed++;
+        std::printf("FAIL %s (%.1f ms)\n", files[i].c_str(), results[i].seconds * 1e3);
+        for (auto const& diagnostic : results[i].diagnostics) {
+            std::printf("    %s\n", diagnostic.str().c_str());
+        }
+    }
+    std::printf("checked %zu files: %zu passed, %zu failed in %.2f s (%zu jobs, %.2f s loading)\n",
+        files.size(), files.size() - failed, failed, elapsed, jobs, loadSeconds);
+    if (!files.empty()) {
+        std::printf("slowest: %s (%.1f ms)\n", files[slowest].c_str(), results[slowest].seconds * 1e3);
+    }
+    return failed ? 1 : 0;
+}
 
 int main(int argc, char * argv[]) {
-    if (argc > 2) {
-        std::cerr << "Expected: tester <scriptName>" << std::endl;
+    std::string first = argc > 1 ? argv[1] : "";
+    if (argc == 4 && first == "--compile") {
+        ConfigFile file = ConfigFile(std::string(argv[2]));
+        LoadResult loaded = file.load();
+        if (!loaded.ok()) {
+            std::cerr << "ERROR: could not compile " << argv[2] << std::endl;
+            for (auto const& diagnostic : loaded.diagnostics) {
+                std::cerr << "    " << diagnostic.str() << std::endl;
+            }
+            return 1;
+        }
+        if (!file.writeCompiled(argv[3])) {
+            std::cerr << "ERROR: could not write " << argv[3] << std::endl;
+            return 1;
+        }
+    } else if ((argc == 3 || argc == 4) && first == "--stats") {
+        ConfigFile file = ConfigFile(argv[2]);
+        file.setStatsEnabled(true);
+        file.runFile();
+        std::cerr << file.getStats().str();
+        std::cerr << "\npeak memory:\n" << file.getStats().peakMemory().str();
+        std::cerr << "\nretained memory:\n" << file.getMemoryUsage().str();
+        if (argc == 4) {
+            std::ofstream trace(argv[3], std::ios::trunc);
+            file.getStats().writeTrace(trace);
+        }
+    } else if (first == "--check" || first == "--jobs" || argc > 2 || (argc == 2 && std::filesystem::is_directory(first))) {
+        size_t jobs = std::max(1u, std::thread::hardware_concurrency());
+        std::vector<std::string> paths;
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            if (arg == "--check") {
+                continue;
+            } else if (arg == "--jobs" && i + 1 < argc) {
+                jobs = std::max(1, std::atoi(argv[++i]));
+            } else if (arg.rfind("--", 0) == 0) {
+                std::cerr << USAGE << std::endl;
+                return 1;
+            } else {
+                paths.push_back(arg);
+            }
+        }
+        if (paths.empty()) {
+            std::cerr << USAGE << std::endl;
+            return 1;
+        }
+        return checkFiles(paths, jobs);
     } else if (argc == 2) {
         ConfigFile file = ConfigFile(argv[1]);
         file.runFile();
@@ -13,4 +150,4 @@ int main(int argc, char * argv[]) {
     } else {
         std::cout << "ran tester" << std::endl;
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,193 @@
+#include "hocon-http.hpp"
+#include <cctype>
+#include <curl/curl.h>
+
+const int POLL_TIMEOUT_MS = 1000; // the fetch thread also wakes up on every submission (curl_multi_wakeup).
+
+struct HttpRequest {
+    std::shared_ptr<FileRead> read;
+    CURL * easy = nullptr;
+    curl_slist * headers = nullptr;
+    std::string body;
+    std::string etag;
+    std::string lastModified;
+    std::string cachedBody; // of the cache entry the validators were sent for.
+};
+
+static size_t appendBody(char * data, size_t size, size_t count, void * request) {
+    static_cast<HttpRequest*>(request)->body.append(data, size * count);
+    return size * count;
+}
+
+/*
+    Keeps the value of an ETag or Last-Modified response header. A redirect or a 1xx response starts a new set of
+    headers, so values are overwritten rather than accumulated.
+*/
+static size_t readHeader(char * data, size_t size, size_t count, void * request) {
+    std::string line(data, size * count);
+    size_t colon = line.find(':');
+    if (colon != std::string::npos) {
+        std::string name = line.substr(0, colon);
+        for (char& c : name) {
+            c = std::tolower((unsigned char) c);
+        }
+        size_t start = line.find_first_not_of(" \t", colon + 1);
+        size_t end = line.find_last_not_of(" \t\r\n");
+        std::string value = (start == std::string::npos || end < start) ? "" : line.substr(start, end - start + 1);
+        if (name == "etag") {
+            static_cast<HttpRequest*>(request)->etag = value;
+        } else if (name == "last-modified") {
+            static_cast<HttpRequest*>(request)->lastModified = value;
+        }
+    }
+    return size * count;
+}
+
+HttpFetcher::HttpFetcher(HttpOptions options) : options(options) {
+    static std::once_flag curlInitialized; // curl_global_init is not thread safe, and every fetcher needs it first.
+    std::call_once(curlInitialized, [] { curl_global_init(CURL_GLOBAL_DEFAULT); });
+    multi = curl_multi_init();
+    worker = std::thread(&HttpFetcher::run, this);
+}
+
+/*
+    Fails the fetches still in flight, then stops the fetch thread.
+*/
+HttpFetcher::~HttpFetcher() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    curl_multi_wakeup(multi);
+    worker.join();
+    curl_multi_cleanup(multi);
+}
+
+std::vector<std::shared_ptr<FileRead>> HttpFetcher::readAll(std::vector<std::string> const& urls) {
+    std::vector<std::shared_ptr<FileRead>> reads;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto const& url : urls) {
+            HttpRequest * request = new HttpRequest();
+            request->read = std::make_shared<FileRead>(url);
+            request->easy = curl_easy_init();
+            curl_easy_setopt(request->easy, CURLOPT_URL, url.c_str());
+            curl_easy_setopt(request->easy, CURLOPT_WRITEFUNCTION, appendBody);
+            curl_easy_setopt(request->easy, CURLOPT_WRITEDATA, request);
+            curl_easy_setopt(request->easy, CURLOPT_HEADERFUNCTION, readHeader);
+            curl_easy_setopt(request->easy, CURLOPT_HEADERDATA, request);
+            curl_easy_setopt(request->easy, CURLOPT_CONNECTTIMEOUT_MS, options.connectTimeoutMs);
+            curl_easy_setopt(request->easy, CURLOPT_TIMEOUT_MS, options.totalTimeoutMs);
+            curl_easy_setopt(request->easy, CURLOPT_NOSIGNAL, 1L);
+            curl_easy_setopt(request->easy, CURLOPT_PRIVATE, request);
+            auto cached = cache.find(url);
+            if (cached != cache.end()) {
+                if (!cached->second.etag.empty()) {
+                    request->headers = curl_slist_append(request->headers, ("If-None-Match: " + cached->second.etag).c_str());
+                }
+                if (!cached->second.lastModified.empty()) {
+                    request->headers = curl_slist_append(request->headers, ("If-Modified-Since: " + cached->second.lastModified).c_str());
+                }
+                request->cachedBody = cached->second.body;
+                curl_easy_setopt(request->easy, CURLOPT_HTTPHEADER, request->headers);
+            }
+            submitted.push_back(request);
+            reads.push_back(request->read);
+        }
+    }
+    curl_multi_wakeup(multi);
+    return reads;
+}
+
+/*
+    Fetch thread: adds submitted requests to the multi handle, runs the transfers and completes every request that
+    finished, until the fetcher is destroyed.
+*/
+void HttpFetcher::run() {
+    int running = 0;
+    while (true) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (stopping) {
+                break;
+            }
+            for (HttpRequest * request : submitted) {
+                curl_multi_add_handle(multi, request->easy);
+                active.insert(request);
+            }
+            submitted.clear();
+        }
+        curl_multi_perform(multi, &running);
+        int left = 0;
+        while (CURLMsg * message = curl_multi_info_read(multi, &left)) {
+            if (message->msg != CURLMSG_DONE) {
+                continue;
+            }
+            HttpRequest * request = nullptr;
+            curl_easy_getinfo(message->easy_handle, CURLINFO_PRIVATE, &request);
+            int result = message->data.result;
+            curl_multi_remove_handle(multi, message->easy_handle);
+            active.erase(request);
+            finish(request, result);
+        }
+        curl_multi_poll(multi, nullptr, 0, POLL_TIMEOUT_MS, nullptr);
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    for (HttpRequest * request : active) {
+        curl_multi_remove_handle(multi, request->easy);
+        submitted.push_back(request);
+    }
+    active.clear();
+    for (HttpRequest * request : submitted) {
+        finishLocked(request, CURLE_ABORTED_BY_CALLBACK);
+    }
+    submitted.clear();
+}
+
+/*
+    Completes the read of a finished request from its response, or from the cache for a 304.
+*/
+void HttpFetcher::finish(HttpRequest * request, int result) {
+    std::lock_guard<std::mutex> lock(mutex);
+    finishLocked(request, result);
+}
+
+void HttpFetcher::finishLocked(HttpRequest * request, int result) {
+    long status = 0;
+    curl_easy_getinfo(request->easy, CURLINFO_RESPONSE_CODE, &status);
+    FileRead& read = *request->read;
+    bool opened = false;
+    if (result == CURLE_OK && status == 304 && !request->headers) {
+        opened = false; // a 304 to a request that was not conditional.
+    } else if (result == CURLE_OK && status == 304) {
+        read.content = request->cachedBody;
+        notModified++;
+        opened = true;
+    } else if (result == CURLE_OK && status / 100 == 2) {
+        read.content = std::move(request->body);
+        if (!request->etag.empty() || !request->lastModified.empty()) {
+            cache[read.path] = HttpCacheEntry{request->etag, request->lastModified, read.content};
+        }
+        opened = true;
+    }
+    curl_easy_cleanup(request->easy);
+    curl_slist_free_all(request->headers);
+    std::shared_ptr<FileRead> done = request->read;
+    delete request;
+    done->complete(opened);
+}
+
+const char * HttpFetcher::name() const {
+    return "http";
+}
+
+size_t HttpFetcher::notModifiedCount() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return notModified;
+}
+
+HttpFetcher& HttpFetcher::shared() {
+    static HttpFetcher fetcher;
+    return fetcher;
+}
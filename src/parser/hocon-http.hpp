@@ -0,0 +1,64 @@
+#pragma once
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "hocon-io.hpp"
+
+/*
+    Limits on a url include. A fetch that has not connected after connectTimeoutMs, or not finished after totalTimeoutMs,
+    fails like an unreachable url.
+*/
+struct HttpOptions {
+    long connectTimeoutMs = 5000;
+    long totalTimeoutMs = 30000;
+};
+
+/*
+    Response validators and body of an url, kept so that fetching it again is a conditional GET.
+*/
+struct HttpCacheEntry {
+    std::string etag;
+    std::string lastModified;
+    std::string body;
+};
+
+struct HttpRequest;
+
+/*
+    Fetches url includes on one curl multi handle, driven by a thread of its own. Every fetch of a fetcher shares the
+    connection cache of the multi handle, so includes from one host reuse the connection (and its TLS session) instead
+    of connecting for each, and readAll starts all of its fetches at once. A FileRead of an url is opened only for a
+    2xx response, or a 304 answered from the cache: bodies of error responses are not configurations.
+
+    Responses carrying an ETag or a Last-Modified header are kept in memory by url. The next fetch of the url sends them
+    back (If-None-Match, If-Modified-Since), and an unchanged remote include then costs a 304 with no body.
+*/
+class HttpFetcher : public FileReader {
+    private:
+        HttpOptions options;
+        void * multi = nullptr;
+        std::mutex mutex;                           // guards submitted, cache, stopping and the counters.
+        std::deque<HttpRequest*> submitted;         // requests the fetch thread has not added to the multi handle yet.
+        std::unordered_set<HttpRequest*> active;    // requests on the multi handle, only used by the fetch thread.
+        std::unordered_map<std::string, HttpCacheEntry> cache;
+        size_t notModified = 0;
+        bool stopping = false;
+        std::thread worker;
+        void run();
+        void finish(HttpRequest * request, int result);
+        void finishLocked(HttpRequest * request, int result);
+    public:
+        HttpFetcher(HttpOptions options = HttpOptions());
+        ~HttpFetcher();
+        HttpFetcher(HttpFetcher const&) = delete;
+        HttpFetcher& operator=(HttpFetcher const&) = delete;
+        std::vector<std::shared_ptr<FileRead>> readAll(std::vector<std::string> const& urls) override;
+        const char * name() const override;
+        size_t notModifiedCount();  // fetches answered from the cache by a 304.
+        static HttpFetcher& shared(); // default options, started on the first url include.
+};
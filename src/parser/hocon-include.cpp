@@ -0,0 +1,105 @@
+#include "hocon-include.hpp"
+#include <algorithm>
+
+static thread_local int poolThread = 0;
+
+IncludeTask::IncludeTask(std::function<void()> work) : work(std::move(work)) {}
+
+bool IncludeTask::claim() {
+    int expected = TASK_QUEUED;
+    return state.compare_exchange_strong(expected, TASK_RUNNING);
+}
+
+void IncludeTask::run() {
+    try {
+        work();
+    } catch (...) {
+        error = std::current_exception();
+    }
+    work = nullptr; // releases whatever the work captured as soon as it is done.
+    std::lock_guard<std::mutex> lock(mutex);
+    state = TASK_DONE;
+    finished.notify_all();
+}
+
+void IncludeTask::wait() {
+    if (claim()) {
+        run();
+    } else {
+        std::unique_lock<std::mutex> lock(mutex);
+        finished.wait(lock, [this] { return state == TASK_DONE; });
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+bool IncludeTask::cancel() {
+    if (!claim()) {
+        return false;
+    }
+    work = nullptr;
+    std::lock_guard<std::mutex> lock(mutex);
+    state = TASK_DONE;
+    finished.notify_all();
+    return true;
+}
+
+IncludePool::IncludePool(unsigned threadCount) {
+    for (unsigned i = 0; i < threadCount; i++) {
+        threads.emplace_back(&IncludePool::work, this, i + 1);
+    }
+}
+
+IncludePool::~IncludePool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    available.notify_all();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+void IncludePool::work(int index) {
+    poolThread = index;
+    while (true) {
+        std::shared_ptr<IncludeTask> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            available.wait(lock, [this] { return stopping || !queue.empty(); });
+            if (stopping) {
+                return;
+            }
+            task = std::move(queue.front());
+            queue.pop_front();
+        }
+        if (task->claim()) { // the task may already have been run or cancelled by a waiting thread.
+            task->run();
+        }
+    }
+}
+
+std::shared_ptr<IncludeTask> IncludePool::submit(std::function<void()> work) {
+    auto task = std::make_shared<IncludeTask>(std::move(work));
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queue.push_back(task);
+    }
+    available.notify_one();
+    return task;
+}
+
+size_t IncludePool::size() const {
+    return threads.size();
+}
+
+IncludePool& IncludePool::shared() {
+    static IncludePool pool(std::max(1u, std::thread::hardware_concurrency()));
+    return pool;
+}
+
+int IncludePool::currentThread() {
+    return poolThread;
+}
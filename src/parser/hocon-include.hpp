@@ -0,0 +1,62 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+enum IncludeTaskState {
+    TASK_QUEUED, TASK_RUNNING, TASK_DONE
+};
+
+/*
+    One unit of work for an IncludePool. A task runs at most once, on whichever thread claims it first: a pool thread,
+    or the thread that waits for it. wait runs a task that no thread has started yet itself, so a parser waiting on an
+    include only ever blocks on a task that is making progress, and includes nested inside prefetched includes cannot
+    deadlock a pool of any size. An exception thrown by the work is kept and rethrown by wait, on the thread that needs
+    the result, rather than escaping a pool thread.
+*/
+class IncludeTask {
+    friend class IncludePool;
+    private:
+        std::function<void()> work;
+        std::atomic<int> state{TASK_QUEUED};
+        std::mutex mutex;
+        std::condition_variable finished;
+        std::exception_ptr error; // thrown by the work, set before the task is done.
+        bool claim();
+        void run();
+    public:
+        IncludeTask(std::function<void()> work);
+        IncludeTask(IncludeTask const&) = delete;
+        IncludeTask& operator=(IncludeTask const&) = delete;
+        void wait(); // rethrows what the work threw.
+        bool cancel(); // @returns true if the task had not started, it then never runs.
+};
+
+/*
+    Fixed set of threads running IncludeTasks in submission order. The destructor waits for the task each thread is
+    running and drops the ones still queued, so every task a caller still needs must be waited for first.
+*/
+class IncludePool {
+    private:
+        std::vector<std::thread> threads;
+        std::deque<std::shared_ptr<IncludeTask>> queue;
+        std::mutex mutex;
+        std::condition_variable available;
+        bool stopping = false;
+        void work(int index);
+    public:
+        IncludePool(unsigned threadCount);
+        ~IncludePool();
+        IncludePool(IncludePool const&) = delete;
+        IncludePool& operator=(IncludePool const&) = delete;
+        std::shared_ptr<IncludeTask> submit(std::function<void()> work);
+        size_t size() const;
+        static IncludePool& shared(); // one thread per core, started on first use and shared by every load.
+        static int currentThread();   // 1 based index of the calling pool thread, 0 on any other thread.
+};
@@ -0,0 +1,160 @@
+#include "hocon-index.hpp"
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+
+const uint64_t HASH_MULTIPLIER = 0x9E3779B97F4A7C15ull;
+const size_t BUCKET_SIZE = 5;       // average keys per bucket, more is smaller but slower to build.
+const int BUILD_ATTEMPTS = 8;       // seeds tried before giving up.
+
+static uint64_t mix(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xFF51AFD7ED558CCDull;
+    x ^= x >> 33;
+    x *= 0xC4CEB9FE1A85EC53ull;
+    x ^= x >> 33;
+    return x;
+}
+
+/*
+    64 bit hash of key, reading it a word at a time so long paths cost little more than short ones.
+*/
+static uint64_t hashKey(std::string_view key, uint64_t seed) {
+    uint64_t h = seed ^ (key.size() * HASH_MULTIPLIER);
+    size_t i = 0;
+    for (; i + 8 <= key.size(); i += 8) {
+        uint64_t word;
+        std::memcpy(&word, key.data() + i, 8);
+        h = (h ^ word) * HASH_MULTIPLIER;
+        h ^= h >> 32;
+    }
+    uint64_t tail = 0;
+    std::memcpy(&tail, key.data() + i, key.size() - i);
+    return mix(h ^ tail);
+}
+
+size_t PathIndex::position(uint64_t hash, uint16_t pilot) const {
+    return mix(hash ^ (pilot * HASH_MULTIPLIER)) % tableSize;
+}
+
+size_t PathIndex::slot(uint64_t hash) const {
+    size_t p = position(hash, pilots[hash % pilots.size()]);
+    return p < keyCount ? p : remap[p - keyCount];
+}
+
+/*
+    Builds the hash over keys, which must be distinct, and stores slots[i], the slot of keys[i].
+    @returns false if no seed gave a table where every bucket could be placed, leaving the index empty.
+*/
+bool PathIndex::build(std::vector<std::string> const& input, std::vector<uint32_t>& slots) {
+    keyCount = input.size();
+    tableSize = keyCount + keyCount / 100 + 1;
+    size_t bucketCount = keyCount / BUCKET_SIZE + 1;
+    std::vector<uint64_t> hashes(keyCount);
+    std::vector<std::vector<uint32_t>> buckets(bucketCount);
+    std::vector<uint32_t> order(bucketCount);
+    std::vector<size_t> positions;
+    for (int attempt = 0; attempt < BUILD_ATTEMPTS; attempt++) {
+        seed = mix(attempt + 1);
+        for (auto& bucket : buckets) {
+            bucket.clear();
+        }
+        for (size_t i = 0; i < keyCount; i++) {
+            hashes[i] = hashKey(input[i], seed);
+            buckets[hashes[i] % bucketCount].push_back(i);
+        }
+        // the largest buckets are the hardest to place, so they go first while the table is still empty.
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&buckets](uint32_t a, uint32_t b) {
+            return buckets[a].size() > buckets[b].size();
+        });
+        pilots.assign(bucketCount, 0);
+        std::vector<bool> taken(tableSize);
+        bool placed = true;
+        for (uint32_t b : order) {
+            bool found = false;
+            for (uint32_t pilot = 0; pilot <= UINT16_MAX && !found && !buckets[b].empty(); pilot++) {
+                positions.clear();
+                found = true;
+                for (uint32_t k : buckets[b]) {
+                    size_t p = position(hashes[k], pilot);
+                    if (taken[p] || std::find(positions.begin(), positions.end(), p) != positions.end()) {
+                        found = false;
+                        break;
+                    }
+                    positions.push_back(p);
+                }
+                if (found) {
+                    pilots[b] = pilot;
+                    for (size_t p : positions) {
+                        taken[p] = true;
+                    }
+                }
+            }
+            if (!found && !buckets[b].empty()) {
+                placed = false;
+                break;
+            }
+        }
+        if (!placed) {
+            continue;
+        }
+
+        remap.assign(tableSize - keyCount, 0);
+        size_t gap = 0;
+        for (size_t p = keyCount; p < tableSize; p++) {
+            if (taken[p]) {
+                while (taken[gap]) {
+                    gap++;
+                }
+                remap[p - keyCount] = gap++;
+            }
+        }
+        slots.resize(keyCount);
+        std::vector<uint32_t> bySlot(keyCount);
+        for (size_t i = 0; i < keyCount; i++) {
+            slots[i] = slot(hashes[i]);
+            bySlot[slots[i]] = i;
+        }
+        size_t keyBytes = 0;
+        for (auto const& key : input) {
+            keyBytes += key.size();
+        }
+        keys.clear();
+        keys.reserve(keyBytes);
+        keyOffsets.reserve(keyCount + 1);
+        keyOffsets.assign(1, 0);
+        for (uint32_t i : bySlot) {
+            keys += input[i];
+            keyOffsets.push_back(keys.size());
+        }
+        return true;
+    }
+    keyCount = 0;
+    pilots.clear();
+    remap.clear();
+    keys.clear();
+    keyOffsets.clear();
+    return false;
+}
+
+/*
+    @returns the slot of key, or PATH_INDEX_MISS if key is not one of the keys the index was built over.
+*/
+size_t PathIndex::find(std::string_view key) const {
+    if (keyCount == 0) {
+        return PATH_INDEX_MISS;
+    }
+    size_t s = slot(hashKey(key, seed));
+    std::string_view stored(keys.data() + keyOffsets[s], keyOffsets[s + 1] - keyOffsets[s]);
+    return stored == key ? s : PATH_INDEX_MISS;
+}
+
+size_t PathIndex::size() const {
+    return keyCount;
+}
+
+size_t PathIndex::bytes() const {
+    return sizeof(PathIndex) + pilots.capacity() * sizeof(uint16_t) + remap.capacity() * sizeof(uint32_t) +
+        keys.capacity() + keyOffsets.capacity() * sizeof(uint32_t);
+}
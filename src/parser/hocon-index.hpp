@@ -0,0 +1,34 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+const size_t PATH_INDEX_MISS = SIZE_MAX;
+
+/*
+    Minimal perfect hash over a fixed set of full dotted paths, built hash and displace style (CHD, PTHash). Every key
+    hashes to a bucket of about five keys, and each bucket stores the 16 bit pilot that build found to send all of its
+    keys to free slots. The table has about 1% more slots than keys; the few keys that land past the last slot are
+    remapped into the gaps, so the slots are exactly 0 .. size() - 1. That is about 3.5 bits per key.
+
+    The keys themselves are kept too, in slot order, so that a lookup can tell a path of the set from any other string:
+    find is one hash, one pilot load and one key compare, however deep the path is.
+*/
+class PathIndex {
+    private:
+        uint64_t seed = 0;
+        size_t keyCount = 0;
+        size_t tableSize = 0;
+        std::vector<uint16_t> pilots;       // one per bucket.
+        std::vector<uint32_t> remap;        // slot of a key whose position p is past the last slot, at p - keyCount.
+        std::string keys;                   // every key, in slot order.
+        std::vector<uint32_t> keyOffsets;   // keyCount + 1 offsets into keys.
+        size_t position(uint64_t hash, uint16_t pilot) const;
+        size_t slot(uint64_t hash) const;
+    public:
+        bool build(std::vector<std::string> const& keys, std::vector<uint32_t>& slots);
+        size_t find(std::string_view key) const;
+        size_t size() const;
+        size_t bytes() const; // memory held by the index, keys included.
+};
@@ -0,0 +1,446 @@
+#include "hocon-io.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+const unsigned FALLBACK_READ_THREADS = 16; // reads mostly wait on the disk, so more of them than cores are in flight.
+const size_t UNSIZED_READ_CHUNK = 64 * 1024; // first buffer for files whose statx size is 0, such as procfs files and FIFOs.
+
+IncludeStamp getIncludeStamp(std::string const& path) {
+    IncludeStamp stamp;
+    stamp.path = path;
+    struct stat info;
+    if (stat(path.c_str(), &info) == 0) {
+        stamp.mtime = (long long) info.st_mtim.tv_sec * 1000000000LL + info.st_mtim.tv_nsec;
+        stamp.size = info.st_size;
+        stamp.inode = info.st_ino;
+    }
+    return stamp;
+}
+
+bool IncludeStamp::operator==(IncludeStamp const& other) const {
+    return path == other.path && mtime == other.mtime && size == other.size && inode == other.inode;
+}
+
+FileRead::FileRead(std::string const& path) : path(path) {
+    stamp.path = path;
+}
+
+void FileRead::complete(bool opened) {
+    std::lock_guard<std::mutex> lock(mutex);
+    this->opened = opened;
+    done = true;
+    finished.notify_all();
+}
+
+void FileRead::wait() {
+    if (task) {
+        task->wait();
+    }
+    std::unique_lock<std::mutex> lock(mutex);
+    finished.wait(lock, [this] { return done; });
+}
+
+void FileRead::readBlocking() {
+    stamp = getIncludeStamp(path);
+    std::ifstream file(path);
+    if (file.is_open()) {
+        std::ostringstream stream;
+        stream << file.rdbuf();
+        content = stream.str();
+    }
+    complete(file.is_open());
+}
+
+bool FileRead::ready() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return done;
+}
+
+std::shared_ptr<FileRead> FileReader::read(std::string const& path) {
+    return readAll(std::vector<std::string>{path}).front();
+}
+
+FileReader& FileReader::shared() {
+    static std::unique_ptr<FileReader> reader = []() -> std::unique_ptr<FileReader> {
+        if (std::unique_ptr<UringFileReader> uring = UringFileReader::create()) {
+            return uring;
+        }
+        return std::make_unique<ThreadFileReader>(FALLBACK_READ_THREADS);
+    }();
+    return *reader;
+}
+
+std::vector<std::shared_ptr<FileRead>> InlineFileReader::readAll(std::vector<std::string> const& paths) {
+    std::vector<std::shared_ptr<FileRead>> reads;
+    for (auto const& path : paths) {
+        auto read = std::make_shared<FileRead>(path);
+        std::weak_ptr<FileRead> handle = read;
+        read->task = std::make_shared<IncludeTask>([handle]() { // never submitted, so the first wait runs it.
+            if (std::shared_ptr<FileRead> read = handle.lock()) {
+                read->readBlocking();
+            }
+        });
+        reads.push_back(read);
+    }
+    return reads;
+}
+
+const char * InlineFileReader::name() const {
+    return "inline";
+}
+
+ThreadFileReader::ThreadFileReader(unsigned threads, std::chrono::nanoseconds latency) : pool(threads), latency(latency) {}
+
+std::vector<std::shared_ptr<FileRead>> ThreadFileReader::readAll(std::vector<std::string> const& paths) {
+    std::vector<std::shared_ptr<FileRead>> reads;
+    for (auto const& path : paths) {
+        auto read = std::make_shared<FileRead>(path);
+        std::weak_ptr<FileRead> handle = read; // the task is owned by the read, so it must not own the read in turn.
+        std::chrono::nanoseconds delay = latency;
+        read->task = pool.submit([handle, delay]() {
+            if (delay.count() > 0) {
+                std::this_thread::sleep_for(delay);
+            }
+            std::shared_ptr<FileRead> read = handle.lock();
+            if (!read) {
+                return;
+            }
+            read->readBlocking();
+        });
+        reads.push_back(read);
+    }
+    return reads;
+}
+
+const char * ThreadFileReader::name() const {
+    return "threads";
+}
+
+enum UringStep {
+    STEP_OPEN, STEP_STAT, STEP_READ
+};
+
+struct UringOp {
+    std::shared_ptr<FileRead> read;
+    UringStep step = STEP_OPEN;
+    int fd = -1;
+    struct statx info;
+    size_t done = 0;        // bytes read so far.
+    bool untilEof = false;  // the size is unknown, so the file is read until a read returns 0.
+};
+
+static int uringSetup(unsigned entries, io_uring_params * params) {
+    return (int) syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int uringEnter(int ring, unsigned submit, unsigned complete, unsigned flags) {
+    return (int) syscall(__NR_io_uring_enter, ring, submit, complete, flags, nullptr, 0);
+}
+
+static int uringRegister(int ring, unsigned opcode, void * arg, unsigned args) {
+    return (int) syscall(__NR_io_uring_register, ring, opcode, arg, args);
+}
+
+/*
+    @returns nullptr if io_uring cannot be set up, as when the kernel is too old, was built without it, or a seccomp
+    profile (the default one of most container runtimes) blocks it.
+*/
+std::unique_ptr<UringFileReader> UringFileReader::create(unsigned entries) {
+    std::unique_ptr<UringFileReader> reader(new UringFileReader());
+    if (!reader->setup(entries)) {
+        return nullptr;
+    }
+    reader->completions = std::thread(&UringFileReader::reap, reader.get());
+    return reader;
+}
+
+bool UringFileReader::setup(unsigned entries) {
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    ring = uringSetup(entries, &params);
+    if (ring < 0) {
+        return false;
+    }
+    // openat, statx and read arrived in 5.6, older kernels set the ring up but fail those steps.
+    std::vector<char> probeBuffer(sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op));
+    io_uring_probe * probe = reinterpret_cast<io_uring_probe*>(probeBuffer.data());
+    if (uringRegister(ring, IORING_REGISTER_PROBE, probe, 256) < 0) {
+        return false;
+    }
+    for (int op : {IORING_OP_OPENAT, IORING_OP_STATX, IORING_OP_READ}) {
+        if (op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED)) {
+            return false;
+        }
+    }
+
+    sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool singleMap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (singleMap) {
+        sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+    }
+    sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQ_RING);
+    if (sqRing == MAP_FAILED) {
+        sqRing = nullptr;
+        return false;
+    }
+    if (singleMap) {
+        cqRing = sqRing;
+    } else {
+        cqRing = mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_CQ_RING);
+        if (cqRing == MAP_FAILED) {
+            cqRing = nullptr;
+            return false;
+        }
+    }
+    sqEntriesSize = params.sq_entries * sizeof(io_uring_sqe);
+    sqEntries = mmap(nullptr, sqEntriesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQES);
+    if (sqEntries == MAP_FAILED) {
+        sqEntries = nullptr;
+        return false;
+    }
+    char * sq = static_cast<char*>(sqRing);
+    char * cq = static_cast<char*>(cqRing);
+    sqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sqMask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cqMask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqEntries = cq + params.cq_off.cqes;
+    sqCapacity = params.sq_entries;
+    cqCapacity = params.cq_entries;
+    // the completion thread polls an eventfd the ring signals on every completion, next to one the destructor signals
+    // to stop it, so stopping does not depend on a submission that could fail.
+    completed = eventfd(0, EFD_CLOEXEC);
+    stopped = eventfd(0, EFD_CLOEXEC);
+    return completed >= 0 && stopped >= 0 && uringRegister(ring, IORING_REGISTER_EVENTFD, &completed, 1) == 0;
+}
+
+/*
+    Waits for every read in flight, since the kernel writes into their buffers, then stops the completion thread.
+*/
+UringFileReader::~UringFileReader() {
+    if (completions.joinable()) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            idle.wait(lock, [this] { return inFlight == 0 && waiting.empty(); });
+        }
+        uint64_t one = 1;
+        while (write(stopped, &one, sizeof(one)) < 0 && errno == EINTR) {
+        }
+        completions.join();
+    }
+    if (completed >= 0) {
+        close(completed);
+    }
+    if (stopped >= 0) {
+        close(stopped);
+    }
+    if (sqEntries) {
+        munmap(sqEntries, sqEntriesSize);
+    }
+    if (cqRing && cqRing != sqRing) {
+        munmap(cqRing, cqRingSize);
+    }
+    if (sqRing) {
+        munmap(sqRing, sqRingSize);
+    }
+    if (ring >= 0) {
+        close(ring);
+    }
+}
+
+/*
+    Adds the next step of op to the steps waiting for submission. The caller holds mutex.
+*/
+void UringFileReader::queue(UringOp * op) {
+    waiting.push_back(op);
+}
+
+/*
+    Moves as many waiting steps into the submission queue as the completion queue has room for, and submits them with a
+    single io_uring_enter. If io_uring_enter fails, nothing it was given completes, so the reads of those steps and of
+    every waiting step fail here instead of leaving their waiters blocked. The caller holds mutex.
+*/
+void UringFileReader::flush() {
+    unsigned tail = *sqTail;
+    unsigned head = __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+    while (!waiting.empty() && inFlight < cqCapacity && tail - head < sqCapacity) {
+        UringOp * op = waiting.front();
+        waiting.pop_front();
+        unsigned index = tail & sqMask;
+        io_uring_sqe * sqe = static_cast<io_uring_sqe*>(sqEntries) + index;
+        std::memset(sqe, 0, sizeof(*sqe));
+        if (op->step == STEP_OPEN) {
+            sqe->opcode = IORING_OP_OPENAT;
+            sqe->fd = AT_FDCWD;
+            sqe->addr = (uint64_t) op->read->path.c_str();
+            sqe->open_flags = O_RDONLY | O_CLOEXEC;
+        } else if (op->step == STEP_STAT) {
+            sqe->opcode = IORING_OP_STATX;
+            sqe->fd = op->fd;
+            sqe->addr = (uint64_t) "";
+            sqe->len = STATX_BASIC_STATS;
+            sqe->off = (uint64_t) &op->info;
+            sqe->statx_flags = AT_EMPTY_PATH;
+        } else {
+            sqe->opcode = IORING_OP_READ;
+            sqe->fd = op->fd;
+            sqe->addr = (uint64_t) (op->read->content.data() + op->done);
+            sqe->len = op->read->content.size() - op->done;
+            sqe->off = op->done;
+        }
+        sqe->user_data = (uint64_t) op;
+        sqArray[index] = index;
+        tail++;
+        inFlight++;
+    }
+    __atomic_store_n(sqTail, tail, __ATOMIC_RELEASE);
+    unsigned pending = tail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+    int submitted = 0;
+    while (pending > 0 && (submitted = uringEnter(ring, pending, 0, 0)) < 0 && errno == EINTR) {
+    }
+    if (submitted >= 0) {
+        return;
+    }
+    // the kernel consumed none of the entries, so they are taken back out of the ring.
+    head = __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+    for (unsigned i = head; i != tail; i++) {
+        io_uring_sqe * sqe = static_cast<io_uring_sqe*>(sqEntries) + (i & sqMask);
+        inFlight--;
+        fail(reinterpret_cast<UringOp*>(sqe->user_data));
+    }
+    __atomic_store_n(sqTail, head, __ATOMIC_RELEASE);
+    for (UringOp * op : waiting) {
+        fail(op);
+    }
+    waiting.clear();
+    idle.notify_all();
+}
+
+/*
+    Completes the read of op as not opened. The caller holds mutex.
+*/
+void UringFileReader::fail(UringOp * op) {
+    if (op->fd >= 0) {
+        close(op->fd);
+    }
+    op->read->content.clear();
+    op->read->complete(false);
+    delete op;
+}
+
+/*
+    Completion thread: waits for completions and moves each file on to its next step, until the destructor signals
+    stopped.
+*/
+void UringFileReader::reap() {
+    while (true) {
+        pollfd fds[2] = {{completed, POLLIN, 0}, {stopped, POLLIN, 0}};
+        if (poll(fds, 2, -1) < 0) {
+            continue; // EINTR.
+        }
+        if (fds[1].revents) {
+            return; // only signaled once nothing is in flight.
+        }
+        uint64_t count;
+        if (::read(completed, &count, sizeof(count)) < 0) { // reset before reaping, so later completions signal again.
+            continue;
+        }
+        unsigned head = *cqHead;
+        unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+        std::vector<std::pair<UringOp*, int>> done;
+        for (; head != tail; head++) {
+            io_uring_cqe * cqe = static_cast<io_uring_cqe*>(cqEntries) + (head & cqMask);
+            done.push_back(std::make_pair(reinterpret_cast<UringOp*>(cqe->user_data), cqe->res));
+        }
+        __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+        std::lock_guard<std::mutex> lock(mutex);
+        inFlight -= done.size();
+        for (auto [op, result] : done) {
+            advance(op, result);
+        }
+        flush();
+        idle.notify_all();
+    }
+}
+
+/*
+    Takes the result of the step op just completed and queues its next step, or completes the read. The caller holds
+    mutex.
+*/
+void UringFileReader::advance(UringOp * op, int result) {
+    if (op->step == STEP_OPEN) {
+        if (result < 0) {
+            fail(op);
+            return;
+        }
+        op->fd = result;
+        op->step = STEP_STAT;
+        queue(op);
+        return;
+    }
+    if (op->step == STEP_STAT) {
+        if (result < 0) {
+            fail(op);
+            return;
+        }
+        IncludeStamp& stamp = op->read->stamp;
+        stamp.mtime = (long long) op->info.stx_mtime.tv_sec * 1000000000LL + op->info.stx_mtime.tv_nsec;
+        stamp.size = op->info.stx_size;
+        stamp.inode = op->info.stx_ino;
+        op->untilEof = op->info.stx_size == 0;
+        op->read->content.resize(op->untilEof ? UNSIZED_READ_CHUNK : op->info.stx_size);
+        op->step = STEP_READ;
+        queue(op);
+        return;
+    }
+    if (result < 0) {
+        fail(op);
+        return;
+    }
+    op->done += result;
+    std::string& content = op->read->content;
+    if (result > 0 && op->done == content.size() && op->untilEof) {
+        content.resize(content.size() * 2);
+    }
+    if (result > 0 && op->done < content.size()) { // a short read, or more of an unsized file: read on from op->done.
+        queue(op);
+        return;
+    }
+    // all statx promised arrived, or the file ended early. a file that grows meanwhile has a newer stamp by the next load.
+    close(op->fd);
+    content.resize(op->done);
+    op->read->complete(true);
+    delete op;
+}
+
+std::vector<std::shared_ptr<FileRead>> UringFileReader::readAll(std::vector<std::string> const& paths) {
+    std::vector<std::shared_ptr<FileRead>> reads;
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto const& path : paths) {
+        UringOp * op = new UringOp();
+        op->read = std::make_shared<FileRead>(path);
+        reads.push_back(op->read);
+        queue(op);
+    }
+    flush();
+    return reads;
+}
+
+const char * UringFileReader::name() const {
+    return "io_uring";
+}
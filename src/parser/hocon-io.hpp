@@ -0,0 +1,138 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "hocon-include.hpp"
+
+/*
+    Identifies the version of a file on disk, so that cached parse results can be reused while the file is unchanged.
+    mtime is -1 if the file could not be stat'd.
+*/
+struct IncludeStamp {
+    std::string path;
+    long long mtime = -1;
+    long long size = -1;
+    unsigned long long inode = 0;
+    bool operator==(IncludeStamp const& other) const;
+};
+
+IncludeStamp getIncludeStamp(std::string const& path);
+
+/*
+    A file read started by a FileReader. content and stamp may only be read once wait returned, from any thread. The
+    stamp is taken before the content is read, as HParser does for the files it reads itself.
+*/
+class FileRead {
+    friend class InlineFileReader;
+    friend class ThreadFileReader;
+    friend class UringFileReader;
+    friend class HttpFetcher;
+    friend class MemoryResolver;
+    private:
+        std::mutex mutex;
+        std::condition_variable finished;
+        bool done = false;
+        std::shared_ptr<IncludeTask> task; // set by InlineFileReader and ThreadFileReader, so a wait before the read started runs it.
+        void complete(bool opened);
+        void readBlocking(); // reads the file with blocking calls, stamp first, and completes the read.
+    public:
+        std::string path;
+        std::string content;
+        IncludeStamp stamp;
+        bool opened = false; // false if the file could not be opened or read, content is then empty.
+        FileRead(std::string const& path);
+        void wait();
+        bool ready(); // true once the read completed, without waiting or running it.
+};
+
+/*
+    Reads include files in the background. readAll starts every read at once and returns without waiting for any, so
+    the parser can go on and wait for each file only when it reaches the include.
+*/
+class FileReader {
+    public:
+        virtual ~FileReader() = default;
+        virtual std::vector<std::shared_ptr<FileRead>> readAll(std::vector<std::string> const& paths) = 0;
+        virtual const char * name() const = 0;
+        std::shared_ptr<FileRead> read(std::string const& path);
+        static FileReader& shared(); // io_uring if the kernel allows it, ThreadFileReader otherwise.
+};
+
+/*
+    Reads nothing ahead: each file is read with a blocking read by the thread that first waits for it, as the parser
+    does without a reader.
+*/
+class InlineFileReader : public FileReader {
+    public:
+        std::vector<std::shared_ptr<FileRead>> readAll(std::vector<std::string> const& paths) override;
+        const char * name() const override;
+};
+
+/*
+    Fallback reader running blocking reads on a pool of its own. latency is slept before every read, to stand in for a
+    slow filesystem in tests and benchmarks.
+*/
+class ThreadFileReader : public FileReader {
+    private:
+        IncludePool pool;
+        std::chrono::nanoseconds latency;
+    public:
+        ThreadFileReader(unsigned threads, std::chrono::nanoseconds latency = std::chrono::nanoseconds(0));
+        std::vector<std::shared_ptr<FileRead>> readAll(std::vector<std::string> const& paths) override;
+        const char * name() const override;
+};
+
+struct UringOp;
+
+/*
+    Reader on a single io_uring instance, driven through the raw system calls. Every file takes three steps, openat,
+    statx and read, and the steps of all the files in a batch are in flight together: readAll submits the first step
+    of every file in one io_uring_enter, and a completion thread submits the next step of each file as the previous
+    one completes. A short read is followed by another from where it stopped, until the statx size has arrived or a
+    read returns 0. Files whose statx size is 0 (procfs, FIFOs) are read until a read returns 0. At most as many steps
+    as the completion queue holds are in flight, the rest wait their turn.
+*/
+class UringFileReader : public FileReader {
+    private:
+        int ring = -1;
+        unsigned * sqHead;
+        unsigned * sqTail;
+        unsigned sqMask;
+        unsigned * sqArray;
+        void * sqEntries;
+        unsigned * cqHead;
+        unsigned * cqTail;
+        unsigned cqMask;
+        void * cqEntries;
+        void * sqRing = nullptr;
+        size_t sqRingSize = 0;
+        void * cqRing = nullptr;
+        size_t cqRingSize = 0;
+        size_t sqEntriesSize = 0;
+        unsigned sqCapacity = 0;
+        unsigned cqCapacity = 0;
+        std::mutex mutex;                       // guards the submission queue, waiting and inFlight.
+        std::condition_variable idle;
+        std::deque<UringOp*> waiting;           // steps not submitted yet, because the completion queue is full.
+        unsigned inFlight = 0;
+        std::thread completions;
+        int completed = -1;                     // eventfd the ring signals on every completion.
+        int stopped = -1;                       // eventfd that stops the completion thread.
+        UringFileReader() = default;
+        bool setup(unsigned entries);
+        void queue(UringOp * op);
+        void flush();
+        void reap();
+        void advance(UringOp * op, int result);
+        void fail(UringOp * op);
+    public:
+        ~UringFileReader();
+        static std::unique_ptr<UringFileReader> create(unsigned entries = 256); // nullptr if io_uring is unavailable.
+        std::vector<std::shared_ptr<FileRead>> readAll(std::vector<std::string> const& paths) override;
+        const char * name() const override;
+};
@@ -0,0 +1,377 @@
+#include "hocon-json.hpp"
+#include <charconv>
+#include <cstdlib>
+
+HJsonParser::HJsonParser(std::string_view source, bool strict, int maxDepth) : source(source), strict(strict), maxDepth(maxDepth) {}
+
+Diagnostic const& HJsonParser::getDiagnostic() const {
+    return diagnostic;
+}
+
+std::optional<std::variant<HTree*, HArray*>> HJsonParser::run() {
+    skipWhitespace();
+    std::variant<HTree*, HArray*, HSimpleValue*> root;
+    if (current >= source.size() || (source[current] != '{' && source[current] != '[')) {
+        fail("expected { or [ at the root");
+        return std::nullopt;
+    }
+    if (!parseValue(root)) {
+        return std::nullopt;
+    }
+    skipWhitespace();
+    if (current != source.size()) {
+        fail("expected the end of the file after the root value");
+        std::visit([](auto value) { delete value; }, root);
+        return std::nullopt;
+    }
+    if (std::holds_alternative<HTree*>(root)) {
+        return std::get<HTree*>(root);
+    }
+    return std::get<HArray*>(root);
+}
+
+void HJsonParser::skipWhitespace() {
+    while (current < source.size()) {
+        char c = source[current];
+        if (c == '\n') {
+            line++;
+        } else if (c != ' ' && c != '\t' && c != '\r') {
+            return;
+        }
+        current++;
+    }
+}
+
+/*
+    Records why the source was rejected.
+    @returns false, so callers can return fail(...) directly.
+*/
+bool HJsonParser::fail(std::string const& message) {
+    if (diagnostic.message.empty()) {
+        diagnostic = Diagnostic{DIAG_JSON, message, "", line, current};
+    }
+    return false;
+}
+
+/*
+    An object or array that parseValue has not finished yet. A value is added to it once complete, so a rejected
+    document is freed one open level at a time.
+*/
+struct JsonLevel {
+    HTree * tree = nullptr; // one of tree and arr is set.
+    HArray * arr = nullptr;
+    std::string key;        // of the member being parsed, in an object.
+};
+
+/*
+    Parses a value. The objects and arrays still open are kept on a stack of their own rather than the call stack, so
+    only maxDepth limits how deeply they may nest.
+    @returns false if the value was rejected, after freeing what was built of it.
+*/
+bool HJsonParser::parseValue(std::variant<HTree*, HArray*, HSimpleValue*>& out) {
+    std::vector<JsonLevel> open;
+    auto reject = [&open]() {
+        for (auto const& level : open) {
+            delete level.tree;
+            delete level.arr;
+        }
+        return false;
+    };
+    while (true) {
+        std::variant<HTree*, HArray*, HSimpleValue*> value;
+        if (current >= source.size()) {
+            fail("expected a value, got the end of the file");
+            return reject();
+        }
+        char c = source[current];
+        if ((c == '{' || c == '[') && (int) open.size() == maxDepth) {
+            fail("objects and arrays are nested deeper than " + std::to_string(maxDepth) + " levels");
+            return reject();
+        }
+        if (c == '{' || c == '[') {
+            current++;
+            JsonLevel level;
+            if (c == '{') {
+                level.tree = new HTree();
+            } else {
+                level.arr = new HArray();
+            }
+            open.push_back(level);
+            skipWhitespace();
+            if (current >= source.size() || source[current] != (c == '{' ? '}' : ']')) {
+                if (c == '{' && !parseKey(open.back().key)) {
+                    return reject();
+                }
+                skipWhitespace();
+                continue;
+            }
+            current++;
+            open.pop_back();
+            if (level.tree) {
+                value = level.tree;
+            } else {
+                value = level.arr;
+            }
+        } else if (c == '"') {
+            size_t start = current;
+            std::string text;
+            if (!parseString(text)) {
+                return reject();
+            }
+            std::string lexeme(source.substr(start, current - start));
+            value = new HSimpleValue(text, std::vector<Token>{Token(QUOTED_STRING, lexeme, text, line)}, 1);
+        } else {
+            HSimpleValue * simple = (c == '-' || (c >= '0' && c <= '9')) ? parseNumber() : parseKeyword();
+            if (!simple) {
+                return reject();
+            }
+            value = simple;
+        }
+
+        // the value is complete: add it to the innermost open level, and close the levels it completes.
+        while (true) {
+            if (open.empty()) {
+                out = value;
+                return true;
+            }
+            JsonLevel& level = open.back();
+            char close;
+            if (level.tree) {
+                if (level.tree->memberExists(level.key)) {
+                    if (!strict) { // HParser merges duplicate objects, which is left to it.
+                        fail("duplicate key '" + level.key + "'");
+                        std::visit([](auto v) { delete v; }, value);
+                        return reject();
+                    }
+                    std::visit([](auto v) { delete v; }, level.tree->members.at(level.key));
+                    level.tree->removeMember(level.key);
+                }
+                std::visit([&level](auto v) { level.tree->addMember(level.key, v); }, value);
+                close = '}';
+            } else {
+                std::visit([&level](auto v) { level.arr->addElement(v); }, value);
+                close = ']';
+            }
+            skipWhitespace();
+            if (current < source.size() && source[current] == ',') {
+                current++;
+                if (level.tree && !parseKey(level.key)) {
+                    return reject();
+                }
+                skipWhitespace();
+                break;
+            } else if (current < source.size() && source[current] == close) {
+                current++;
+                if (level.tree) {
+                    value = level.tree;
+                } else {
+                    value = level.arr;
+                }
+                open.pop_back();
+            } else if (level.tree) {
+                fail("expected ',' or '}' after the value of '" + level.key + "'");
+                return reject();
+            } else {
+                fail("expected ',' or ']' after an array element");
+                return reject();
+            }
+        }
+    }
+}
+
+/*
+    Parses the key of the next member of an object, and the ':' after it.
+    @returns false if they were rejected.
+*/
+bool HJsonParser::parseKey(std::string& key) {
+    skipWhitespace();
+    key.clear();
+    if (current >= source.size() || source[current] != '"') {
+        return fail("expected a quoted key");
+    }
+    if (!parseString(key)) {
+        return false;
+    }
+    if (key.empty() && !strict) {
+        return fail("HOCON does not allow empty keys");
+    }
+    skipWhitespace();
+    if (current >= source.size() || source[current] != ':') {
+        return fail("expected ':' after the key '" + key + "'");
+    }
+    current++;
+    skipWhitespace();
+    return true;
+}
+
+/*
+    Parses a JSON number. Integers are read like Lexer::number (an int, or rejected on overflow unless strict) and
+    fractions or exponents as doubles.
+*/
+HSimpleValue * HJsonParser::parseNumber() {
+    auto digit = [this](size_t i) { return i < source.size() && source[i] >= '0' && source[i] <= '9'; };
+    size_t start = current;
+    if (source[current] == '-') {
+        current++;
+    }
+    if (!digit(current)) {
+        fail("expected a digit");
+        return nullptr;
+    }
+    if (source[current] == '0' && digit(current + 1)) {
+        fail("leading zeros are not allowed");
+        return nullptr;
+    }
+    while (digit(current)) current++;
+    bool isDouble = false;
+    if (current < source.size() && source[current] == '.') {
+        current++;
+        if (!digit(current)) {
+            fail("expected a digit after '.'");
+            return nullptr;
+        }
+        while (digit(current)) current++;
+        isDouble = true;
+    }
+    if (current < source.size() && (source[current] == 'e' || source[current] == 'E')) {
+        current++;
+        if (current < source.size() && (source[current] == '+' || source[current] == '-')) current++;
+        if (!digit(current)) {
+            fail("expected a digit in the exponent");
+            return nullptr;
+        }
+        while (digit(current)) current++;
+        isDouble = true;
+    }
+    std::string lexeme(source.substr(start, current - start));
+    if (!isDouble) {
+        int value;
+        auto [end, ec] = std::from_chars(lexeme.data(), lexeme.data() + lexeme.size(), value);
+        if (ec == std::errc()) {
+            return new HSimpleValue(value, std::vector<Token>{Token(NUMBER, lexeme, value, line)}, 1);
+        }
+        if (!strict) {
+            fail("integer " + lexeme + " does not fit an int");
+            return nullptr;
+        }
+    }
+    double value = std::strtod(lexeme.c_str(), nullptr);
+    return new HSimpleValue(value, std::vector<Token>{Token(NUMBER, lexeme, value, line)}, 1);
+}
+
+/*
+    Parses true, false or null. The lexer reads null as an unquoted string, so it is kept as one here too.
+*/
+HSimpleValue * HJsonParser::parseKeyword() {
+    std::string_view rest = source.substr(current);
+    if (rest.substr(0, 4) == "true") {
+        current += 4;
+        return new HSimpleValue(true, std::vector<Token>{Token(TRUE, "true", true, line)}, 1);
+    } else if (rest.substr(0, 5) == "false") {
+        current += 5;
+        return new HSimpleValue(false, std::vector<Token>{Token(FALSE, "false", false, line)}, 1);
+    } else if (rest.substr(0, 4) == "null") {
+        current += 4;
+        std::string null("null");
+        return new HSimpleValue(null, std::vector<Token>{Token(UNQUOTED_STRING, null, null, line)}, 1);
+    }
+    fail("unexpected character '" + std::string(1, source[current]) + "'");
+    return nullptr;
+}
+
+/*
+    Parses a quoted string into out, assuming the current character is its opening quote. Runs without escapes are
+    appended in one piece.
+*/
+bool HJsonParser::parseString(std::string& out) {
+    current++;
+    size_t segment = current;
+    while (true) {
+        if (current >= source.size()) {
+            return fail("unterminated string");
+        }
+        char c = source[current];
+        if (c == '"') {
+            break;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            return fail("control character in a string");
+        } else if (c == '\\') {
+            if (!strict) {
+                return fail("string escapes are read differently by the HOCON lexer");
+            }
+            out.append(source.substr(segment, current - segment));
+            if (!parseEscape(out)) {
+                return false;
+            }
+            segment = current;
+        } else {
+            current++;
+        }
+    }
+    out.append(source.substr(segment, current - segment));
+    current++;
+    return true;
+}
+
+/*
+    Decodes the escape at the current backslash into out, encoding \u escapes (and surrogate pairs) as UTF-8.
+*/
+bool HJsonParser::parseEscape(std::string& out) {
+    auto hex = [this](uint32_t& code) {
+        if (current + 4 > source.size()) return false;
+        auto [end, ec] = std::from_chars(source.data() + current, source.data() + current + 4, code, 16);
+        if (ec != std::errc() || end != source.data() + current + 4) return false;
+        current += 4;
+        return true;
+    };
+    current++;
+    if (current >= source.size()) {
+        return fail("unterminated string");
+    }
+    char c = source[current++];
+    switch (c) {
+        case '"': out += '"'; return true;
+        case '\\': out += '\\'; return true;
+        case '/': out += '/'; return true;
+        case 'b': out += '\b'; return true;
+        case 'f': out += '\f'; return true;
+        case 'n': out += '\n'; return true;
+        case 'r': out += '\r'; return true;
+        case 't': out += '\t'; return true;
+        case 'u': break;
+        default: return fail("bad escape \\" + std::string(1, c));
+    }
+    uint32_t code;
+    if (!hex(code)) {
+        return fail("invalid \\u escape");
+    }
+    if (code >= 0xD800 && code <= 0xDBFF) {
+        if (source.substr(current, 2) != "\\u") {
+            return fail("unpaired surrogate in \\u escape");
+        }
+        current += 2;
+        uint32_t low;
+        if (!hex(low) || low < 0xDC00 || low > 0xDFFF) {
+            return fail("unpaired surrogate in \\u escape");
+        }
+        code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+    } else if (code >= 0xDC00 && code <= 0xDFFF) {
+        return fail("unpaired surrogate in \\u escape");
+    }
+    if (code < 0x80) {
+        out += static_cast<char>(code);
+    } else if (code < 0x800) {
+        out += static_cast<char>(0xC0 | (code >> 6));
+        out += static_cast<char>(0x80 | (code & 0x3F));
+    } else if (code < 0x10000) {
+        out += static_cast<char>(0xE0 | (code >> 12));
+        out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (code & 0x3F));
+    } else {
+        out += static_cast<char>(0xF0 | (code >> 18));
+        out += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (code & 0x3F));
+    }
+    return true;
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include "hocon-p.hpp"
+#include <optional>
+#include <string>
+#include <string_view>
+#include <variant>
+
+/*
+    Parser for configurations written in plain JSON. The final tree is built straight from the source text: there are
+    no whitespace tokens, no history stack and no substitution pass, since JSON has none of the features that need them.
+
+    When detecting (strict = false) the tree is exactly the one HParser builds from the same text, so run() gives up as
+    soon as the input is not strict JSON or uses something HParser reads differently: string escapes, empty keys,
+    duplicate keys and integers that do not fit an int. The caller then falls back to HParser.
+    When strict the input is known to be JSON: escapes are decoded, a duplicate key replaces the earlier value and large
+    integers are read as doubles.
+    Either way objects and arrays nested deeper than maxDepth are rejected.
+*/
+class HJsonParser {
+    private:
+        std::string_view source;
+        bool strict;
+        size_t current = 0;
+        int line = 1;
+        int maxDepth;
+        Diagnostic diagnostic{DIAG_JSON, "", "", 0, NO_OFFSET}; // of the first error, its message is empty until then.
+
+        void skipWhitespace();
+        bool fail(std::string const& message);
+        bool parseValue(std::variant<HTree*, HArray*, HSimpleValue*>& out);
+        bool parseKey(std::string& key);
+        HSimpleValue * parseNumber();
+        HSimpleValue * parseKeyword();
+        bool parseString(std::string& out);
+        bool parseEscape(std::string& out);
+    public:
+        HJsonParser(std::string_view source, bool strict, int maxDepth = DEFAULT_MAX_DEPTH);
+        std::optional<std::variant<HTree*, HArray*>> run(); // nullopt if the source was rejected, see getDiagnostic().
+        Diagnostic const& getDiagnostic() const; // why the source was rejected and where, file is left empty.
+};
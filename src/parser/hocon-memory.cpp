@@ -0,0 +1,174 @@
+#include "hocon-memory.hpp"
+#include "hocon-p.hpp"
+#include <sstream>
+
+typedef std::variant<HTree*, HArray*, HSimpleValue*, HSubstitution*> HValue;
+
+const char * memoryCategoryName(MemoryCategory category) {
+    static const char * names[MEM_COUNT] = {"tokens", "trees", "arrays", "simple_values", "token_parts", "substitutions", "keys", "stack", "path_index"};
+    return names[category];
+}
+
+uint64_t MemoryUsage::total() const {
+    uint64_t sum = 0;
+    for (int c = 0; c < MEM_COUNT; c++) {
+        sum += bytes[c];
+    }
+    return sum;
+}
+
+/*
+    One "name: bytes (count)" line per category, then the total.
+*/
+std::string MemoryUsage::str() const {
+    std::ostringstream out;
+    for (int c = 0; c < MEM_COUNT; c++) {
+        out << memoryCategoryName((MemoryCategory) c) << ": " << bytes[c] << " bytes (" << counts[c] << ")\n";
+    }
+    out << "total: " << total() << " bytes\n";
+    return out.str();
+}
+
+static uint64_t heapBytes(std::string const& str) {
+    return str.capacity() > 15 ? str.capacity() + 1 : 0; // shorter strings live in the string object itself.
+}
+
+template<typename T>
+static uint64_t vectorBytes(std::vector<T> const& vec) {
+    return vec.capacity() * sizeof(T);
+}
+
+static uint64_t tokenBytes(Token const& token) {
+    uint64_t bytes = heapBytes(token.lexeme);
+    if (std::holds_alternative<std::string>(token.literal)) {
+        bytes += heapBytes(std::get<std::string>(token.literal));
+    }
+    return bytes;
+}
+
+/*
+    Adds the nodes reachable from a set of roots to a MemoryUsage. The walk keeps its own work list instead of
+    recursing, so deeply nested configurations cannot overflow the call stack.
+*/
+class MemoryWalker {
+    private:
+        MemoryUsage& usage;
+        bool onStack;
+        std::vector<HValue> pending;
+
+        void add(MemoryCategory category, uint64_t bytes, uint64_t count) {
+            category = onStack ? MEM_STACK : category;
+            usage.bytes[category] += bytes;
+            usage.counts[category] += count;
+        }
+
+        void addKey(std::string const& key) {
+            add(MEM_KEYS, heapBytes(key), 1);
+        }
+
+        void visit(HTree * tree) {
+            typedef std::pair<const std::string, HValue> Member;
+            uint64_t mapBytes = tree->members.bucket_count() * sizeof(void*) + tree->members.size() * (sizeof(Member) + sizeof(void*) + sizeof(size_t));
+            add(MEM_TREES, sizeof(HTree) + mapBytes + vectorBytes(tree->memberOrder), 1);
+            addKey(tree->key);
+            for (auto const& member : tree->members) {
+                addKey(member.first);
+                pending.push_back(member.second);
+            }
+            for (auto const& key : tree->memberOrder) {
+                addKey(key);
+            }
+        }
+
+        void visit(HArray * arr) {
+            add(MEM_ARRAYS, sizeof(HArray) + vectorBytes(arr->elements), 1);
+            addKey(arr->key);
+            pending.insert(pending.end(), arr->elements.begin(), arr->elements.end());
+        }
+
+        void visit(HSimpleValue * val) {
+            uint64_t stringBytes = std::holds_alternative<std::string>(val->svalue) ? heapBytes(std::get<std::string>(val->svalue)) : 0;
+            add(MEM_SIMPLE_VALUES, sizeof(HSimpleValue) + stringBytes, 1);
+            addKey(val->key);
+            uint64_t partBytes = vectorBytes(val->tokenParts);
+            for (auto const& token : val->tokenParts) {
+                partBytes += tokenBytes(token);
+            }
+            add(MEM_TOKEN_PARTS, partBytes, val->tokenParts.size());
+        }
+
+        void visit(HSubstitution * sub) {
+            uint64_t bytes = sizeof(HSubstitution) + vectorBytes(sub->values) + vectorBytes(sub->includePrefix) + vectorBytes(sub->paths);
+            bytes += sub->interrupts.capacity() / 8;
+            for (auto const& segment : sub->includePrefix) {
+                bytes += heapBytes(segment);
+            }
+            for (auto const& value : sub->values) {
+                if (std::holds_alternative<HPath*>(value)) {
+                    HPath * path = std::get<HPath*>(value);
+                    bytes += sizeof(HPath) + vectorBytes(path->path) + heapBytes(path->suffixWhitespace);
+                    for (auto const& segment : path->path) {
+                        bytes += heapBytes(segment);
+                    }
+                } else if (std::holds_alternative<HTree*>(value)) {
+                    pending.push_back(std::get<HTree*>(value));
+                } else if (std::holds_alternative<HArray*>(value)) {
+                    pending.push_back(std::get<HArray*>(value));
+                } else {
+                    pending.push_back(std::get<HSimpleValue*>(value));
+                }
+            }
+            add(MEM_SUBSTITUTIONS, bytes, 1);
+            addKey(sub->key);
+            if (sub->resolved && !sub->resolveFailed) {
+                std::visit([this](auto node) {
+                    if (node) pending.push_back(node);
+                }, sub->resolvedValue);
+            }
+        }
+    public:
+        MemoryWalker(MemoryUsage& usage, bool onStack) : usage(usage), onStack(onStack) {}
+
+        void walk(HValue root) {
+            pending.push_back(root);
+            while (!pending.empty()) {
+                HValue value = pending.back();
+                pending.pop_back();
+                std::visit([this](auto node) {
+                    if (node) visit(node);
+                }, value);
+            }
+        }
+};
+
+MemoryUsage measureTokens(std::vector<Token> const& tokens) {
+    MemoryUsage usage;
+    usage.bytes[MEM_TOKENS] = vectorBytes(tokens);
+    usage.counts[MEM_TOKENS] = tokens.size();
+    for (auto const& token : tokens) {
+        usage.bytes[MEM_TOKENS] += tokenBytes(token);
+    }
+    return usage;
+}
+
+/*
+    Memory currently held by a parser: its token list, its tree and its substitution stack.
+*/
+MemoryUsage measureMemory(HParser const& parser) {
+    MemoryUsage usage = measureTokens(parser.tokenList);
+    std::visit([&usage](auto root) { MemoryWalker(usage, false).walk(root); }, parser.rootObject);
+    usage.bytes[MEM_STACK] += vectorBytes(parser.stack);
+    MemoryWalker stackWalker(usage, true);
+    for (auto const& entry : parser.stack) {
+        usage.bytes[MEM_STACK] += vectorBytes(entry.first);
+        for (auto const& segment : entry.first) {
+            usage.bytes[MEM_STACK] += heapBytes(segment);
+        }
+        stackWalker.walk(entry.second);
+    }
+    if (parser.pathIndex) {
+        usage.bytes[MEM_PATH_INDEX] = parser.pathIndex->bytes() + vectorBytes(parser.indexedNodes);
+        usage.counts[MEM_PATH_INDEX] = parser.pathIndex->size();
+    }
+    return usage;
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <variant>
+#include <vector>
+#include <token.hpp>
+
+class HParser;
+
+/*
+    Where a loaded configuration keeps its memory. Node categories hold the node objects and their containers; the
+    strings they own are split out into KEYS (member keys, which are stored in the members map, in memberOrder and in
+    the child node) and TOKEN_PARTS (the tokens every HSimpleValue keeps for concatenation and rendering). Everything
+    reachable from HParser::stack, which holds a deep copy of each assignment for substitution lookups, is counted
+    under STACK instead of its own category. PATH_INDEX is the optional path index, its copy of every full path included.
+*/
+enum MemoryCategory {
+    MEM_TOKENS, MEM_TREES, MEM_ARRAYS, MEM_SIMPLE_VALUES, MEM_TOKEN_PARTS, MEM_SUBSTITUTIONS, MEM_KEYS, MEM_STACK, MEM_PATH_INDEX, MEM_COUNT
+};
+
+const char * memoryCategoryName(MemoryCategory category);
+
+/*
+    Bytes and object counts per category. Sizes are computed from the containers (capacity, bucket count, string
+    capacity beyond the small string buffer) rather than measured from the allocator, so allocator overhead is not
+    included; they are meant for comparing categories and loads, not for matching RSS exactly.
+*/
+struct MemoryUsage {
+    uint64_t bytes[MEM_COUNT] = {};
+    uint64_t counts[MEM_COUNT] = {};
+    uint64_t total() const;
+    std::string str() const;
+};
+
+MemoryUsage measureMemory(HParser const& parser);
+MemoryUsage measureTokens(std::vector<Token> const& tokens);
@@ -1,8 +1,14 @@
 #include "hocon-p.hpp"
+#include "hocon-writer.hpp"
+#include "hocon-include.hpp"
+#include <algorithm>
+#include <deque>
+#include <unistd.h>
+#include <cstring>
 
 const std::string INDENT = "    "; 
 
-bool debug = false;
+thread_local bool debug = false; // per thread, so turning on annotated str() output cannot race with other loads.
 
 std::string pathToString(std::vector<std::string> path) {
     std::string out = path.size() > 0 ? path[0] : "";
@@ -12,9 +18,19 @@ std::string pathToString(std::vector<std::string> path) {
     return out;
 }
 
-std::string getEnvVar( std::string const& key ) {
-    char * val = std::getenv( key.c_str() );
-    return val == NULL ? std::string("") : std::string(val);
+/*
+    Copies the process environment. Reading it once per load keeps getenv off the resolution path, and a load never
+    sees a setenv from another thread half way.
+*/
+std::shared_ptr<const VariableMap> captureEnvironment() {
+    auto out = std::make_shared<VariableMap>();
+    for (char ** entry = environ; entry && *entry; entry++) {
+        const char * separator = std::strchr(*entry, '=');
+        if (separator) {
+            out->emplace(std::string(*entry, separator - *entry), std::string(separator + 1));
+        }
+    }
+    return out;
 }
 
 template<typename ... Ts>                                                 
@@ -53,11 +69,34 @@ auto subDeepCopy = Overload {
     [](HPath * path) { std::variant<HTree*, HArray *, HSimpleValue *, HPath*> out = path->deepCopy(); return out; },
 };
 
-auto getPathStr = Overload {
-    [](HTree * obj) { return obj->getPath(); },
-    [](HArray * arr) { return arr->getPath(); },
-    [](HSimpleValue * val) { return val->getPath(); },
-    [](HSubstitution * sub) { return sub->getPath(); },
+/*
+    Absolute path of the member key of parent. Collects the keys walking up the parents and reverses them once, so the
+    cost is linear in the depth.
+*/
+static std::vector<std::string> pathBelow(std::variant<HTree*, HArray*> parent, std::string const& key) {
+    std::vector<std::string> path{key};
+    while (true) {
+        if (std::holds_alternative<HTree*>(parent)) {
+            HTree * obj = std::get<HTree*>(parent);
+            if (!obj || obj->root) break;
+            path.push_back(obj->key);
+            parent = obj->parent;
+        } else {
+            HArray * arr = std::get<HArray*>(parent);
+            if (!arr || arr->root) break;
+            path.push_back(arr->key);
+            parent = arr->parent;
+        }
+    }
+    std::reverse(path.begin(), path.end());
+    return path;
+}
+
+auto getParent = Overload {
+    [](HTree * obj) { return obj->parent; },
+    [](HArray * arr) { return arr->parent; },
+    [](HSimpleValue * val) { return val->parent; },
+    [](HSubstitution * sub) { return sub->parent; }
 };
 
 auto getKey = Overload {
@@ -135,12 +174,71 @@ auto setParentAndKey = Overload {
     [](HSubstitution * obj, HArray * parent, std::string key) {obj->parent = parent; obj->key = key;},
 };
 
-HTree::HTree() : members(std::unordered_map<std::string, std::variant<HTree*, HArray*, HSimpleValue*, HSubstitution*>>()) {}
+HTree::HTree() : members(std::unordered_map<std::string, std::variant<HTree*, HArray*, HSimpleValue*, HSubstitution*>>()) {
+    countStat(COUNT_NODES);
+}
+
+/*
+    Moves the values of sub and its cached resolution to pending, deleting its paths, and leaves sub without any.
+*/
+static void takeSubstitutionValues(HSubstitution * sub, std::vector<std::variant<HTree*, HArray*, HSimpleValue*, HSubstitution*>>& pending) {
+    for (auto const& value : sub->values) {
+        switch (value.index()) {
+            case 0: pending.push_back(std::get<HTree*>(value)); break;
+            case 1: pending.push_back(std::get<HArray*>(value)); break;
+            case 2: pending.push_back(std::get<HSimpleValue*>(value)); break;
+            case 3: delete std::get<HPath*>(value); break;
+        }
+    }
+    sub->values.clear();
+    sub->paths.clear();
+    std::visit([&pending](auto * value) { pending.push_back(value); }, sub->resolvedValue);
+    sub->resolvedValue = static_cast<HTree*>(nullptr);
+}
+
+/*
+    Deletes every node in pending and below it without recursing: a tree, array or substitution is emptied before it is
+    deleted and its children are added to pending instead, so its own destructor has nothing left to delete.
+*/
+static void deleteNodes(std::vector<std::variant<HTree*, HArray*, HSimpleValue*, HSubstitution*>> pending) {
+    while (!pending.empty()) {
+        std::variant<HTree*, HArray*, HSimpleValue*, HSubstitution*> node = pending.back();
+        pending.pop_back();
+        if (std::holds_alternative<HTree*>(node)) {
+            HTree * obj = std::get<HTree*>(node);
+            if (!obj) continue;
+            for (auto const& pair : obj->members) {
+                pending.push_back(pair.second);
+            }
+            obj->members.clear();
+            delete obj;
+        } else if (std::holds_alternative<HArray*>(node)) {
+            HArray * arr = std::get<HArray*>(node);
+            if (!arr) continue;
+            pending.insert(pending.end(), arr->elements.begin(), arr->elements.end());
+            arr->elements.clear();
+            delete arr;
+        } else if (std::holds_alternative<HSimpleValue*>(node)) {
+            delete std::get<HSimpleValue*>(node);
+        } else {
+            HSubstitution * sub = std::get<HSubstitution*>(node);
+            if (!sub) continue;
+            takeSubstitutionValues(sub, pending);
+            delete sub;
+        }
+    }
+}
 
 HTree::~HTree() {
-    for(auto pair : members) {
-        std::visit(deleteHObj, pair.second);
+    if (members.empty()) {
+        return;
+    }
+    std::vector<std::variant<HTree*, HArray*, HSimpleValue*, HSubstitution*>> children;
+    children.reserve(members.size());
+    for (auto const& pair : members) {
+        children.push_back(pair.second);
     }
+    deleteNodes(std::move(children));
 }
 
 bool HTree::addMember(std::string const& key, std::variant<HTree*, HArray*, HSimpleValue*, HSubstitution*> value) {
@@ -227,7 +325,7 @@ bool HTree::addMember(std::string const& key, std::variant<HTree*, HArray*, HSim
     return false;
 }
 
-bool HTree::memberExists(std::string const& key) {
+bool HTree::memberExists(std::string const& key) const {
     return members.count(key) != 0;
 }
 
@@ -241,22 +339,117 @@ void HTree::removeMember(std::string const& key) {
     }
 }
 
-HTree * HTree::deepCopy() {
-    HTree * copy = new HTree();
-    for (auto pair : members) {
-        copy->addMember(pair.first, std::visit(getDeepCopy, pair.second));
+/*
+    Deep copies with a work list instead of recursing. A tree or array is copied empty and queued together with its
+    original, and its members are copied when the pair is taken off the list; a lazily resolved substitution is copied
+    as its value, or dropped if it resolved to nothing. Call run() once the roots were queued.
+*/
+struct TreeCopier {
+    std::vector<std::pair<std::variant<HTree*, HArray*>, std::variant<HTree*, HArray*>>> pending; // original, copy.
+
+    HTree * emptyCopy(HTree * original) {
+        countStat(COUNT_DEEP_COPIES);
+        HTree * copy = new HTree();
+        pending.push_back(std::make_pair(original, copy));
+        return copy;
+    }
+
+    HArray * emptyCopy(HArray * original) {
+        countStat(COUNT_DEEP_COPIES);
+        HArray * copy = new HArray();
+        pending.push_back(std::make_pair(original, copy));
+        return copy;
+    }
+
+    HSubstitution * copySubstitution(HSubstitution * original) {
+        countStat(COUNT_DEEP_COPIES);
+        std::vector<std::variant<HTree*, HArray*, HSimpleValue*, HPath*>> copies;
+        for (auto const& value : original->values) {
+            switch (value.index()) {
+                case 0: {
+                    HTree * tree = emptyCopy(std::get<HTree*>(value));
+                    tree->parent = std::get<HTree*>(value)->parent;
+                    tree->key = std::get<HTree*>(value)->key;
+                    tree->root = std::get<HTree*>(value)->root;
+                    copies.push_back(tree);
+                    break;
+                }
+                case 1: copies.push_back(emptyCopy(std::get<HArray*>(value))); break;
+                case 2: copies.push_back(std::get<HSimpleValue*>(value)->deepCopy()); break;
+                case 3: copies.push_back(std::get<HPath*>(value)->deepCopy()); break;
+            }
+        }
+        HSubstitution * copy = new HSubstitution(copies);
+        copy->parent = original->parent;
+        copy->key = original->key;
+        copy->interrupts = original->interrupts;
+        copy->substitutionType = original->substitutionType;
+        copy->includePrefix = original->includePrefix;
+        return copy;
+    }
+
+    /*
+        @returns false if value is a substitution that resolved to nothing, which is not copied.
+    */
+    bool copyValue(std::variant<HTree*, HArray*, HSimpleValue*, HSubstitution*> value, std::variant<HTree*, HArray*, HSimpleValue*, HSubstitution*>& copy) {
+        if (std::holds_alternative<HSubstitution*>(value) && std::get<HSubstitution*>(value)->resolved) {
+            HSubstitution * sub = std::get<HSubstitution*>(value);
+            if (std::holds_alternative<HTree*>(sub->resolvedValue) && !std::get<HTree*>(sub->resolvedValue)) {
+                return false;
+            }
+            std::visit([&value](auto * resolved) { value = resolved; }, sub->resolvedValue);
+        }
+        switch (value.index()) {
+            case 0: copy = emptyCopy(std::get<HTree*>(value)); break;
+            case 1: copy = emptyCopy(std::get<HArray*>(value)); break;
+            case 2: copy = std::get<HSimpleValue*>(value)->deepCopy(); break;
+            case 3: copy = copySubstitution(std::get<HSubstitution*>(value)); break;
+        }
+        return true;
+    }
+
+    void run() {
+        std::variant<HTree*, HArray*, HSimpleValue*, HSubstitution*> copy;
+        while (!pending.empty()) {
+            auto [original, target] = pending.back();
+            pending.pop_back();
+            if (std::holds_alternative<HTree*>(original)) {
+                HTree * from = std::get<HTree*>(original);
+                for (auto const& key : from->memberOrder) {
+                    if (copyValue(from->members.at(key), copy)) {
+                        std::get<HTree*>(target)->addMember(key, copy);
+                    }
+                }
+            } else {
+                for (auto const& e : std::get<HArray*>(original)->elements) {
+                    if (copyValue(e, copy)) {
+                        std::get<HArray*>(target)->addElement(copy);
+                    }
+                }
+            }
+        }
     }
+};
+
+HTree * HTree::deepCopy() {
+    TreeCopier copier;
+    HTree * copy = copier.emptyCopy(this);
+    copier.run();
     copy->parent = this->parent;
     copy->key = this->key;
     copy->root = this->root;
     return copy;
-} 
-
+}
 
-std::string HTree::str() {
+std::string HTree::str() const {
     if(members.empty()) {
         return "{}";
     }
+    if (!debug) { // the writer renders in one pass; debug output below also annotates every node with its path.
+        std::string out;
+        HWriter(out, RENDER_HOCON).write(this);
+        return out;
+    }
     std::string out = "{\n";
     if (debug) {
         std::vector<std::string> test = getPath();
@@ -273,7 +466,7 @@ std::string HTree::str() {
     
     for(size_t i = 0; i < memberOrder.size(); i++) {
         std::string keyval = memberOrder[i];
-        auto value = members[keyval];
+        auto value = members.at(keyval);
         out += INDENT + keyval + " : ";
         if (std::holds_alternative<HTree*>(value)) {
             std::string string = std::get<HTree*>(value)->str();
@@ -306,13 +499,11 @@ std::string HTree::str() {
 /*
     Returns the absolute path to the current HTree.
 */
-std::vector<std::string> HTree::getPath() {
+std::vector<std::string> HTree::getPath() const {
     if (root == true) {
         return std::vector<std::string>();
     } else {
-        std::vector<std::string> parentPath = std::visit(getPathStr, parent);
-        parentPath.push_back(key);
-        return parentPath;
+        return pathBelow(parent, key);
     }
 }
 
@@ -321,49 +512,84 @@ std::vector<std::string> HTree::getPath() {
     Remember to delete the second pointer after finishing.
 */
 void HTree::mergeTrees(HTree * second) {
-    for(auto pair : second->members) {
-        if (members.count(pair.first) == 0) { // not exist case;
-            addMember(pair.first, std::visit(getDeepCopy, pair.second));
-        } else if (std::holds_alternative<HTree*>(members[pair.first]) && std::holds_alternative<HTree*>(pair.second)) { // exists, both objects
-            HTree * obj = std::get<HTree*>(std::visit(getDeepCopy, pair.second));
-            std::get<HTree*>(members[pair.first])->mergeTrees(obj);
-            delete obj;
-        } else { // exists but not both objects
-            //std::visit(deleteHObj, members[pair.first]);
-            addMember(pair.first, std::visit(getDeepCopy, pair.second));
+    std::vector<std::pair<HTree*, HTree*>> pending{std::make_pair(this, second)}; // objects to merge into, from.
+    while (!pending.empty()) {
+        auto [target, source] = pending.back();
+        pending.pop_back();
+        for (auto const& pair : source->members) {
+            std::variant<HTree*, HArray*, HSimpleValue*, HSubstitution*> value = pair.second;
+            if (source != second && std::holds_alternative<HSubstitution*>(value) && std::get<HSubstitution*>(value)->resolved) {
+                // below the top level the members used to be merged from a deep copy, which holds resolved values.
+                HSubstitution * sub = std::get<HSubstitution*>(value);
+                if (std::holds_alternative<HTree*>(sub->resolvedValue) && !std::get<HTree*>(sub->resolvedValue)) {
+                    continue;
+                }
+                std::visit([&value](auto * resolved) { value = resolved; }, sub->resolvedValue);
+            }
+            auto found = target->members.find(pair.first);
+            if (found != target->members.end() && std::holds_alternative<HTree*>(found->second) && std::holds_alternative<HTree*>(value)) { // exists, both objects
+                pending.push_back(std::make_pair(std::get<HTree*>(found->second), std::get<HTree*>(value)));
+            } else { // not exist case, or exists but not both objects
+                target->addMember(pair.first, std::visit(getDeepCopy, value));
+            }
         }
     }
 }
 
-std::unordered_set<HSubstitution*> HTree::getUnresolvedSubs() {
+/*
+    Collects every substitution below the tree or array with a work list instead of recursing. Substitutions are not
+    descended into.
+*/
+static std::unordered_set<HSubstitution*> collectSubstitutions(std::variant<HTree*, HArray*, HSimpleValue*, HSubstitution*> root) {
     std::unordered_set<HSubstitution*> out;
-    for (auto pair : members) {
-        std::unordered_set<HSubstitution*> curr = std::visit(getSubstitutions, pair.second);
-        out.merge(curr);
+    std::vector<std::variant<HTree*, HArray*, HSimpleValue*, HSubstitution*>> pending{root};
+    while (!pending.empty()) {
+        std::variant<HTree*, HArray*, HSimpleValue*, HSubstitution*> node = pending.back();
+        pending.pop_back();
+        if (std::holds_alternative<HTree*>(node)) {
+            for (auto const& pair : std::get<HTree*>(node)->members) {
+                pending.push_back(pair.second);
+            }
+        } else if (std::holds_alternative<HArray*>(node)) {
+            HArray * arr = std::get<HArray*>(node);
+            pending.insert(pending.end(), arr->elements.begin(), arr->elements.end());
+        } else if (std::holds_alternative<HSubstitution*>(node)) {
+            out.insert(std::get<HSubstitution*>(node));
+        }
     }
     return out;
 }
 
-HArray::HArray() : elements(std::vector<std::variant<HTree*, HArray*, HSimpleValue*, HSubstitution*>>()) {}
+std::unordered_set<HSubstitution*> HTree::getUnresolvedSubs() {
+    return collectSubstitutions(this);
+}
+
+HArray::HArray() : elements(std::vector<std::variant<HTree*, HArray*, HSimpleValue*, HSubstitution*>>()) {
+    countStat(COUNT_NODES);
+}
 
 HArray::~HArray() {
-    for (auto e : elements) {
-        std::visit(deleteHObj, e);
+    if (!elements.empty()) {
+        deleteNodes(std::move(elements));
     }
 }
 
 HArray * HArray::deepCopy() {
-    HArray * copy = new HArray();
-    for(auto e : elements) {
-        copy->addElement(std::visit(getDeepCopy, e));
-    }
+    TreeCopier copier;
+    HArray * copy = copier.emptyCopy(this);
+    copier.run();
     return copy;
 }
 
-std::string HArray::str() { // tested,
+std::string HArray::str() const { // tested,
     if(elements.empty()) {
         return "[]";
     }
+    if (!debug) {
+        std::string out;
+        HWriter(out, RENDER_HOCON).write(this);
+        return out;
+    }
     std::string out = "[ \n";
     if (debug) {
         std::vector<std::string> test = getPath();
@@ -409,13 +635,11 @@ std::string HArray::str() { // tested,
     return out;
 }
 
-std::vector<std::string> HArray::getPath() {
+std::vector<std::string> HArray::getPath() const {
     if (root == true) {
         return std::vector<std::string>();
     } else {
-        std::vector<std::string> parentPath = std::visit(getPathStr, parent);
-        parentPath.push_back(key);
-        return parentPath;
+        return pathBelow(parent, key);
     }
 }
 
@@ -463,17 +687,14 @@ void HArray::concatArrays(HArray * second) {
 }
 
 std::unordered_set<HSubstitution*> HArray::getUnresolvedSubs() {
-    std::unordered_set<HSubstitution*> out;
-    for (auto e : elements) {
-        std::unordered_set<HSubstitution*> curr = std::visit(getSubstitutions, e);
-        out.merge(curr);
-    }
-    return out;
+    return collectSubstitutions(this);
 }
 
-HSimpleValue::HSimpleValue(std::variant<int, double, bool, std::string> s, std::vector<Token> tokenParts, size_t end): svalue(s), tokenParts(tokenParts), defaultEnd(end) {}
+HSimpleValue::HSimpleValue(std::variant<int, double, bool, std::string> s, std::vector<Token> tokenParts, size_t end): svalue(s), tokenParts(tokenParts), defaultEnd(end) {
+    countStat(COUNT_NODES);
+}
 
-std::string HSimpleValue::str() {
+std::string HSimpleValue::str() const {
     std::string output;
     if (std::holds_alternative<std::string>(svalue)) {
         output = (std::get<std::string>(svalue)[0] == '"') ? std::get<std::string>(svalue) : "\"" + std::get<std::string>(svalue) + "\"";
@@ -492,13 +713,12 @@ std::string HSimpleValue::str() {
     return output;
 }
 
-std::vector<std::string> HSimpleValue::getPath() {
-    std::vector<std::string> parentPath = std::visit(getPathStr, parent);
-    parentPath.push_back(key);
-    return parentPath;
+std::vector<std::string> HSimpleValue::getPath() const {
+    return pathBelow(parent, key);
 }
 
 HSimpleValue* HSimpleValue::deepCopy() {
+    countStat(COUNT_DEEP_COPIES);
     return new HSimpleValue(svalue, tokenParts, defaultEnd);
 }
 
@@ -529,7 +749,7 @@ HPath::HPath(Token t) {
     }
 }
 
-std::string HPath::str() {
+std::string HPath::str() const {
     std::string out;
     out += (optional ? "${?" : "${");
     if (path.size() > 0) {
@@ -573,6 +793,7 @@ bool HPath::isSelfReference() {
 }
 
 HSubstitution::HSubstitution(std::vector<std::variant<HTree*, HArray*, HSimpleValue*, HPath*>> v) {
+    countStat(COUNT_NODES);
     values = v;
     for(auto val : values) {
         if(std::holds_alternative<HPath*>(val)) {
@@ -584,12 +805,12 @@ HSubstitution::HSubstitution(std::vector<std::variant<HTree*, HArray*, HSimpleVa
 }
 
 HSubstitution::~HSubstitution() {
-    for (auto obj : values) {
-        std::visit(deleteHObj, obj);
-    }
+    std::vector<std::variant<HTree*, HArray*, HSimpleValue*, HSubstitution*>> children;
+    takeSubstitutionValues(this, children);
+    deleteNodes(std::move(children));
 }
 
-std::string HSubstitution::str() {
+std::string HSubstitution::str() const {
     std::string out;
     if (values.size() > 0) {
         if (std::holds_alternative<HTree*>(values[0])) {
@@ -644,27 +865,17 @@ std::string HSubstitution::str() {
 }
 
 HSubstitution * HSubstitution::deepCopy() {
-    //HArray * copy = new HArray();
-    std::vector<std::variant<HTree*,HArray*,HSimpleValue*, HPath*>> copies; 
-    for (auto obj : values) {
-        copies.push_back(std::visit(subDeepCopy, obj));
-    }
-    HSubstitution * copy = new HSubstitution(copies);
-    copy->parent = this->parent;
-    copy->key = this->key;
-    copy->interrupts = this->interrupts;
-    copy->substitutionType = this->substitutionType;
-    copy->includePrefix = this->includePrefix;
+    TreeCopier copier;
+    HSubstitution * copy = copier.copySubstitution(this);
+    copier.run();
     return copy;
 }
 
-std::vector<std::string> HSubstitution::getPath() {
+std::vector<std::string> HSubstitution::getPath() const {
     if (std::holds_alternative<HTree*>(parent)) {
         if(!std::get<HTree*>(parent)) return std::vector<std::string>{"getpath on sub failed..."};
     }
-    std::vector<std::string> parentPath = std::visit(getPathStr, parent);
-    parentPath.push_back(key);
-    return parentPath;
+    return pathBelow(parent, key);
 }
 
 HParser::HParser(HTree * newRoot) {
@@ -676,6 +887,7 @@ HParser::HParser(HArray * newRoot) {
 }
 
 HParser::~HParser() {
+    discardPrefetched();
     //std::visit(deleteHObj, rootObject);
     for(auto pair : stack) {
         std::visit(deleteHObj, pair.second);
@@ -683,6 +895,7 @@ HParser::~HParser() {
     for(auto sub : unresolvedSubs) {
         delete sub;
     }
+    delete pathIndex;
 }
 
 // look ahead/back helpers
@@ -734,7 +947,10 @@ void HParser::getStack() {
 /*
     Takes a root path to the value, and a pointer to the value, and pushes it to the stack.
 */
-void HParser::pushStack(std::vector<std::string> path, std::variant<HTree*,HArray*,HSimpleValue*,HSubstitution*> value) {
+void HParser::pushStack(std::vector<std::string> const& path, std::variant<HTree*,HArray*,HSimpleValue*,HSubstitution*> value) {
+    if (!recordStack) {
+        return;
+    }
     if(std::holds_alternative<HSubstitution*>(value)) {
         HSubstitution* sub = std::get<HSubstitution*>(value); 
         HTree * handle = std::get<HTree*>(sub->parent);
@@ -752,6 +968,7 @@ void HParser::pushStack(std::vector<std::string> path, std::variant<HTree*,HArra
     if (std::holds_alternative<HSubstitution*>(temp)) {
         handle = std::get<HSubstitution*>(temp);
     }
+    countStat(COUNT_STACK_ENTRIES);
     stack.push_back(std::make_pair(path, temp)); // leave it for now, a potential fix if this causes memory issues is creating a new tree that points to earlier copies in the stack, instead of creating a new deep copy.
 }
 
@@ -788,64 +1005,154 @@ void HParser::ignoreInlineWhitespace() {
         advance();
     }
 }
+// explicit parse stack
+
 /*
-    panic mode method to consume until the next member to parse.
+    The routines that parse objects, arrays and the values made of them. Each runs as a frame of HParser::runFrames
+    instead of a call, so a document nested n levels deep costs n frames on the heap rather than n calls on the call
+    stack, and only maxDepth limits how deeply it may nest.
 */
-void HParser::consumeMember() {
-    while(!check(std::vector<TokenType>{NEWLINE, COMMA, RIGHT_BRACE}) && !atEnd()) {
-        if(match(LEFT_BRACE)) {
-            delete hoconTree(std::vector<std::string>());
-        } else if (match(LEFT_BRACKET)) {
-            delete hoconArray();
-        }
-        else advance();
-    }
-    match(std::vector<TokenType>{NEWLINE, COMMA});
-    ignoreAllWhitespace();
-}
+enum FrameKind {
+    FRAME_TREE,             // hoconTree
+    FRAME_ARRAY_SUBTREE,    // hoconArraySubTree
+    FRAME_ARRAY,            // hoconArray
+    FRAME_MERGE_TREES,      // mergeAdjacentTrees
+    FRAME_MERGE_SUBTREES,   // the same, for objects in arrays
+    FRAME_CONCAT_ARRAYS,    // concatAdjacentArrays
+    FRAME_SUBSTITUTION,     // parseSubstitution
+    FRAME_SKIP              // consumeMember, and its element and substitution versions
+};
 
 /*
-    panic mode method to consume until the next element to parse.
+    Where a frame goes on from, usually once the frame it started returned.
 */
-void HParser::consumeElement() {
-    while(!check(std::vector<TokenType>{NEWLINE, COMMA, RIGHT_BRACKET}) && !atEnd()) {
-        if(match(LEFT_BRACE)) {
-            delete hoconTree(std::vector<std::string>());
-        } else if (match(LEFT_BRACKET)) {
-            delete hoconArray();
+enum FrameStep {
+    STEP_START,
+    STEP_NEXT,          // the next member, element or value.
+    STEP_OBJECT,        // an object, or a chain of adjacent ones, was parsed.
+    STEP_ARRAY,         // likewise for arrays.
+    STEP_SUBSTITUTION,  // a substitution was parsed.
+    STEP_APPEND,        // the array of a += was parsed.
+    STEP_SEPARATOR,     // the value of a member or element is done, its separator is next.
+    STEP_INCLUDED,      // an include was spliced in place of the object.
+    STEP_SKIPPED,       // an object or array was parsed by a skip, and is thrown away.
+    STEP_ABORTED,       // a substitution of mismatched types was skipped.
+    STEP_END
+};
+
+struct ParseFrame {
+    FrameKind kind;
+    FrameStep step = STEP_START;
+    bool nesting = false;                       // the frame counts one level of depth, until it returns.
+    std::vector<std::string> * rootPath = nullptr; // extended in place by trees and chains of trees, ownPath if null.
+    std::vector<std::string> ownPath;
+    size_t parentSize = 0;
+    HTree * output = nullptr;                   // of trees, and chains of trees.
+    HTree * target = nullptr;
+    HTree * included = nullptr;
+    HArray * array = nullptr;                   // of arrays, and chains of arrays.
+    std::vector<std::string> key;               // of the member being parsed.
+    bool separated = false;                     // the member has an explicit separator, ex: foo = {}.
+    std::vector<std::variant<HTree*, HArray*, HSimpleValue*, HPath*>> values; // of a substitution.
+    size_t subType = 3;
+    bool prefixed = false;                      // the substitution started with a value parsed before it.
+    bool addingToStack = false;
+    std::vector<TokenType> stops;               // of a skip.
+    bool afterPrevious = false;                 // the skip parses the object or array the previous token opened.
+
+    ParseFrame(FrameKind kind) : kind(kind) {}
+    std::vector<std::string>& path() { return rootPath ? *rootPath : ownPath; }
+};
+
+/*
+    The frames of HParser::runFrames. The innermost is at the back; a std::deque, so that pushing a frame leaves the
+    others where they are.
+*/
+struct ParseStack {
+    std::deque<ParseFrame> frames;
+    std::variant<HTree*, HArray*, HSubstitution*> returned; // by the frame that returned last.
+    int& depth;
+
+    ParseStack(int& depth) : depth(depth) {}
+    ParseFrame& top() { return frames.back(); }
+    void call(FrameStep resume, ParseFrame frame) { // the innermost frame goes on from resume once frame returned.
+        frames.back().step = resume;
+        frames.push_back(std::move(frame));
+    }
+    void ret(std::variant<HTree*, HArray*, HSubstitution*> value) {
+        if (frames.back().nesting) {
+            depth--;
         }
-        else advance();
+        returned = value;
+        frames.pop_back();
     }
-    match(std::vector<TokenType>{NEWLINE, COMMA});
-    ignoreAllWhitespace();
+};
+
+static ParseFrame extendingTree(std::vector<std::string>& rootPath) {
+    ParseFrame frame(FRAME_TREE);
+    frame.rootPath = &rootPath;
+    return frame;
+}
+
+static ParseFrame copyingTree(std::vector<std::string> const& parentPath) {
+    ParseFrame frame(FRAME_TREE);
+    frame.ownPath = parentPath;
+    return frame;
+}
+
+static ParseFrame mergingTrees(std::vector<std::string>& rootPath) {
+    ParseFrame frame(FRAME_MERGE_TREES);
+    frame.rootPath = &rootPath;
+    return frame;
+}
+
+static ParseFrame substitutionFrame(std::vector<std::string> const& parentPath, bool addingToStack) {
+    ParseFrame frame(FRAME_SUBSTITUTION);
+    frame.ownPath = parentPath;
+    frame.addingToStack = addingToStack;
+    return frame;
+}
+
+static ParseFrame substitutionFrame(std::variant<HTree*, HArray*, HSimpleValue*> prefix, std::vector<std::string> const& parentPath, bool addingToStack) {
+    ParseFrame frame = substitutionFrame(parentPath, addingToStack);
+    frame.prefixed = true;
+    frame.subType = prefix.index();
+    std::visit([&frame](auto * value) { frame.values.push_back(value); }, prefix);
+    return frame;
+}
+
+static ParseFrame skipFrame(std::vector<TokenType> stops, bool afterPrevious) {
+    ParseFrame frame(FRAME_SKIP);
+    frame.stops = std::move(stops);
+    frame.afterPrevious = afterPrevious;
+    return frame;
+}
+
+// panic mode: skipping to the next member, element or substitution separator.
+static ParseFrame skipMember() {
+    return skipFrame(std::vector<TokenType>{NEWLINE, COMMA, RIGHT_BRACE}, false);
+}
+
+static ParseFrame skipElement() {
+    return skipFrame(std::vector<TokenType>{NEWLINE, COMMA, RIGHT_BRACKET}, false);
+}
+
+static ParseFrame skipSubstitution() {
+    return skipFrame(std::vector<TokenType>{NEWLINE, COMMA, RIGHT_BRACKET, RIGHT_BRACE}, true);
 }
 
 /*
-    panic mode method to consume until the next separator for a substitution.
+    panic mode method to consume until the next member to parse.
 */
-void HParser::consumeSubstitution() {
-    while(!check(std::vector<TokenType>{NEWLINE, COMMA, RIGHT_BRACKET, RIGHT_BRACE}) && !atEnd()) {
-        if(previous().type == LEFT_BRACE) {
-            delete hoconTree(std::vector<std::string>());
-        } else if (previous().type == LEFT_BRACKET) {
-            delete hoconArray();
-        }
-        else advance();
-    }
-    match(std::vector<TokenType>{NEWLINE, COMMA});
-    ignoreAllWhitespace();
+void HParser::consumeMember() {
+    runFrames(skipMember());
 }
 
 /* 
     Helper method to consume all tokens until the next member. 
 */
 void HParser::consumeToNextMember() {
-    ignoreAllWhitespace();
-    if(match(COMMA)) {
-        ignoreAllWhitespace();
-    } 
-    if (!check(SIMPLE_VALUES) && !check(RIGHT_BRACE)) {
-        error(peek().line, "Unexpected symbol " + peek().lexeme + " after member");
+    if (separateMember()) {
         consumeMember();
     }
 }
@@ -862,29 +1169,71 @@ void HParser::consumeToNextRootMember() {
     }
 }
 
+/*
+    Consumes the separator after a member.
+    @returns true if there is none, which is reported: the caller then skips to the next member.
+*/
+bool HParser::separateMember() {
+    ignoreAllWhitespace();
+    if(match(COMMA)) {
+        ignoreAllWhitespace();
+    } 
+    if (!check(SIMPLE_VALUES) && !check(RIGHT_BRACE)) {
+        error(peek().line, "Unexpected symbol " + peek().lexeme + " after member");
+        return true;
+    }
+    return false;
+}
+
 /* 
-    // note: consumeToNextElement requires a different logic:
+    Consumes the separator after an array element, which requires a different logic:
     if there are two elements written in a HOCON array, 
     [
         obj {}
     ]
-    The above is invalid. This requires a specific check for a separator that consumetoNextMember can avoid because 
+    The above is invalid. This requires a specific check for a separator that separateMember can avoid because 
     the parser only expects a simple value after the member, which must be separated by a newline/comma or it will be concatenated 
     into the stored value.
+    @returns true if there is no separator, which is reported: the caller then skips to the next element.
 */
-void HParser::consumeToNextElement() { 
+bool HParser::separateElement() { 
     ignoreInlineWhitespace();
     bool sepExists = check(std::vector<TokenType>{COMMA, NEWLINE});
     if (check(RIGHT_BRACKET)) { 
-        return;
+        return false;
     } else if(sepExists) {
         ignoreAllWhitespace();
         match(COMMA);
         ignoreAllWhitespace();
-    } else {
-        error(peek().line, "Expected comma or newline, got " + peek().lexeme + " after array element");
-        consumeElement();
+        return false;
+    }
+    error(peek().line, "Expected comma or newline, got " + peek().lexeme + " after array element");
+    return true;
+}
+
+/*
+    Called on entering an object or array.
+    @returns true if the object or array is nested too deeply and must not be parsed, see stopNesting.
+*/
+bool HParser::nestedTooDeep() {
+    if (depth <= maxDepth && !depthExceeded) {
+        return false;
+    }
+    stopNesting("objects and arrays are nested deeper than " + std::to_string(maxDepth) + " levels", DIAG_PARSE);
+    return true;
+}
+
+/*
+    Gives up on a document that nests too deeply. The error is reported once and the parser jumps to the end of the
+    input, so every enclosing level returns straight away; error() stays quiet from then on, since each level would
+    otherwise report its missing closing brace.
+*/
+void HParser::stopNesting(std::string const& message, DiagnosticCode code) {
+    if (!depthExceeded) {
+        error(peek().line, message, code);
+        depthExceeded = true;
     }
+    current = length - 1;
 }
 
 // create parsed objects :: assignment
@@ -988,7 +1337,7 @@ HTree * HParser::rootTree() {
                     pushStack(rootPath, val);
                 }
             }
-            if (path.size() > 1) {
+            if (path.size() > 1 && recordStack) {
                 HTree* temp = target;
                 size_t offset = 1;
                 while (temp != output) {
@@ -1013,123 +1362,218 @@ HTree * HParser::rootTree() {
     Attempts to create a hocon object with the following tokens, consuming all tokens including the ending '}'.
     Assumes you are within the object, after the first {
 */
-HTree * HParser::hoconTree(std::vector<std::string> parentPath) { 
-    HTree * output = new HTree();
-    HTree * target = output;
-    using std::get;
-    while(!match(RIGHT_BRACE)) { // loop through members
-        if(atEnd()) {
-            error(peek().line, "Imbalanced {}");
-            break;
-        }
-        std::vector<std::string> rootPath = parentPath;
-        if (isInclude(peek())) {
-            HTree * includedTree = parseInclude(rootPath);
-            consumeToNextMember();
-            match(RIGHT_BRACE);
-            delete output;
-            return includedTree;
-        }
-        std::vector<std::string> path = hoconKey();
-        if(path.empty()) {
-            consumeMember();
-            continue;
-        } 
-        std::string keyValue = path[path.size()-1];
-        rootPath.insert(std::end(rootPath), std::begin(path), std::end(path));
-        if (path.size() > 1) {
-            target = findOrCreatePath(path, output);
-        } else {
-            target = output;
+HTree * HParser::hoconTree(std::vector<std::string> const& parentPath) {
+    return std::get<HTree*>(runFrames(copyingTree(parentPath)));
+}
+
+/*
+    hoconTree for the parser itself, which extends rootPath by the key of each member instead of copying it: copies
+    would make nested objects quadratic in their depth.
+*/
+HTree * HParser::hoconTree(std::vector<std::string>& rootPath) { 
+    return std::get<HTree*>(runFrames(extendingTree(rootPath)));
+}
+
+/* 
+    assume you have just consumed the left bracket. consumes the right bracket token.
+*/
+HArray * HParser::hoconArray() {
+    return std::get<HArray*>(runFrames(ParseFrame(FRAME_ARRAY)));
+}
+
+/*
+    Attempts to create a hocon object with the following tokens, consuming all tokens including the ending '}'.
+    Assumes you are within the object, after the first {
+*/
+HTree * HParser::hoconArraySubTree() { 
+    return std::get<HTree*>(runFrames(ParseFrame(FRAME_ARRAY_SUBTREE)));
+}
+
+/*
+    parses the next chain of adjacent arrays and their corresponding tokens, and returning the merged result. Adds the resulting elements to the stack history.
+*/
+HArray * HParser::concatAdjacentArrays() {
+    return std::get<HArray*>(runFrames(ParseFrame(FRAME_CONCAT_ARRAYS)));
+}
+
+/*
+    parses the next chain of adjacent objects and their corresponding tokens, and returning the merged result. Adds the resulting elements to the stack history.
+*/
+HTree * HParser::mergeAdjacentTrees(std::vector<std::string>& path) {
+    return std::get<HTree*>(runFrames(mergingTrees(path)));
+}
+
+HSubstitution * HParser::parseSubstitution(std::variant<HTree*, HArray*, HSimpleValue*> prefix, std::vector<std::string> const& parentPath, bool addingToStack) {
+    return std::get<HSubstitution*>(runFrames(substitutionFrame(prefix, parentPath, addingToStack)));
+}
+
+HSubstitution * HParser::parseSubstitution(std::vector<std::string> const& parentPath, bool addingToStack) {
+    return std::get<HSubstitution*>(runFrames(substitutionFrame(parentPath, addingToStack)));
+}
+
+/*
+    Runs first, and every frame it starts, until first returns.
+    @returns the value first returned.
+*/
+std::variant<HTree*, HArray*, HSubstitution*> HParser::runFrames(ParseFrame first) {
+    ParseStack parse(depth);
+    parse.frames.push_back(std::move(first));
+    while (!parse.frames.empty()) {
+        switch (parse.top().kind) {
+            case FRAME_TREE:
+                stepTree(parse);
+                break;
+            case FRAME_ARRAY_SUBTREE:
+                stepArraySubTree(parse);
+                break;
+            case FRAME_ARRAY:
+                stepArray(parse);
+                break;
+            case FRAME_MERGE_TREES:
+            case FRAME_MERGE_SUBTREES:
+                stepMergeTrees(parse);
+                break;
+            case FRAME_CONCAT_ARRAYS:
+                stepConcatArrays(parse);
+                break;
+            case FRAME_SUBSTITUTION:
+                stepSubstitution(parse);
+                break;
+            case FRAME_SKIP:
+                stepSkip(parse);
+                break;
         }
-        ignoreAllWhitespace();
-        if (match(LEFT_BRACE)) {            // implied separator case. ex: foo {}
-            HTree * obj = mergeAdjacentTrees(rootPath);
-            if(check(SUB) || check(SUB_OPTIONAL)) {
-                HSubstitution* sub;
-                sub = (obj != nullptr) ? parseSubstitution(obj, rootPath, true) : parseSubstitution(rootPath, true);
-                if (target->addMember(keyValue, sub)) {
-                    pushStack(rootPath, target->members[keyValue]);
-                } else {
-                    pushStack(rootPath, sub);
+    }
+    return parse.returned;
+}
+
+/*
+    hoconTree: the members of an object up to its '}', each of them pushed on the stack history under rootPath. Every
+    step function runs its frame until the frame starts another or returns.
+*/
+void HParser::stepTree(ParseStack& parse) {
+    ParseFrame& frame = parse.top();
+    std::vector<std::string>& rootPath = frame.path();
+    while (true) {
+        switch (frame.step) {
+            case STEP_START:
+                depth++;
+                frame.nesting = true;
+                frame.output = new HTree();
+                if (nestedTooDeep()) {
+                    parse.ret(frame.output);
+                    return;
                 }
-            } else if (obj) {
-                //target->addMember(keyValue, obj);
-                if(target->addMember(keyValue, obj)) { // the method returns true if the passed pointer was deleted.
-                    pushStack(rootPath, target->members[keyValue]);
-                } else {
-                    pushStack(rootPath, obj);
+                frame.target = frame.output;
+                frame.parentSize = rootPath.size();
+                frame.step = STEP_NEXT;
+                break;
+            case STEP_NEXT: { // loop through members
+                if (match(RIGHT_BRACE)) {
+                    frame.step = STEP_END;
+                    break;
                 }
-            }
-            consumeToNextMember();
-        } else if(match(KEY_VALUE_SEP)) {   // explicit separator ex: foo = {}
-            ignoreAllWhitespace();
-            if (match(LEFT_BRACE)) {
-                HTree * obj = mergeAdjacentTrees(rootPath);
-                if(check(SUB) || check(SUB_OPTIONAL)) {
-                    HSubstitution* sub;
-                    sub = (obj != nullptr) ? parseSubstitution(obj, rootPath, true) : parseSubstitution(rootPath, true);
-                    if (target->addMember(keyValue, sub)) {
-                        pushStack(rootPath, target->members[keyValue]);
-                    } else {
-                        pushStack(rootPath, sub);
-                    }
-                } else if (obj) {
-                    //target->addMember(keyValue, obj);
-                    if(target->addMember(keyValue, obj)) { // the method returns true if the passed pointer was deleted.
-                        pushStack(rootPath, target->members[keyValue]);
-                    } else {
-                        pushStack(rootPath, obj);
+                if (atEnd()) {
+                    error(peek().line, "Imbalanced {}");
+                    frame.step = STEP_END;
+                    break;
+                }
+                rootPath.resize(frame.parentSize); // drops the key of the previous member.
+                if (isInclude(peek())) {
+                    frame.included = parseInclude(rootPath);
+                    frame.step = STEP_INCLUDED;
+                    if (separateMember()) {
+                        parse.call(STEP_INCLUDED, skipMember());
+                        return;
                     }
+                    break;
                 }
-            } else if (match(LEFT_BRACKET)) {
-                HArray * arr = concatAdjacentArrays();
-                if(check(SUB) || check(SUB_OPTIONAL)) {
-                    HSubstitution* sub = parseSubstitution(arr, rootPath, true);
-                    if (target->addMember(keyValue, sub)) {
-                        pushStack(rootPath, target->members[keyValue]);
-                    } else {
-                        pushStack(rootPath, sub);
+                frame.key = hoconKey();
+                if (frame.key.empty()) {
+                    parse.call(STEP_NEXT, skipMember());
+                    return;
+                }
+                rootPath.insert(std::end(rootPath), std::begin(frame.key), std::end(frame.key));
+                frame.target = frame.key.size() > 1 ? findOrCreatePath(frame.key, frame.output) : frame.output;
+                frame.separated = false;
+                ignoreAllWhitespace();
+                if (match(LEFT_BRACE)) {            // implied separator case. ex: foo {}
+                    parse.call(STEP_OBJECT, mergingTrees(rootPath));
+                    return;
+                }
+                if (match(PLUS_EQUAL)) {
+                    ignoreAllWhitespace();
+                    if (match(LEFT_BRACKET)) {
+                        parse.call(STEP_APPEND, ParseFrame(FRAME_CONCAT_ARRAYS));
+                        return;
                     }
-                } else {
-                    target->addMember(keyValue, arr);
-                    pushStack(rootPath, arr);
+                    error(peek().line, "Expected an array, got " + peek().lexeme);
+                    frame.step = STEP_SEPARATOR;
+                    break;
                 }
-            } else if (check(SUB) || check(SUB_OPTIONAL)) {
-                HSubstitution* sub = parseSubstitution(rootPath, true);
-                if (target->addMember(keyValue, sub)) {
-                    pushStack(rootPath, target->members[keyValue]);
-                } else {
-                    pushStack(rootPath, sub);
+                if (!match(KEY_VALUE_SEP)) {
+                    error(peek().line, "Expected '=' or ':', got " + peek().lexeme + ", after the key '" + frame.key.back() + "'");
+                    parse.call(STEP_NEXT, skipMember());
+                    return;
                 }
-            } else {   
-                HSimpleValue * val = hoconSimpleValue();
-                if(check(SUB) || check(SUB_OPTIONAL)) {
-                    HSubstitution* sub = parseSubstitution(val, rootPath, true);
-                    if (target->addMember(keyValue, sub)) {
-                        pushStack(rootPath, target->members[keyValue]);
+                frame.separated = true;             // explicit separator ex: foo = {}
+                ignoreAllWhitespace();
+                if (match(LEFT_BRACE)) {
+                    parse.call(STEP_OBJECT, mergingTrees(rootPath));
+                } else if (match(LEFT_BRACKET)) {
+                    parse.call(STEP_ARRAY, ParseFrame(FRAME_CONCAT_ARRAYS));
+                } else if (check(SUB) || check(SUB_OPTIONAL)) {
+                    parse.call(STEP_SUBSTITUTION, substitutionFrame(rootPath, true));
+                } else {
+                    HSimpleValue * val = hoconSimpleValue();
+                    if (check(SUB) || check(SUB_OPTIONAL)) {
+                        parse.call(STEP_SUBSTITUTION, substitutionFrame(val, rootPath, true));
                     } else {
-                        pushStack(rootPath, sub);
+                        frame.target->addMember(frame.key.back(), val);
+                        pushStack(rootPath, val);
+                        frame.step = STEP_SEPARATOR;
+                        break;
                     }
-                } else {
-                    target->addMember(keyValue, val);
-                    pushStack(rootPath, val);
                 }
+                return;
             }
-            if (path.size() > 1) {
-                HTree* temp = target;
-                size_t offset = 1;
-                while (temp != output) {
-                    pushStack(std::vector<std::string>(rootPath.begin(), rootPath.end() - offset), temp);
-                    offset++;
-                    temp = std::get<HTree*>(temp->parent);
+            case STEP_OBJECT: {
+                HTree * obj = std::get<HTree*>(parse.returned);
+                if (check(SUB) || check(SUB_OPTIONAL)) {
+                    parse.call(STEP_SUBSTITUTION, obj ? substitutionFrame(obj, rootPath, true) : substitutionFrame(rootPath, true));
+                    return;
+                }
+                if (obj && frame.target->addMember(frame.key.back(), obj)) { // the method returns true if the passed pointer was deleted.
+                    pushStack(rootPath, frame.target->members[frame.key.back()]);
+                } else if (obj) {
+                    pushStack(rootPath, obj);
                 }
+                frame.step = STEP_SEPARATOR;
+                break;
             }
-            consumeToNextMember();
-        } else if (match(PLUS_EQUAL)) {
-            ignoreAllWhitespace();
-            if (match(LEFT_BRACKET)) {
-                HArray * append = concatAdjacentArrays();
+            case STEP_ARRAY: {
+                HArray * arr = std::get<HArray*>(parse.returned);
+                if (check(SUB) || check(SUB_OPTIONAL)) {
+                    parse.call(STEP_SUBSTITUTION, substitutionFrame(arr, rootPath, true));
+                    return;
+                }
+                frame.target->addMember(frame.key.back(), arr);
+                pushStack(rootPath, arr);
+                frame.step = STEP_SEPARATOR;
+                break;
+            }
+            case STEP_SUBSTITUTION: {
+                HSubstitution * sub = std::get<HSubstitution*>(parse.returned);
+                if (frame.target->addMember(frame.key.back(), sub)) {
+                    pushStack(rootPath, frame.target->members[frame.key.back()]);
+                } else {
+                    pushStack(rootPath, sub);
+                }
+                frame.step = STEP_SEPARATOR;
+                break;
+            }
+            case STEP_APPEND: {
+                HArray * append = std::get<HArray*>(parse.returned);
                 std::vector<std::variant<HTree*,HArray*,HSimpleValue*,HPath*>> list;
                 HPath * appendPath = new HPath(rootPath, true);
                 list.push_back(appendPath);
@@ -1137,201 +1581,397 @@ HTree * HParser::hoconTree(std::vector<std::string> parentPath) {
                 HSubstitution * sub = new HSubstitution(list);
                 appendPath->parent = sub;
                 sub->interrupts = std::vector<bool>{false, false};
-                if (target->addMember(keyValue, sub)) {
-                    pushStack(rootPath, target->members[keyValue]);
+                if (frame.target->addMember(frame.key.back(), sub)) {
+                    pushStack(rootPath, frame.target->members[frame.key.back()]);
                 } else {
                     pushStack(rootPath, sub);
                 }
-            } else {
-                error(peek().line, "Expected an array, got " + peek().lexeme);
+                frame.step = STEP_SEPARATOR;
+                break;
             }
-            consumeToNextMember();
-        } else {
-            error(peek().line, "Expected '=' or ':', got " + peek().lexeme + ", after the key '" + keyValue + "'");
-            consumeMember();
+            case STEP_SEPARATOR:
+                if (frame.separated && frame.key.size() > 1 && recordStack) {
+                    HTree* temp = frame.target;
+                    size_t offset = 1;
+                    while (temp != frame.output) {
+                        pushStack(std::vector<std::string>(rootPath.begin(), rootPath.end() - offset), temp);
+                        offset++;
+                        temp = std::get<HTree*>(temp->parent);
+                    }
+                }
+                frame.step = STEP_NEXT;
+                if (separateMember()) {
+                    parse.call(STEP_NEXT, skipMember());
+                    return;
+                }
+                break;
+            case STEP_INCLUDED:
+                match(RIGHT_BRACE);
+                delete frame.output;
+                parse.ret(frame.included);
+                return;
+            default: // STEP_END
+                rootPath.resize(frame.parentSize);
+                parse.ret(frame.output);
+                return;
         }
     }
-    return output;
 }
 
-/* 
-    assume you have just consumed the left bracket. consumes the right bracket token.
+/*
+    hoconArraySubTree: the members of an object within an array up to its '}'. They have no accessible path, so
+    nothing is pushed on the stack history.
 */
-HArray * HParser::hoconArray() {
-    HArray * output = new HArray();
-    while(!match(RIGHT_BRACKET)) { // loop through members, assumption is that the current token is the first token for a given value.
-        if(atEnd()) {
-            error(peek().line, "Imbalanced []");
-            break;
-        }
-        if (match(LEFT_BRACE)) {  // object case
-            HTree * obj = mergeAdjacentArraySubTrees(); // pass in empty path here because we are not pushing objects within arrays into the stack since they do not have an accessible path.
-            if(check(SUB) || check(SUB_OPTIONAL)) {
-                HSubstitution* sub;
-                sub = (obj != nullptr) ? parseSubstitution(obj, std::vector<std::string>(), false) : parseSubstitution(std::vector<std::string>(), false);
-                output->addElement(sub);
-                for (auto val : sub->values) {
-                    if (std::holds_alternative<HPath*>(val)) {
-                        std::get<HPath*>(val)->counter = stack.size();
+void HParser::stepArraySubTree(ParseStack& parse) {
+    ParseFrame& frame = parse.top();
+    while (true) {
+        switch (frame.step) {
+            case STEP_START:
+                depth++;
+                frame.nesting = true;
+                frame.output = new HTree();
+                if (nestedTooDeep()) {
+                    parse.ret(frame.output);
+                    return;
+                }
+                frame.target = frame.output;
+                frame.step = STEP_NEXT;
+                break;
+            case STEP_NEXT: { // loop through members
+                if (match(RIGHT_BRACE)) {
+                    frame.step = STEP_END;
+                    break;
+                }
+                if (atEnd()) {
+                    error(peek().line, "Imbalanced {}");
+                    frame.step = STEP_END;
+                    break;
+                }
+                if (isInclude(peek())) {
+                    frame.included = parseInclude(std::vector<std::string>{"\"\""});
+                    frame.step = STEP_INCLUDED;
+                    if (separateMember()) {
+                        parse.call(STEP_INCLUDED, skipMember());
+                        return;
+                    }
+                    break;
+                }
+                frame.key = hoconKey();
+                if (frame.key.empty()) {
+                    parse.call(STEP_NEXT, skipMember());
+                    return;
+                }
+                frame.target = frame.key.size() > 1 ? findOrCreatePath(frame.key, frame.output) : frame.output;
+                frame.separated = false;
+                if (match(LEFT_BRACE)) {            // implied separator case. ex: foo {}
+                    parse.call(STEP_OBJECT, ParseFrame(FRAME_MERGE_SUBTREES));
+                    return;
+                }
+                if (!match(KEY_VALUE_SEP)) {
+                    error(peek().line, "Expected '=' or ':', got " + peek().lexeme + ", after the key '" + frame.key.back() + "'");
+                    parse.call(STEP_NEXT, skipMember());
+                    return;
+                }
+                frame.separated = true;             // explicit separator ex: foo = {}
+                ignoreAllWhitespace();
+                if (match(LEFT_BRACE)) {
+                    parse.call(STEP_OBJECT, ParseFrame(FRAME_MERGE_SUBTREES));
+                } else if (match(LEFT_BRACKET)) {
+                    parse.call(STEP_ARRAY, ParseFrame(FRAME_CONCAT_ARRAYS));
+                } else if (check(SUB) || check(SUB_OPTIONAL)) {
+                    parse.call(STEP_SUBSTITUTION, substitutionFrame(std::vector<std::string>(), false));
+                } else {
+                    HSimpleValue * val = hoconSimpleValue();
+                    if (check(SUB) || check(SUB_OPTIONAL)) {
+                        parse.call(STEP_SUBSTITUTION, substitutionFrame(val, std::vector<std::string>(), false));
+                    } else {
+                        frame.target->addMember(frame.key.back(), val);
+                        frame.step = STEP_SEPARATOR;
+                        break;
                     }
                 }
-                //unresolvedSubs.push_back(sub->deepCopy());
-            } else if(obj) {
-                output->addElement(obj);
+                return;
             }
-            consumeToNextElement(); 
-        } else if (match(LEFT_BRACKET)) { // array case
-            HArray * arr = concatAdjacentArrays();
-            if(check(SUB) || check(SUB_OPTIONAL)) {
-                HSubstitution* sub = parseSubstitution(arr, std::vector<std::string>(), false);
-                output->addElement(sub);
-                for (auto val : sub->values) {
-                    if (std::holds_alternative<HPath*>(val)) {
-                        std::get<HPath*>(val)->counter = stack.size();
+            case STEP_OBJECT: {
+                HTree * obj = std::get<HTree*>(parse.returned);
+                if (check(SUB) || check(SUB_OPTIONAL)) {
+                    parse.call(STEP_SUBSTITUTION, obj ? substitutionFrame(obj, std::vector<std::string>(), true) : substitutionFrame(std::vector<std::string>(), true));
+                    return;
+                }
+                if (obj) {
+                    frame.target->addMember(frame.key.back(), obj);
+                }
+                frame.step = STEP_SEPARATOR;
+                break;
+            }
+            case STEP_ARRAY: {
+                HArray * arr = std::get<HArray*>(parse.returned);
+                if (check(SUB) || check(SUB_OPTIONAL)) {
+                    parse.call(STEP_SUBSTITUTION, substitutionFrame(arr, std::vector<std::string>(), false));
+                    return;
+                }
+                frame.target->addMember(frame.key.back(), arr);
+                frame.step = STEP_SEPARATOR;
+                break;
+            }
+            case STEP_SUBSTITUTION: {
+                HSubstitution * sub = std::get<HSubstitution*>(parse.returned);
+                if (frame.separated) {
+                    for (auto e : sub->values) {
+                        if (std::holds_alternative<HPath*>(e)) {
+                            HPath* hpath = std::get<HPath*>(e);
+                            hpath->counter = hpath->counter == -1 ? stack.size() : hpath->counter;
+                        }
                     }
                 }
-                //unresolvedSubs.push_back(sub->deepCopy());
-            } else {
-                output->addElement(arr);
+                frame.target->addMember(frame.key.back(), sub);
+                frame.step = STEP_SEPARATOR;
+                break;
             }
-            consumeToNextElement();
-        } else if (check(SIMPLE_VALUES)) { // simple value case
-            HSimpleValue * val = hoconSimpleValue();
-            if(check(SUB) || check(SUB_OPTIONAL)) {
-                HSubstitution* sub = parseSubstitution(val, std::vector<std::string>(), false);
-                output->addElement(sub);
+            case STEP_SEPARATOR:
+                frame.step = STEP_NEXT;
+                if (separateMember()) {
+                    parse.call(STEP_NEXT, skipMember());
+                    return;
+                }
+                break;
+            case STEP_INCLUDED:
+                match(RIGHT_BRACE);
+                delete frame.output;
+                parse.ret(frame.included);
+                return;
+            default: // STEP_END
+                parse.ret(frame.output);
+                return;
+        }
+    }
+}
+
+/*
+    hoconArray: the elements of an array up to its ']'.
+*/
+void HParser::stepArray(ParseStack& parse) {
+    ParseFrame& frame = parse.top();
+    while (true) {
+        switch (frame.step) {
+            case STEP_START:
+                depth++;
+                frame.nesting = true;
+                frame.array = new HArray();
+                if (nestedTooDeep()) {
+                    parse.ret(frame.array);
+                    return;
+                }
+                frame.step = STEP_NEXT;
+                break;
+            case STEP_NEXT: { // loop through elements, the current token is the first token of an element.
+                if (match(RIGHT_BRACKET)) {
+                    frame.step = STEP_END;
+                    break;
+                }
+                if (atEnd()) {
+                    error(peek().line, "Imbalanced []");
+                    frame.step = STEP_END;
+                    break;
+                }
+                if (match(LEFT_BRACE)) {            // object case
+                    parse.call(STEP_OBJECT, ParseFrame(FRAME_MERGE_SUBTREES));
+                } else if (match(LEFT_BRACKET)) {   // array case
+                    parse.call(STEP_ARRAY, ParseFrame(FRAME_CONCAT_ARRAYS));
+                } else if (check(SIMPLE_VALUES)) {  // simple value case
+                    HSimpleValue * val = hoconSimpleValue();
+                    if (check(SUB) || check(SUB_OPTIONAL)) {
+                        parse.call(STEP_SUBSTITUTION, substitutionFrame(val, std::vector<std::string>(), false));
+                    } else {
+                        frame.array->addElement(val);
+                        frame.step = STEP_SEPARATOR;
+                        break;
+                    }
+                } else if (check(SUB) || check(SUB_OPTIONAL)) {
+                    parse.call(STEP_SUBSTITUTION, substitutionFrame(std::vector<std::string>(), false));
+                } else {
+                    error(peek().line, "Expected a {, [ or a simple value, got '" + peek().lexeme + "', instead");
+                    parse.call(STEP_NEXT, skipMember());
+                }
+                return;
+            }
+            case STEP_OBJECT: {
+                HTree * obj = std::get<HTree*>(parse.returned);
+                if (check(SUB) || check(SUB_OPTIONAL)) {
+                    parse.call(STEP_SUBSTITUTION, obj ? substitutionFrame(obj, std::vector<std::string>(), false) : substitutionFrame(std::vector<std::string>(), false));
+                    return;
+                }
+                if (obj) {
+                    frame.array->addElement(obj);
+                }
+                frame.step = STEP_SEPARATOR;
+                break;
+            }
+            case STEP_ARRAY: {
+                HArray * arr = std::get<HArray*>(parse.returned);
+                if (check(SUB) || check(SUB_OPTIONAL)) {
+                    parse.call(STEP_SUBSTITUTION, substitutionFrame(arr, std::vector<std::string>(), false));
+                    return;
+                }
+                frame.array->addElement(arr);
+                frame.step = STEP_SEPARATOR;
+                break;
+            }
+            case STEP_SUBSTITUTION: {
+                HSubstitution * sub = std::get<HSubstitution*>(parse.returned);
+                frame.array->addElement(sub);
                 for (auto val : sub->values) {
                     if (std::holds_alternative<HPath*>(val)) {
                         std::get<HPath*>(val)->counter = stack.size();
                     }
                 }
-                //unresolvedSubs.push_back(sub->deepCopy());
-            } else {
-                output->addElement(val);
+                frame.step = STEP_SEPARATOR;
+                break;
             }
-            consumeToNextElement();
-        } else if (check(SUB) || check(SUB_OPTIONAL)) {
-            HSubstitution* sub = parseSubstitution(std::vector<std::string>(), false);
-            output->addElement(sub);
-            for (auto val : sub->values) {
-                if (std::holds_alternative<HPath*>(val)) {
-                    std::get<HPath*>(val)->counter = stack.size();
+            case STEP_SEPARATOR:
+                frame.step = STEP_NEXT;
+                if (separateElement()) {
+                    parse.call(STEP_NEXT, skipElement());
+                    return;
                 }
-            }
-            //unresolvedSubs.push_back(sub->deepCopy());
-            consumeToNextElement();
-        } else {
-            error(peek().line, "Expected a {, [ or a simple value, got '" + peek().lexeme + "', instead");
-            consumeMember();
+                break;
+            default: // STEP_END
+                parse.ret(frame.array);
+                return;
         }
     }
-    return output;
 }
 
 /*
-    Attempts to create a hocon object with the following tokens, consuming all tokens including the ending '}'.
-    Assumes you are within the object, after the first {
+    mergeAdjacentTrees: parses the next chain of adjacent objects, merging each into the first.
 */
-HTree * HParser::hoconArraySubTree() { 
-    HTree * output = new HTree();
-    HTree * target = output;
-    while(!match(RIGHT_BRACE)) { // loop through members
-        if(atEnd()) {
-            error(peek().line, "Imbalanced {}");
-            break;
+void HParser::stepMergeTrees(ParseStack& parse) {
+    ParseFrame& frame = parse.top();
+    if (frame.step != STEP_START) {
+        HTree * next = std::get<HTree*>(parse.returned);
+        if (next && frame.output) {
+            frame.output->mergeTrees(next);
+            delete next;
+        } else if (next) {
+            frame.output = next;
         }
-        if (isInclude(peek())) {
-            HTree * includedTree = parseInclude(std::vector<std::string>{"\"\""});
-            consumeToNextMember();
-            match(RIGHT_BRACE);
-            delete output;
-            return includedTree;
+        if (!match(LEFT_BRACE)) { // obj concatenation here
+            parse.ret(frame.output);
+            return;
         }
-        std::vector<std::string> path = hoconKey(); 
-        std::string keyValue = path[path.size()-1];
-        if (path.size() > 1) {
-            target = findOrCreatePath(path, output);
+    }
+    if (frame.kind == FRAME_MERGE_TREES) {
+        parse.call(STEP_OBJECT, extendingTree(*frame.rootPath));
+    } else {
+        parse.call(STEP_OBJECT, ParseFrame(FRAME_ARRAY_SUBTREE));
+    }
+}
+
+/*
+    concatAdjacentArrays: parses the next chain of adjacent arrays, concatenating them.
+*/
+void HParser::stepConcatArrays(ParseStack& parse) {
+    ParseFrame& frame = parse.top();
+    if (frame.step != STEP_START) {
+        HArray * next = std::get<HArray*>(parse.returned);
+        if (frame.array) {
+            frame.array->concatArrays(next);
         } else {
-            target = output;
+            frame.array = next;
         }
-        if (match(LEFT_BRACE)) {            // implied separator case. ex: foo {}
-            HTree * obj = mergeAdjacentArraySubTrees();
-            if(check(SUB) || check(SUB_OPTIONAL)) {
-                HSubstitution* sub;
-                sub = (obj != nullptr) ? parseSubstitution(obj, std::vector<std::string>(), true) : parseSubstitution(std::vector<std::string>(), true);
-                target->addMember(keyValue, sub);
-            } else if (obj) {
-                target->addMember(keyValue, obj); // the method returns true if the passed pointer was deleted.
+        if (!match(LEFT_BRACKET)) { // array concatenation here
+            parse.ret(frame.array);
+            return;
+        }
+    }
+    parse.call(STEP_ARRAY, ParseFrame(FRAME_ARRAY));
+}
+
+/*
+    parseSubstitution: the values of a substitution up to the end of its line, which must all be objects, all be
+    arrays or all be simple values. A prefixed substitution (${a} after a value) also ends at a ',' only, otherwise at
+    the end of the enclosing object or array.
+*/
+void HParser::stepSubstitution(ParseStack& parse) {
+    ParseFrame& frame = parse.top();
+    if (frame.step == STEP_ABORTED) {
+        parse.ret(new HSubstitution(frame.values));
+        return;
+    } else if (frame.step == STEP_OBJECT && std::get<HTree*>(parse.returned)) {
+        frame.values.push_back(std::get<HTree*>(parse.returned));
+    } else if (frame.step == STEP_ARRAY) {
+        frame.values.push_back(std::get<HArray*>(parse.returned));
+    }
+    auto sameType = [this, &frame](size_t type) {
+        if (frame.subType == 3) {
+            frame.subType = type;
+        } else if (frame.subType != type) {
+            error(peek().line, "substitution mismatched types, expected type " + std::to_string(frame.subType) + " got " + std::to_string(type));
+            return false;
+        }
+        return true;
+    };
+    std::vector<TokenType> ends = frame.prefixed ? std::vector<TokenType>{COMMA} : std::vector<TokenType>{COMMA, RIGHT_BRACE, RIGHT_BRACKET};
+    while(!match(NEWLINE) && !check(ends) && !atEnd()) {
+        if (match(LEFT_BRACE)) {
+            if (!sameType(0)) {
+                parse.call(STEP_ABORTED, skipSubstitution());
+            } else if (frame.addingToStack) {
+                parse.call(STEP_OBJECT, extendingTree(frame.ownPath));
+            } else {
+                parse.call(STEP_OBJECT, ParseFrame(FRAME_ARRAY_SUBTREE));
             }
-            consumeToNextMember();
-        } else if(match(KEY_VALUE_SEP)) {   // explicit separator ex: foo = {}
-            ignoreAllWhitespace();
-            if (match(LEFT_BRACE)) {
-                HTree * obj = mergeAdjacentArraySubTrees();
-                if(check(SUB) || check(SUB_OPTIONAL)) {
-                    HSubstitution* sub;
-                    sub = (obj != nullptr) ? parseSubstitution(obj, std::vector<std::string>(), true) : parseSubstitution(std::vector<std::string>(), true);
-                    for(auto e : sub->values) { 
-                        if (std::holds_alternative<HPath*>(e)) {
-                            HPath* hpath = std::get<HPath*>(e);
-                            hpath->counter = hpath->counter == -1 ? stack.size() : hpath->counter; 
-                        }
-                    }
-                    target->addMember(keyValue, sub);
-                } else if (obj) {
-                    target->addMember(keyValue, obj); // the method returns true if the passed pointer was deleted.
-                }
-            } else if (match(LEFT_BRACKET)) {
-                HArray * arr = concatAdjacentArrays();
-                if(check(SUB) || check(SUB_OPTIONAL)) {
-                    HSubstitution* sub = parseSubstitution(arr, std::vector<std::string>(), false);
-                    for(auto e : sub->values) { 
-                        if (std::holds_alternative<HPath*>(e)) {
-                            HPath* hpath = std::get<HPath*>(e);
-                            hpath->counter = hpath->counter == -1 ? stack.size() : hpath->counter; 
-                        }
-                    }
-                    if (!target->addMember(keyValue, sub)) { // return false indicates there was no merge (obj or substitution)
-                        //unresolvedSubs.push_back(sub->deepCopy());
-                    }
-                } else {
-                    target->addMember(keyValue, arr);
-                }
-            } else if (check(SUB) || check(SUB_OPTIONAL)) {
-                HSubstitution* sub = parseSubstitution(std::vector<std::string>(), false);
-                for(auto e : sub->values) { 
-                    if (std::holds_alternative<HPath*>(e)) {
-                        HPath* hpath = std::get<HPath*>(e);
-                        hpath->counter = hpath->counter == -1 ? stack.size() : hpath->counter; 
-                    }
-                }
-                if (!target->addMember(keyValue, sub)) { // return false indicates there was no merge (obj or substitution)
-                    //unresolvedSubs.push_back(sub->deepCopy());
-                }
-            } else {   
-                HSimpleValue * val = hoconSimpleValue();
-                if(check(SUB) || check(SUB_OPTIONAL)) {
-                    HSubstitution* sub = parseSubstitution(val, std::vector<std::string>(), false);
-                    for(auto e : sub->values) { 
-                        if (std::holds_alternative<HPath*>(e)) {
-                            HPath* hpath = std::get<HPath*>(e);
-                            hpath->counter = hpath->counter == -1 ? stack.size() : hpath->counter; 
-                        }
-                    }
-                    if (!target->addMember(keyValue, sub)) { // return false indicates there was no merge (obj or substitution)
-                        //unresolvedSubs.push_back(sub->deepCopy());
-                    }
-                } else {
-                    target->addMember(keyValue, val);
-                }
+            return;
+        } else if (match(LEFT_BRACKET)) {
+            if (!sameType(1)) {
+                parse.call(STEP_ABORTED, skipSubstitution());
+            } else {
+                parse.call(STEP_ARRAY, ParseFrame(FRAME_ARRAY));
             }
-            consumeToNextMember();
+            return;
+        } else if (check(SUB) || check(SUB_OPTIONAL)) { 
+            HPath * path = new HPath(advance());
+            if (frame.subType < 2) ignoreInlineWhitespace();
+            else path->suffixWhitespace = check(WHITESPACE) ? advance().lexeme : "";
+            frame.values.push_back(path);
         } else {
-            error(peek().line, "Expected '=' or ':', got " + peek().lexeme + ", after the key '" + keyValue + "'");
-            consumeMember();
+            if (!sameType(2)) {
+                parse.call(STEP_ABORTED, skipSubstitution());
+                return;
+            }
+            frame.values.push_back(hoconSimpleValue());
         }
     }
-    return output;
+    HSubstitution * out = new HSubstitution(frame.values);
+    for (size_t i = 0; i < frame.values.size(); i++) {
+        out->interrupts.push_back(false);
+    }
+    out->substitutionType = frame.subType;
+    parse.ret(out);
+}
+
+/*
+    consumeMember and its element and substitution versions, panic mode methods to consume until the next member,
+    element or substitution separator. Objects and arrays on the way are parsed and thrown away.
+*/
+void HParser::stepSkip(ParseStack& parse) {
+    ParseFrame& frame = parse.top();
+    if (frame.step == STEP_SKIPPED) {
+        std::visit([](auto * value) { delete value; }, parse.returned);
+    }
+    while(!check(frame.stops) && !atEnd()) {
+        if (frame.afterPrevious ? previous().type == LEFT_BRACE : match(LEFT_BRACE)) {
+            parse.call(STEP_SKIPPED, copyingTree(std::vector<std::string>()));
+            return;
+        } else if (frame.afterPrevious ? previous().type == LEFT_BRACKET : match(LEFT_BRACKET)) {
+            parse.call(STEP_SKIPPED, ParseFrame(FRAME_ARRAY));
+            return;
+        }
+        advance();
+    }
+    match(std::vector<TokenType>{NEWLINE, COMMA});
+    ignoreAllWhitespace();
+    parse.ret((HTree*) nullptr);
 }
 
 /* 
@@ -1463,29 +2103,234 @@ std::tuple<std::string, IncludeType, bool> HParser::hoconInclude() {
     return std::make_tuple(link, type, required);
 }
 
+/*
+    Reads, lexes and parses an include on its own into out, reading it through the first resolver that accepts it.
+    Only includeCache, includePool, resolvers, maxDepth and includeNesting are read from this parser, and those do not
+    change while it parses, so prefetched includes run this on the include pool while the parser goes on. depth is the nesting depth
+    at the include. pending, if set, is the read prefetchIncludes started, which is waited for instead of reading the
+    include again.
+*/
+void HParser::readInclude(std::string const& link, IncludeType type, int depth, ParsedInclude& out, std::shared_ptr<FileRead> const& pending) {
+    IncludeResolver * resolver = (resolvers ? *resolvers : ResolverChain::defaults()).find(link, type);
+    out.stamped = resolver && resolver->stamped();
+    out.parser = (out.stamped && includeCache) ? includeCache->find(link) : nullptr;
+    if (out.parser) {
+        return;
+    }
+    std::string content;
+    if (resolver) {
+        PhaseTimer timer(PHASE_INCLUDE_FETCH, link);
+        std::shared_ptr<FileRead> read = pending ? pending : resolver->read(link);
+        read->wait();
+        out.stamp = read->stamp;
+        content = read->content;
+    }
+    if (content == "") {
+        return;
+    }
+    PhaseTimer timer(PHASE_INCLUDE_PARSE, link);
+    std::vector<Token> tokens;
+    {
+        PhaseTimer lexTimer(PHASE_LEX, link);
+        Lexer lexer = Lexer(content);
+        lexer.diagnostics = &out.diagnostics;
+        lexer.sourceName = link;
+        tokens = lexer.run();
+        countStat(COUNT_TOKENS, tokens.size());
+        out.lexError = lexer.hasError; // the lexer reported the error itself.
+    }
+    HParser * includeParser;
+    if (out.lexError) { // the tokens of a file that failed to lex cannot be parsed, it is spliced as an empty object.
+        includeParser = new HParser(std::vector<Token>());
+        includeParser->rootObject = new HTree();
+        includeParser->validConf = false;
+    } else {
+        includeParser = new HParser(tokens);
+        includeParser->includeCache = includeCache;
+        includeParser->includePool = includePool;
+        includeParser->resolvers = resolvers;
+        includeParser->diagnostics = &out.diagnostics;
+        includeParser->sourceName = link;
+        includeParser->maxDepth = maxDepth;
+        includeParser->depth = depth;
+        includeParser->includeNesting = includeNesting + 1;
+        includeParser->parseTokens();
+        includeParser->diagnostics = nullptr;
+        out.depthExceeded = includeParser->depthExceeded;
+    }
+    locateDiagnostics(out.diagnostics, 0, link, content);
+    if (out.stamped) {
+        includeParser->dependencies.insert(includeParser->dependencies.begin(), out.stamp);
+    }
+    if (out.stamped && includeCache && includeParser->validConf) { // the cache keeps the pristine parse, the splice works on a clone.
+        HParser * pristine = includeParser;
+        includeParser = pristine->clone(); // cloned before storing, since other loads may replace the entry right after.
+        includeCache->store(link, pristine);
+    }
+    out.parser = includeParser;
+}
+
+/*
+    Finds the file and url includes of the document with a scan of its tokens and starts them early: the includes each
+    resolver accepts are read in one batch through it, except files already in the include cache, and every include is
+    submitted to includePool, so that they are read and parsed while this parser works through the tokens before them.
+    The pool can be unset. The scan only guesses: an include the parser does not reach in the same form (inside a member
+    skipped after an error, or at another depth than the braces suggest) is read again in place and what was started
+    for it is thrown away, so the splice, and with it the stack offsets of every substitution, is the same as without
+    prefetching.
+*/
+void HParser::prefetchIncludes() {
+    if (includeNesting >= MAX_INCLUDE_NESTING) { // parseInclude fails these.
+        return;
+    }
+    ResolverChain const& chain = resolvers ? *resolvers : ResolverChain::defaults();
+    int level = depth;
+    std::vector<IncludeResolver*> batched; // in the order of their first include.
+    std::unordered_map<IncludeResolver*, std::pair<std::vector<int>, std::vector<std::string>>> batches;
+    for (int i = 0; i < length; i++) {
+        Token const& t = tokenList[i];
+        if (t.type == LEFT_BRACE || t.type == LEFT_BRACKET) {
+            level++;
+        } else if (t.type == RIGHT_BRACE || t.type == RIGHT_BRACKET) {
+            level--;
+        }
+        PrefetchedInclude entry;
+        if (!isInclude(t) || level >= maxDepth || !scanInclude(tokenList, i, entry.link, entry.type)) {
+            continue;
+        }
+        entry.depth = level;
+        entry.result = std::make_shared<ParsedInclude>();
+        IncludeResolver * resolver = chain.find(entry.link, entry.type);
+        if (resolver && !(resolver->stamped() && includeCache && includeCache->contains(entry.link))) {
+            auto& batch = batches[resolver];
+            if (batch.first.empty()) {
+                batched.push_back(resolver);
+            }
+            batch.first.push_back(i);
+            batch.second.push_back(entry.link);
+        }
+        prefetched[i] = entry;
+    }
+    for (IncludeResolver * resolver : batched) {
+        auto const& [sites, links] = batches[resolver];
+        std::vector<std::shared_ptr<FileRead>> reads = resolver->readAll(links);
+        for (size_t r = 0; r < reads.size(); r++) {
+            prefetched[sites[r]].read = reads[r];
+        }
+    }
+    if (!includePool) {
+        return;
+    }
+    bool collect = activeStats != nullptr;
+    std::chrono::steady_clock::time_point started = collect ? activeStats->started : std::chrono::steady_clock::time_point();
+    for (auto& [site, entry] : prefetched) {
+        entry.task = includePool->submit([this, entry, collect, started]() {
+            if (collect) {
+                entry.result->stats.started = started; // so the events line up with those of the including load.
+                entry.result->stats.thread = IncludePool::currentThread() + 1;
+            }
+            StatsScope scope(collect ? &entry.result->stats : nullptr);
+            readInclude(entry.link, entry.type, entry.depth, *entry.result, entry.read);
+        });
+    }
+}
+
+/*
+    Moves the prefetched result of the include at token index site into out, waiting for it if needed. Without an
+    include pool only the file was read ahead, and it is parsed here. What the task threw is rethrown here, as if the
+    include had been read in place.
+    @returns false if nothing was prefetched for the include as the parser found it, and the include must be read here.
+*/
+bool HParser::takePrefetched(int site, std::string const& link, IncludeType type, ParsedInclude& out) {
+    auto found = prefetched.find(site);
+    if (found == prefetched.end() || found->second.link != link || found->second.type != type || found->second.depth != depth) {
+        return false; // a mismatched entry is left for discardPrefetched.
+    }
+    PrefetchedInclude entry = found->second;
+    prefetched.erase(found);
+    if (!entry.task) {
+        readInclude(link, type, depth, out, entry.read);
+        return true;
+    }
+    entry.task->wait();
+    out = std::move(*entry.result);
+    return true;
+}
+
+/*
+    Cancels or waits for every prefetched include that was not spliced and deletes what they parsed. The tasks read
+    this parser, so this must run before it is destroyed. Reads still in flight finish on their own.
+*/
+void HParser::discardPrefetched() {
+    for (auto& [site, entry] : prefetched) {
+        if (!entry.task || entry.task->cancel()) {
+            continue;
+        }
+        try {
+            entry.task->wait();
+        } catch (...) { // the include is not used, neither is its error.
+            continue;
+        }
+        if (HParser * unused = entry.result->parser) {
+            std::visit(deleteHObj, unused->rootObject);
+            delete unused;
+        }
+    }
+    prefetched.clear();
+}
+
+/*
+    Passes on the diagnostics of an include: collected with this parser's when it has a list, printed otherwise.
+*/
+void HParser::reportAll(std::vector<Diagnostic> const& found) {
+    if (diagnostics) {
+        diagnostics->insert(diagnostics->end(), found.begin(), found.end());
+        return;
+    }
+    for (auto const& diagnostic : found) {
+        std::cerr << "[line " << diagnostic.line << "] Error: " << diagnostic.message << std::endl;
+    }
+}
+
 HTree * HParser::parseInclude(std::vector<std::string> rootPath) {
-    std::string keyValue = rootPath[rootPath.size()-1];
+    int site = current;
     std::tuple<std::string, IncludeType, bool> out = hoconInclude();
     HTree * res;
     if (std::get<0>(out) == "") {
         return nullptr;
+    } else if (includeNesting >= MAX_INCLUDE_NESTING) {
+        stopNesting("includes are nested more than " + std::to_string(MAX_INCLUDE_NESTING) + " levels deep, " + std::get<0>(out) + " is probably part of an include cycle", DIAG_INCLUDE);
+        return nullptr;
     } else {
-        std::string content = getFileText(std::get<0>(out), std::get<1>(out));
-        if (content == "" && !std::get<2>(out)){
-            return nullptr;
-        } else if (content == "") {
-            error(peek().line, "include file " + std::get<0>(out) + " could not be opened.");
+        ParsedInclude parsed;
+        if (!takePrefetched(site, std::get<0>(out), std::get<1>(out), parsed)) {
+            readInclude(std::get<0>(out), std::get<1>(out), depth, parsed);
+        }
+        if (activeStats) {
+            activeStats->merge(parsed.stats);
+        }
+        reportAll(parsed.diagnostics);
+        validConf = validConf && !parsed.lexError && !parsed.depthExceeded;
+        if (parsed.depthExceeded) { // reported by the include, the including files give up quietly as well.
+            depthExceeded = true;
+            current = length - 1;
+        }
+        HParser * includeParser = parsed.parser;
+        if (!includeParser) {
+            if (parsed.stamped) {
+                dependencies.push_back(parsed.stamp); // still a dependency, the file may be created later.
+            }
+            if (std::get<2>(out)) {
+                error(peek().line, "include file " + std::get<0>(out) + " could not be opened.", DIAG_INCLUDE);
+            }
             return nullptr;
         }
-        Lexer lexer = Lexer(content);
-        std::vector<Token> tokens = lexer.run();
-        HParser includeParser = HParser(tokens);
-        includeParser.parseTokens();
+        dependencies.insert(dependencies.end(), includeParser->dependencies.begin(), includeParser->dependencies.end());
         int stackOffset = stack.size();
 
         // need to set includePrefix for both the stack and the tree because they are separate objects representing the same data.
         // by the time that we set the data in the tree, the unset version of the object was already copied to the stack.
-        for (auto pair : includeParser.stack) {
+        for (auto pair : includeParser->stack) {
             std::vector<std::string> resolvedIncludePath = pair.first;
             resolvedIncludePath.insert(resolvedIncludePath.begin(), rootPath.begin(), rootPath.end());
             if(std::holds_alternative<HSubstitution*>(pair.second)) {
@@ -1503,11 +2348,14 @@ HTree * HParser::parseInclude(std::vector<std::string> rootPath) {
             }
             pushStack(resolvedIncludePath, pair.second);
         }
-        if (std::holds_alternative<HArray*>(includeParser.rootObject)) {
-            error(0, "cannot include a json file which contains an array as the root.");
+        if (std::holds_alternative<HArray*>(includeParser->rootObject)) {
+            error(0, "cannot include a json file which contains an array as the root.", DIAG_INCLUDE);
+            delete std::get<HArray*>(includeParser->rootObject);
+            delete includeParser;
             return new HTree();
         }
-        res = std::get<HTree*>(includeParser.rootObject);
+        res = std::get<HTree*>(includeParser->rootObject);
+        delete includeParser;
         for (HSubstitution * sub : res->getUnresolvedSubs()) {
             sub->includePrefix = rootPath;
             for(auto path : sub->values) {
@@ -1518,12 +2366,132 @@ HTree * HParser::parseInclude(std::vector<std::string> rootPath) {
             }
         }
         if (!res && !std::get<2>(out)) {
-            error(peek().line, "non optional include failed to evaluate.");
+            error(peek().line, "non optional include failed to evaluate.", DIAG_INCLUDE);
         }
         return res;
     }
 }
 
+/*
+    Walks an object and its deepCopy side by side, recording which copied tree/array corresponds to each original one.
+*/
+void mapCopiedNodes(std::variant<HTree*, HArray*, HSimpleValue*, HSubstitution*> original, std::variant<HTree*, HArray*, HSimpleValue*, HSubstitution*> copy, std::unordered_map<std::variant<HTree*, HArray*>, std::variant<HTree*, HArray*>>& mapping) {
+    std::vector<std::pair<std::variant<HTree*, HArray*, HSimpleValue*, HSubstitution*>, std::variant<HTree*, HArray*, HSimpleValue*, HSubstitution*>>> pending{std::make_pair(original, copy)};
+    while (!pending.empty()) {
+        auto [from, to] = pending.back();
+        pending.pop_back();
+        if (from.index() != to.index()) {
+            continue;
+        }
+        if (std::holds_alternative<HTree*>(from)) {
+            HTree * fromTree = std::get<HTree*>(from);
+            HTree * toTree = std::get<HTree*>(to);
+            mapping[fromTree] = toTree;
+            for (auto const& key : fromTree->memberOrder) {
+                if (toTree->memberExists(key)) {
+                    pending.push_back(std::make_pair(fromTree->members.at(key), toTree->members.at(key)));
+                }
+            }
+        } else if (std::holds_alternative<HArray*>(from)) {
+            HArray * fromArr = std::get<HArray*>(from);
+            HArray * toArr = std::get<HArray*>(to);
+            mapping[fromArr] = toArr;
+            for (size_t i = 0; i < fromArr->elements.size() && i < toArr->elements.size(); i++) {
+                pending.push_back(std::make_pair(fromArr->elements[i], toArr->elements[i]));
+            }
+        } else if (std::holds_alternative<HSubstitution*>(from)) {
+            HSubstitution * fromSub = std::get<HSubstitution*>(from);
+            HSubstitution * toSub = std::get<HSubstitution*>(to);
+            for (size_t i = 0; i < fromSub->values.size() && i < toSub->values.size(); i++) {
+                if (std::holds_alternative<HTree*>(fromSub->values[i]) && std::holds_alternative<HTree*>(toSub->values[i])) {
+                    pending.push_back(std::make_pair(std::get<HTree*>(fromSub->values[i]), std::get<HTree*>(toSub->values[i])));
+                } else if (std::holds_alternative<HArray*>(fromSub->values[i]) && std::holds_alternative<HArray*>(toSub->values[i])) {
+                    pending.push_back(std::make_pair(std::get<HArray*>(fromSub->values[i]), std::get<HArray*>(toSub->values[i])));
+                }
+            }
+        }
+    }
+}
+
+/*
+    Deep copies the parse results (root object, stack and dependencies) of this parser. Stack entries keep parent
+    pointers into the root object, so those are redirected to the matching nodes of the copied root.
+*/
+HParser * HParser::clone() {
+    HParser * copy = new HParser(std::vector<Token>());
+    std::unordered_map<std::variant<HTree*, HArray*>, std::variant<HTree*, HArray*>> mapping;
+    if (std::holds_alternative<HTree*>(rootObject)) {
+        HTree * root = std::get<HTree*>(rootObject)->deepCopy();
+        mapCopiedNodes(std::get<HTree*>(rootObject), root, mapping);
+        copy->rootObject = root;
+    } else {
+        HArray * root = std::get<HArray*>(rootObject)->deepCopy();
+        mapCopiedNodes(std::get<HArray*>(rootObject), root, mapping);
+        copy->rootObject = root;
+    }
+    for (auto pair : stack) {
+        std::variant<HTree*, HArray*, HSimpleValue*, HSubstitution*> value = std::visit(getDeepCopy, pair.second);
+        auto found = mapping.find(std::visit(getParent, value));
+        if (found != mapping.end()) {
+            std::visit([&found](auto * obj) { obj->parent = found->second; }, value);
+        }
+        copy->stack.push_back(std::make_pair(pair.first, value));
+    }
+    copy->dependencies = dependencies;
+    copy->includeCache = includeCache;
+    copy->rootBrace = rootBrace;
+    copy->validConf = validConf;
+    return copy;
+}
+
+IncludeCache::~IncludeCache() {
+    for (auto pair : entries) {
+        std::visit(deleteHObj, pair.second->rootObject);
+        delete pair.second;
+    }
+}
+
+/*
+    @returns a clone of the cached parse of link, or nullptr if there is no entry or any file it depends on changed.
+*/
+HParser * IncludeCache::find(std::string const& link) {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    auto found = entries.find(link);
+    if (found == entries.end()) {
+        return nullptr;
+    }
+    for (auto const& stamp : found->second->dependencies) {
+        if (!(getIncludeStamp(stamp.path) == stamp)) {
+            return nullptr;
+        }
+    }
+    hits++;
+    return found->second->clone();
+}
+
+/*
+    @returns true if there is an entry for link, current or not.
+*/
+bool IncludeCache::contains(std::string const& link) {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    return entries.count(link) > 0;
+}
+
+/*
+    Takes ownership of parser, replacing any previous entry for link.
+*/
+void IncludeCache::store(std::string const& link, HParser * parser) {
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    auto found = entries.find(link);
+    if (found != entries.end()) {
+        std::visit(deleteHObj, found->second->rootObject);
+        delete found->second;
+        found->second = parser;
+    } else {
+        entries.insert(std::make_pair(link, parser));
+    }
+}
+
 // helper methods for creating parsed objects
 
 /*
@@ -1617,214 +2585,71 @@ std::vector<std::string> HParser::splitPath(std::string const& path) {
     return out;
 } 
 
-/*
-    parses the next chain of adjacent arrays and their corresponding tokens, and returning the merged result. Adds the resulting elements to the stack history.
-*/
-HArray * HParser::concatAdjacentArrays() {
-    HArray * curr = hoconArray();
-    while (match(LEFT_BRACKET)) { // array concatenation here;
-        curr->concatArrays(hoconArray());
-    }
-    return curr;
+bool HParser::isInclude(Token t) {
+    return (t.type == UNQUOTED_STRING && t.lexeme == "include");
 }
 
 /*
-    parses the next chain of adjacent objects and their corresponding tokens, and returning the merged result. Adds the resulting elements to the stack history.
+    The stack is only read when resolving substitutions (+= is one too) and when splicing includes, which may hold
+    substitutions of their own. A document with none of them can be parsed with recordStack false, which saves a deep
+    copy of every assignment; that copy makes nested objects quadratic in their depth.
 */
-HTree * HParser::mergeAdjacentTrees(std::vector<std::string> path) {
-    HTree * curr = hoconTree(path); // ends after consuming right brace.
-    while (match(LEFT_BRACE)) { // obj concatenation here
-        HTree * next = hoconTree(path);
-        if(next && curr) {
-            curr->mergeTrees(next);
-            delete next;
-        } else if (next) {
-            curr = next;
+bool HParser::needsStack(std::vector<Token> const& tokens) {
+    for (Token const& t : tokens) {
+        if (t.type == SUB || t.type == SUB_OPTIONAL || t.type == PLUS_EQUAL || (t.type == UNQUOTED_STRING && t.lexeme == "include")) {
+            return true;
         }
     }
-    return curr;
+    return false;
 }
 
 /*
-    parses the next chain of adjacent objects and their corresponding tokens, and returning the merged result. Does not add resulting elements to the stack history.
+    Reads the file or url include whose include keyword is tokens[index] the way hoconInclude does, without consuming
+    anything or reporting errors.
+    @returns false for heuristic includes and anything hoconInclude would reject.
 */
-HTree * HParser::mergeAdjacentArraySubTrees() {
-    HTree * curr = hoconArraySubTree(); // ends after consuming right brace.
-    while (match(LEFT_BRACE)) { // obj concatenation here
-        HTree * next = hoconArraySubTree();
-        if(next && curr) {
-            curr->mergeTrees(next);
-            delete next;
-        } else if (next) {
-            curr = next;
-        }
+bool HParser::scanInclude(std::vector<Token> const& tokens, size_t index, std::string& link, IncludeType& type) {
+    size_t i = index + 1;
+    auto at = [&tokens, &i](TokenType tokenType) { return i < tokens.size() && tokens[i].type == tokenType; };
+    if (at(WHITESPACE)) {
+        i++;
     }
-    return curr;
-}
-
-HSubstitution * HParser::parseSubstitution(std::variant<HTree*, HArray*, HSimpleValue*> prefix, std::vector<std::string> parentPath, bool addingToStack) {
-    std::vector<std::variant<HTree*, HArray*, HSimpleValue*, HPath*>> values;
-    size_t subType = 3;
-    switch(prefix.index()) {
-        case 0:
-            values.push_back(std::get<HTree*>(prefix));
-            subType = 0;
-            break;
-        case 1:
-            values.push_back(std::get<HArray*>(prefix));
-            subType = 1;
-            break;
-        case 2:
-            values.push_back(std::get<HSimpleValue*>(prefix));
-            subType = 2;
-            break;
-    } 
-    while(!match(NEWLINE) && !check(COMMA) && !atEnd()) {
-        if(match(LEFT_BRACE)){
-            if(subType == 3) {
-                subType = 0;
-            } else if (subType != 0) {
-                error(peek().line, "substitution mismatched types, expected type " + std::to_string(subType) + " got " + std::to_string(0));
-                consumeSubstitution();
-                return new HSubstitution(values);
-            }
-            if (addingToStack) {
-                HTree * obj = hoconTree(parentPath);
-                if (obj) values.push_back(obj);
-            } else {
-                values.push_back(hoconArraySubTree());
-            }
-        } else if (match(LEFT_BRACKET)) {
-            if(subType == 3) {
-                subType = 1;
-            } else if (subType != 1) {
-                error(peek().line, "substitution mismatched types, expected type " + std::to_string(subType) + " got " + std::to_string(1));
-                consumeSubstitution();
-                return new HSubstitution(values);
-            }
-            values.push_back(hoconArray());
-        } else if (check(SUB) || check(SUB_OPTIONAL)) { 
-            HPath * path = new HPath(advance());
-            if (subType < 2) ignoreInlineWhitespace();
-            else path->suffixWhitespace = check(WHITESPACE) ? advance().lexeme : "";
-            values.push_back(path);
-        } else {
-            if(subType == 3) {
-                subType = 2;
-            } else if (subType != 2) {
-                error(peek().line, "substitution mismatched types, expected type " + std::to_string(subType) + "got " + std::to_string(2));
-                consumeSubstitution();
-                return new HSubstitution(values);
-            }
-            values.push_back(hoconSimpleValue());
+    bool required = at(UNQUOTED_STRING) && tokens[i].lexeme == "required";
+    if (required) {
+        i++;
+        if (!at(LEFT_PAREN)) {
+            return false;
+        }
+        i++;
+        if (at(WHITESPACE)) {
+            i++;
         }
     }
-    HSubstitution * out = new HSubstitution(values);
-    for (auto element : values) {
-        out->interrupts.push_back(false);
+    if (!at(UNQUOTED_STRING) || (tokens[i].lexeme != "url" && tokens[i].lexeme != "file")) {
+        return false;
     }
-    out->substitutionType = subType;
-    return out;
-}
-
-HSubstitution * HParser::parseSubstitution(std::vector<std::string> parentPath, bool addingToStack) {
-    std::vector<std::variant<HTree*, HArray*, HSimpleValue*, HPath*>> values;
-    size_t subType = 3;
-    while(!match(NEWLINE) && !check(std::vector<TokenType>{COMMA, RIGHT_BRACE, RIGHT_BRACKET}) && !atEnd()) {
-        if(match(LEFT_BRACE)){
-            if(subType == 3) {
-                subType = 0;
-            } else if (subType != 0) {
-                error(peek().line, "substitution mismatched types, expected type " + std::to_string(subType) + " got " + std::to_string(0));
-                consumeSubstitution();
-                return new HSubstitution(values);
-            }
-            if (addingToStack) {
-                HTree * obj = hoconTree(parentPath);
-                values.push_back(obj);
-            } else {
-                values.push_back(hoconArraySubTree());
-            }
-        } else if (match(LEFT_BRACKET)) {
-            if(subType == 3) {
-                subType = 1;
-            } else if (subType != 1) {
-                error(peek().line, "substitution mismatched types, expected type " + std::to_string(subType) + " got " + std::to_string(1));
-                consumeSubstitution();
-                return new HSubstitution(values);
-            }
-            values.push_back(hoconArray());
-        } else if (check(SUB) || check(SUB_OPTIONAL)) { 
-            HPath * path = new HPath(advance());
-            if (subType < 2) ignoreInlineWhitespace();
-            else path->suffixWhitespace = check(WHITESPACE) ? advance().lexeme : "";
-            values.push_back(path);
-        } else {
-            if(subType == 3) {
-                subType = 2;
-            } else if (subType != 2) {
-                error(peek().line, "substitution mismatched types, expected type " + std::to_string(subType) + " got " + std::to_string(2));
-                consumeSubstitution();
-                return new HSubstitution(values);
-            }
-            values.push_back(hoconSimpleValue());
-        }
+    type = tokens[i].lexeme == "url" ? URL : FILEPATH;
+    i++;
+    if (!at(LEFT_PAREN)) {
+        return false;
     }
-    HSubstitution * out = new HSubstitution(values);
-    for (auto element : values) {
-        out->interrupts.push_back(false);
+    i++;
+    if (at(WHITESPACE)) {
+        i++;
     }
-    out->substitutionType = subType;
-    return out;
-}
-
-bool HParser::isInclude(Token t) {
-    return (t.type == UNQUOTED_STRING && t.lexeme == "include");
-}
-
-// mini helper method for getFileText
-size_t write_to_string(void *ptr, size_t size, size_t count, void *stream) {
-  ((std::string*)stream)->append((char*)ptr, 0, size*count);
-  return size*count;
-}
-
-std::string HParser::getFileText(std::string const& link, IncludeType type) {
-    std::ifstream includedFile;
-    std::string content;
-    switch (type) {
-        case URL:
-            CURL *curl;
-            CURLcode result;
-
-            // Create our curl handle  
-            curl = curl_easy_init();  
-            curl_easy_setopt(curl, CURLOPT_URL, link.c_str());
-            curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_to_string);
-            curl_easy_setopt(curl, CURLOPT_WRITEDATA, &content);
-
-            result = curl_easy_perform(curl);
-            curl_easy_cleanup(curl);
-            if(result != CURLE_OK) return "";
-            break;                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                             
-        case FILEPATH:
-            includedFile = std::ifstream(link);
-            if (!includedFile.is_open()) {
-                return "";
-            } else {
-                std::ostringstream stream;
-                stream << includedFile.rdbuf();
-                content = stream.str();
-            }
-            break;
-        case HEURISTIC:
-            break;
+    if (!at(QUOTED_STRING) || !std::holds_alternative<std::string>(tokens[i].literal)) {
+        return false;
     }
-    return content;
+    link = std::get<std::string>(tokens[i].literal);
+    return link != "";
 }
 
 // parsing steps:
 
 void HParser::parseTokens() {
+    if (includePool || resolvers) {
+        prefetchIncludes();
+    }
     ignoreAllWhitespace();
     if (match(LEFT_BRACKET)) { // root array
         ignoreAllWhitespace();
@@ -1848,9 +2673,11 @@ void HParser::parseTokens() {
     if (!atEnd()){
         error(peek().line, "Expected EOF, got " + peek().lexeme);
     }
+    discardPrefetched();
 }
 
 void HParser::resolveSubstitutions() {
+    errorCode = DIAG_SUBSTITUTION;
     std::unordered_set<HSubstitution*> subs = getUnresolvedSubs();
     std::vector<std::variant<HTree*, HArray*, HSimpleValue*, HSubstitution*>> resolved; // temp
     while ( !subs.empty() ) { // temporary loop for testing resolveSub();
@@ -1887,6 +2714,7 @@ std::unordered_set<HSubstitution*> HParser::getUnresolvedSubs() {
     do more testing. write more tests.
 */
 std::variant<HTree*, HArray*, HSimpleValue*, HSubstitution*> HParser::resolveSub(HSubstitution* sub, std::unordered_set<HSubstitution*>& set, std::unordered_set<HSubstitution*> history) {
+    countStat(COUNT_SUBSTITUTIONS);
     std::variant<HTree*, HArray*, HSimpleValue*, HSubstitution*> concatValue;
     for (size_t i = 0; i < sub->values.size(); i++) {
         std::variant<HTree *, HArray *, HSimpleValue*, HPath*> value = sub->values[i];
@@ -1900,9 +2728,11 @@ std::variant<HTree*, HArray*, HSimpleValue*, HSubstitution*> HParser::resolveSub
                 path->path = oldPath;
                 res = resolvePath(path);
             }
-            std::string envVar = getEnvVar(pathToString(path->path));
-            if (envVar != "" && !std::visit(valueExists, res)) { // if no path resolves, look in the environment variables.
-                res = new HSimpleValue(envVar, std::vector<Token>{Token(UNQUOTED_STRING, envVar, envVar, 0)}, 1);
+            if (!std::visit(valueExists, res)) { // if no path resolves, look in the environment variables.
+                const std::string * envVar = findVariable(path->path);
+                if (envVar && *envVar != "") {
+                    res = new HSimpleValue(*envVar, std::vector<Token>{Token(UNQUOTED_STRING, *envVar, *envVar, 0)}, 1);
+                }
             }
             if (std::visit(valueExists, res)) {
                 //std::cout << pathToString(std::get<HPath*>(value)->path) << " resolved to \"" << std::visit(stringify, res) << "\""<< std::endl;
@@ -2013,8 +2843,11 @@ std::variant<HTree*, HArray*, HSimpleValue*, HSubstitution*> HParser::resolvePat
         //std::cout << path->str() << " is a self ref" << std::endl;
         it = stack.rend() - path->counter;
     }
+    size_t steps = 0;
     for (it; it != stack.rend(); it++) {
+        steps++;
         if(path->path == it->first) {
+            countStat(COUNT_PATH_STEPS, steps);
             if (std::holds_alternative<HSubstitution*>(it->second)) {
                 out = it->second;
             } else {
@@ -2032,6 +2865,7 @@ std::variant<HTree*, HArray*, HSimpleValue*, HSubstitution*> HParser::resolvePat
             return out;
         }
     }
+    countStat(COUNT_PATH_STEPS, steps);
     return out;
 }
 
@@ -2089,8 +2923,11 @@ std::variant<HTree *, HArray *, HSimpleValue*, HSubstitution*> HParser::concatSu
 
 std::variant<HTree *, HArray *, HSimpleValue*, HSubstitution*> HParser::resolvePrevValue(int counter, std::vector<std::string> path) {
     std::variant<HTree*,HArray*, HSimpleValue*, HSubstitution*> out;
+    size_t steps = 0;
     for (auto it = stack.rend() - counter; it != stack.rend(); it++) {
+        steps++;
         if (path == it->first) {
+            countStat(COUNT_PATH_STEPS, steps);
             if (std::holds_alternative<HSubstitution*>(it->second)) {
                 out = it->second;
             } else {
@@ -2099,41 +2936,258 @@ std::variant<HTree *, HArray *, HSimpleValue*, HSubstitution*> HParser::resolveP
             return out;
         }
     }
+    countStat(COUNT_PATH_STEPS, steps);
     return out;
 }
 
-std::variant<HTree*, HArray*, HSimpleValue*> HParser::getByPath(std::vector<std::string> const& path) {
+/*
+    Lazy mode: resolves a substitution left in the tree, with its transitive dependencies, the first time it is read and
+    caches the result in the substitution. The tree itself is never modified, so readers that do not reach the
+    substitution are unaffected, and once the value is cached every thread reads it without locking.
+*/
+std::variant<HTree*, HArray*, HSimpleValue*> HParser::resolveLazy(HSubstitution * sub) const {
+    std::call_once(sub->resolveOnce, [this, sub]() {
+        std::lock_guard<std::mutex> lock(resolveMutex);
+        HParser * self = const_cast<HParser*>(this); // resolution only touches the stack and sub, both guarded here.
+        bool wasValid = self->validConf;
+        self->validConf = true;
+        std::vector<Diagnostic> discarded; // a failed lazy resolution is reported by the getter throwing, not printed.
+        std::vector<Diagnostic> * wasDiagnostics = self->diagnostics;
+        self->diagnostics = &discarded;
+        self->errorCode = DIAG_SUBSTITUTION;
+        std::unordered_set<HSubstitution*> dummy;
+        std::variant<HTree*, HArray*, HSimpleValue*, HSubstitution*> result = self->resolveSub(sub, dummy, std::unordered_set<HSubstitution*>());
+        if (!self->validConf || std::holds_alternative<HSubstitution*>(result)) {
+            std::visit(deleteHObj, result);
+            sub->resolveFailed = true;
+        } else if (std::holds_alternative<HTree*>(result)) {
+            sub->resolvedValue = std::get<HTree*>(result);
+        } else if (std::holds_alternative<HArray*>(result)) {
+            sub->resolvedValue = std::get<HArray*>(result);
+        } else {
+            sub->resolvedValue = std::get<HSimpleValue*>(result);
+        }
+        self->validConf = wasValid;
+        self->diagnostics = wasDiagnostics;
+        sub->resolved = true;
+    });
+    return sub->resolvedValue;
+}
+
+/*
+    The variable named by a substitution path that is not in the configuration, the segments joined with dots.
+    @returns nullptr if there is no such variable.
+*/
+const std::string * HParser::findVariable(std::vector<std::string> const& path) {
+    if (!variables) {
+        variables = captureEnvironment();
+    }
+    auto found = variables->find(pathToString(path));
+    return found == variables->end() ? nullptr : &found->second;
+}
+
+/*
+    The value readers see for a member or element: in lazy mode a substitution reads as its resolved value, which is a
+    null HTree pointer if it resolved to nothing. Anything else is returned as is.
+*/
+std::variant<HTree*, HArray*, HSimpleValue*, HSubstitution*> HParser::readValue(std::variant<HTree*, HArray*, HSimpleValue*, HSubstitution*> const& value) const {
+    if (!lazy || !std::holds_alternative<HSubstitution*>(value)) {
+        return value;
+    }
+    HSubstitution * sub = std::get<HSubstitution*>(value);
+    std::variant<HTree*, HArray*, HSimpleValue*> res = resolveLazy(sub);
+    if (sub->resolveFailed) {
+        throw std::runtime_error("Error: the substitution at path " + pathToString(sub->getPath()) + " failed to resolve");
+    }
+    std::variant<HTree*, HArray*, HSimpleValue*, HSubstitution*> out;
+    std::visit([&out](auto resolved) { out = resolved; }, res);
+    return out;
+}
+
+/*
+    Lazy mode: resolves every substitution below value, so the subtree can be copied or written out as plain values.
+*/
+void HParser::resolveAll(std::variant<HTree*, HArray*, HSimpleValue*, HSubstitution*> const& value) const {
+    std::vector<std::variant<HTree*, HArray*, HSimpleValue*, HSubstitution*>> pending{value};
+    while (!pending.empty()) {
+        std::variant<HTree*, HArray*, HSimpleValue*, HSubstitution*> curr = readValue(pending.back());
+        pending.pop_back();
+        if (std::holds_alternative<HTree*>(curr) && std::get<HTree*>(curr)) {
+            for (auto const& member : std::get<HTree*>(curr)->members) {
+                pending.push_back(member.second);
+            }
+        } else if (std::holds_alternative<HArray*>(curr)) {
+            HArray * arr = std::get<HArray*>(curr);
+            pending.insert(pending.end(), arr->elements.begin(), arr->elements.end());
+        }
+    }
+}
+
+/*
+    Read only lookup of a path in the root object. Members are looked up with find, so a miss never inserts into the
+    tree and any number of threads can call this at once. In lazy mode substitutions met on the way are resolved.
+    @returns a null HTree pointer if the last key of the path does not exist.
+*/
+std::variant<HTree*, HArray*, HSimpleValue*> HParser::getByPath(std::vector<std::string> const& path) const {
     if (std::holds_alternative<HArray*>(rootObject)) {
         throw std::runtime_error("Error: cannot use path expressions for a rooted array");
     }
+    std::variant<HTree*, HArray*, HSimpleValue*> result;
+    if (path.empty()) {
+        return result;
+    }
     HTree * curr = std::get<HTree*>(rootObject);
     for (auto iter = path.begin(); iter != path.end()-1; iter++) {
-        if (curr->memberExists(*iter)) {
-            curr = std::get<HTree*>(curr->members[*iter]);
-        } else {
-            std::string out;
-            while(iter != path.begin()) {
-                out = "." + *iter + out;
-            }
-            out = *path.begin() + out;
-            throw std::runtime_error("invalid path expression, " + out + " does not exist");
+        auto member = curr->members.find(*iter);
+        if (member == curr->members.end()) {
+            return result;
         }
+        std::variant<HTree*, HArray*, HSimpleValue*, HSubstitution*> value = readValue(member->second);
+        if (!std::holds_alternative<HTree*>(value) || !std::get<HTree*>(value)) { // a value that is not an object, or a lazy substitution that resolved to nothing.
+            return result;
+        }
+        curr = std::get<HTree*>(value);
     }
-    std::string valueKey = *(path.end()-1);
-    std::variant<HTree*, HArray*, HSimpleValue*> result;
-    if (std::holds_alternative<HTree*>(curr->members[valueKey])) {
-        result = std::get<HTree*>(curr->members[valueKey]);
-    } else if (std::holds_alternative<HArray*>(curr->members[valueKey])) {
-        result = std::get<HArray*>(curr->members[valueKey]);
-    } else if (std::holds_alternative<HSimpleValue*>(curr->members[valueKey])) {
-        result = std::get<HSimpleValue*>(curr->members[valueKey]);
+    auto member = curr->members.find(*(path.end()-1));
+    if (member == curr->members.end()) {
+        return result;
+    }
+    std::variant<HTree*, HArray*, HSimpleValue*, HSubstitution*> value = readValue(member->second);
+    if (std::holds_alternative<HTree*>(value)) {
+        result = std::get<HTree*>(value);
+    } else if (std::holds_alternative<HArray*>(value)) {
+        result = std::get<HArray*>(value);
+    } else if (std::holds_alternative<HSimpleValue*>(value)) {
+        result = std::get<HSimpleValue*>(value);
     } else {
         throw std::runtime_error("unresolved substitution encountered after parsing.");
     }
     return result;
 }
 
-std::string HParser::getValueString(std::string const& path) {
+/*
+    getByPath for lookups that must not throw or allocate when the path is missing: the path is walked segment by
+    segment, with the same splitting rules as splitPath, and each key is copied into a reused thread local buffer for
+    the member lookup. A lazy substitution on the path is resolved, and its failure reported as LOOKUP_UNRESOLVED.
+    The path is relative to from, or to the root object if from is null. With a path index, a path from the root
+    without quotes is answered by the index instead of the walk.
+    @returns a null HTree pointer unless error is LOOKUP_OK.
+*/
+std::variant<HTree*, HArray*, HSimpleValue*> HParser::findByPath(std::string_view path, LookupError& error, HTree * from) const {
+    static thread_local std::string segment;
+    std::variant<HTree*, HArray*, HSimpleValue*> result;
+    error = LOOKUP_MISSING;
+    if (pathIndex && !from && path.find('"') == std::string_view::npos && (path.empty() || path.back() != '.')) {
+        size_t slot = pathIndex->find(path);
+        if (slot == PATH_INDEX_MISS) {
+            return result;
+        }
+        error = LOOKUP_OK;
+        return indexedNodes[slot];
+    }
+    HTree * curr = from ? from : std::holds_alternative<HTree*>(rootObject) ? std::get<HTree*>(rootObject) : nullptr;
+    if (path.empty() || !curr) {
+        return result;
+    }
+    size_t start = 0;
+    while (true) {
+        size_t current = start;
+        while (current < path.size() && path[current] != '.') {
+            if (path[current] == '"') {
+                current = path.find('"', current + 1);
+                current = current == std::string_view::npos ? path.size() : current + 1;
+            } else {
+                current++;
+            }
+        }
+        segment.assign(path.data() + start, current - start);
+        auto member = curr->members.find(segment);
+        if (member == curr->members.end()) {
+            return result;
+        }
+        std::variant<HTree*, HArray*, HSimpleValue*> value;
+        if (std::holds_alternative<HSubstitution*>(member->second)) {
+            HSubstitution * sub = std::get<HSubstitution*>(member->second);
+            bool failed = !lazy;
+            try {
+                value = lazy ? resolveLazy(sub) : value;
+            } catch (...) {
+                failed = true;
+            }
+            if (failed || sub->resolveFailed) {
+                error = LOOKUP_UNRESOLVED;
+                return result;
+            }
+        } else if (std::holds_alternative<HTree*>(member->second)) {
+            value = std::get<HTree*>(member->second);
+        } else if (std::holds_alternative<HArray*>(member->second)) {
+            value = std::get<HArray*>(member->second);
+        } else {
+            value = std::get<HSimpleValue*>(member->second);
+        }
+        bool missing = std::holds_alternative<HTree*>(value) && !std::get<HTree*>(value); // a substitution that resolved to nothing.
+        if (current + 1 >= path.size()) { // the last segment, allowing a trailing dot as splitPath does.
+            error = missing ? LOOKUP_MISSING : LOOKUP_OK;
+            return value;
+        }
+        if (missing || !std::holds_alternative<HTree*>(value)) {
+            return result;
+        }
+        curr = std::get<HTree*>(value);
+        start = current + 1;
+    }
+}
+
+/*
+    Indexes the full path of every object member, nested objects included, for findByPath. Only a fully resolved tree
+    whose keys need no quoting (no '.' or '"') can be indexed, and it must not change afterwards. Array elements are
+    not indexed since paths cannot address them.
+    @returns false, leaving the parser without an index, if the tree cannot be indexed.
+*/
+bool HParser::buildPathIndex() {
+    if (!std::holds_alternative<HTree*>(rootObject)) {
+        return false;
+    }
+    std::vector<std::string> paths;
+    std::vector<std::variant<HTree*, HArray*, HSimpleValue*>> nodes;
+    std::vector<std::pair<HTree*, size_t>> pending = {{std::get<HTree*>(rootObject), SIZE_MAX}}; // a tree and the index of its path.
+    while (!pending.empty()) {
+        auto [tree, parent] = pending.back();
+        pending.pop_back();
+        for (auto const& [key, value] : tree->members) {
+            if (key.find_first_of(".\"") != std::string::npos || std::holds_alternative<HSubstitution*>(value)) {
+                return false;
+            }
+            if (std::holds_alternative<HTree*>(value) && !std::get<HTree*>(value)) {
+                continue; // missing for findByPath as well.
+            }
+            paths.push_back(parent == SIZE_MAX ? key : paths[parent] + "." + key);
+            if (std::holds_alternative<HTree*>(value)) {
+                nodes.push_back(std::get<HTree*>(value));
+                pending.push_back(std::make_pair(std::get<HTree*>(value), paths.size() - 1));
+            } else if (std::holds_alternative<HArray*>(value)) {
+                nodes.push_back(std::get<HArray*>(value));
+            } else {
+                nodes.push_back(std::get<HSimpleValue*>(value));
+            }
+        }
+    }
+    PathIndex * index = new PathIndex();
+    std::vector<uint32_t> slots;
+    if (!index->build(paths, slots)) {
+        delete index;
+        return false;
+    }
+    indexedNodes.assign(nodes.size(), std::variant<HTree*, HArray*, HSimpleValue*>());
+    for (size_t i = 0; i < nodes.size(); i++) {
+        indexedNodes[slots[i]] = nodes[i];
+    }
+    delete pathIndex;
+    pathIndex = index;
+    return true;
+}
+
+std::string HParser::getValueString(std::string const& path) const {
     std::vector<std::string> splitPathStr = splitPath(path);
     return std::visit(stringify, getByPath(splitPathStr));
 }
@@ -2145,11 +3199,24 @@ std::string HParser::getValueString(std::string const& path) {
 // error reporting:
 
 void HParser::error(int line, std::string const& message) {
-    report(line, "", message);
+    if (!depthExceeded) {
+        report(line, "", message);
+    }
     validConf = false;
 }
 
+void HParser::error(int line, std::string const& message, DiagnosticCode code) {
+    DiagnosticCode previous = errorCode;
+    errorCode = code;
+    error(line, message);
+    errorCode = previous;
+}
+
 void HParser::report(int line, std::string const& where, std::string const& message) {
+    if (diagnostics) {
+        diagnostics->push_back(Diagnostic{errorCode, message, sourceName, line});
+        return;
+    }
     std::cerr << "[line " << line << "] Error" << where << ": " << message << std::endl;
 }
 
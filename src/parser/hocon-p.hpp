@@ -4,17 +4,47 @@
 #include <unordered_map>
 #include <unordered_set>
 #include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <atomic>
 #include <tuple>
 #include <fstream>
-#include <curl/curl.h>
+#include "hocon-stats.hpp"
+#include "hocon-index.hpp"
+#include "hocon-resolver.hpp"
 
-enum IncludeType {
-    URL, FILEPATH, HEURISTIC
+// default limit on how deeply objects and arrays may be nested. the parsers keep open objects and arrays on a stack of
+// their own rather than the call stack, so this only bounds the memory a document can make them use.
+const int DEFAULT_MAX_DEPTH = 100000;
+
+// limit on how deeply includes may be nested. each include is parsed by a parser of its own, called from the one that
+// includes it, so a file that includes itself would otherwise recurse until the call stack overflows.
+const int MAX_INCLUDE_NESTING = 50;
+
+/*
+    Variables a substitution falls back to when its path is not in the configuration, by default a copy of the process
+    environment (captureEnvironment) taken the first time a load needs one.
+*/
+typedef std::unordered_map<std::string, std::string> VariableMap;
+
+std::shared_ptr<const VariableMap> captureEnvironment();
+
+/*
+    Why a non-throwing lookup found no value. MISSING covers paths that run through a non-object, WRONG_TYPE a value
+    that cannot be converted to the requested type, and UNRESOLVED a lazy substitution that failed to resolve.
+*/
+enum LookupError {
+    LOOKUP_OK, LOOKUP_MISSING, LOOKUP_WRONG_TYPE, LOOKUP_UNRESOLVED
 };
 
 struct HArray;
 struct HSimpleValue;
 struct HSubstitution;
+class HParser;
+struct ParseFrame;
+struct ParseStack;
+
+std::string pathToString(std::vector<std::string> path); // joins path segments with dots.
 //struct HKey;
 
 struct HTree {
@@ -26,11 +56,11 @@ struct HTree {
     HTree();
     ~HTree();
     bool addMember(std::string const& key, std::variant<HTree*, HArray*, HSimpleValue*, HSubstitution*> value);
-    bool memberExists(std::string const& key);
+    bool memberExists(std::string const& key) const;
     void removeMember(std::string const& key);
     HTree * deepCopy();
-    std::string str();
-    std::vector<std::string> getPath();
+    std::string str() const;
+    std::vector<std::string> getPath() const;
 
     //object merge/concatenation
     void mergeTrees(HTree * second);
@@ -48,8 +78,8 @@ struct HArray {
     void addElement(std::variant<HTree*, HArray*, HSimpleValue*, HSubstitution*> val);
     void removeElementAtIndex(size_t index);
     HArray * deepCopy();
-    std::string str();
-    std::vector<std::string> getPath();
+    std::string str() const;
+    std::vector<std::string> getPath() const;
     //concatenation
     void concatArrays(HArray* second);
     std::unordered_set<HSubstitution*> getUnresolvedSubs();
@@ -63,8 +93,8 @@ struct HSimpleValue {
     size_t defaultEnd;
     HSimpleValue(std::variant<int, double, bool, std::string> s, std::vector<Token> tokenParts, size_t end);
     //HSimpleValue(std::variant<int, double, bool, std::string> s, std::vector<Token> tokenParts, std::variant<HTree*, HArray*> parent);
-    std::string str();
-    std::vector<std::string> getPath();
+    std::string str() const;
+    std::vector<std::string> getPath() const;
     HSimpleValue * deepCopy();
     void concatSimpleValues(HSimpleValue* second);
 };
@@ -83,7 +113,7 @@ struct HPath {
     HPath(Token t);
     bool optional;
     int counter = -1;
-    std::string str();
+    std::string str() const;
     HPath * deepCopy();
     bool isSelfReference();
 };
@@ -96,11 +126,63 @@ struct HSubstitution {
     std::variant<HTree*,HArray*> parent;
     size_t substitutionType = 3;
     std::string key;
+    // lazy mode (HParser::resolveLazy): the substitution stays in the tree and its value is resolved once, on first
+    // access, and cached here. resolvedValue is a null HTree pointer if the substitution resolved to nothing.
+    std::once_flag resolveOnce;
+    std::atomic<bool> resolved{false};
+    bool resolveFailed = false;
+    std::variant<HTree*, HArray*, HSimpleValue*> resolvedValue;
     HSubstitution(std::vector<std::variant<HTree*, HArray*, HSimpleValue*, HPath*>> v);
     ~HSubstitution();
-    std::string str();
+    std::string str() const;
     HSubstitution * deepCopy();
-    std::vector<std::string> getPath();
+    std::vector<std::string> getPath() const;
+};
+
+/*
+    Parsed (unresolved) include files keyed by their link. An entry is reused as long as the stamps of the file and of
+    every file it includes are unchanged, so a reload only reads, lexes and parses the files that were modified.
+    Loads running on different threads can share a cache: lookups clone entries under a shared lock, stores replace
+    them under an exclusive one.
+*/
+struct IncludeCache {
+    std::unordered_map<std::string, HParser*> entries;
+    std::atomic<size_t> hits{0};
+    std::shared_mutex mutex;
+    IncludeCache() = default;
+    IncludeCache(IncludeCache const&) = delete;
+    IncludeCache& operator=(IncludeCache const&) = delete;
+    ~IncludeCache();
+    HParser * find(std::string const& link);
+    bool contains(std::string const& link);
+    void store(std::string const& link, HParser * parser);
+};
+
+/*
+    An include file read, lexed and parsed on its own (HParser::readInclude), ready to be spliced into the document that
+    includes it. Nothing in it refers to the including document, so it can be produced on any thread.
+*/
+struct ParsedInclude {
+    HParser * parser = nullptr;         // null if the file could not be read or was empty.
+    IncludeStamp stamp;                 // of the file as it was read, unset for a cache hit.
+    bool stamped = false;               // read from disk, see IncludeResolver::stamped.
+    bool lexError = false;
+    bool depthExceeded = false;
+    std::vector<Diagnostic> diagnostics; // every error of the include and of the files it includes, in order.
+    LoadStats stats;                    // phases and counters of a prefetched include, merged when it is spliced.
+};
+
+/*
+    An include that HParser::prefetchIncludes started, keyed by the token index of its include keyword. It is only used
+    if the parser reaches that include with the same link, type and depth.
+*/
+struct PrefetchedInclude {
+    std::string link;
+    IncludeType type;
+    int depth;
+    std::shared_ptr<FileRead> read;     // started through the resolver of the include, if one accepts it.
+    std::shared_ptr<IncludeTask> task;  // parses it on the include pool, when there is one.
+    std::shared_ptr<ParsedInclude> result;
 };
 
 class HParser {
@@ -116,6 +198,24 @@ class HParser {
         int current = 0;
         int length;
         Lexer * lexer; 
+        IncludeCache * includeCache = nullptr;
+        std::vector<IncludeStamp> dependencies; // stamps of every file included while parsing, in include order.
+        bool lazy = false; // substitutions are left in the tree and resolved on first access instead of by resolveSubstitutions.
+        std::vector<Diagnostic> * diagnostics = nullptr; // when set, errors are collected here instead of printed. shared with include parsers.
+        std::string sourceName; // file name reported with the diagnostics, the include link for include parsers.
+        DiagnosticCode errorCode = DIAG_PARSE; // code of the diagnostics error() reports, DIAG_SUBSTITUTION while resolving.
+        std::shared_ptr<const VariableMap> variables; // substitution fallback, the environment is captured into it on first use if null.
+        mutable std::mutex resolveMutex; // serializes lazy resolutions, which share the stack.
+        PathIndex * pathIndex = nullptr; // set by buildPathIndex, after which the tree must not change.
+        std::vector<std::variant<HTree*, HArray*, HSimpleValue*>> indexedNodes; // the node of every indexed path, by slot.
+        bool recordStack = true; // false only when needsStack found nothing in the document that reads the stack.
+        int maxDepth = DEFAULT_MAX_DEPTH; // objects and arrays nested deeper than this fail the parse.
+        int depth = 0; // objects and arrays currently open, counting those of the including files.
+        bool depthExceeded = false; // the document, or an include, is nested too deeply: the rest of it is skipped without errors.
+        int includeNesting = 0; // 0 for the document, 1 for the files it includes, and so on.
+        IncludePool * includePool = nullptr; // when set, file and url includes are parsed ahead on it, see prefetchIncludes.
+        std::shared_ptr<const ResolverChain> resolvers; // when set, includes are read ahead through it. ResolverChain::defaults() if unset.
+        std::unordered_map<int, PrefetchedInclude> prefetched; // includes started by prefetchIncludes and not spliced yet.
 
         //look ahead/back
         Token peek();
@@ -127,7 +227,7 @@ class HParser {
         //state checking
         bool atEnd();
         void getStack();
-        void pushStack(std::vector<std::string> rootPath, std::variant<HTree*,HArray*,HSimpleValue*,HSubstitution*> value);
+        void pushStack(std::vector<std::string> const& rootPath, std::variant<HTree*,HArray*,HSimpleValue*,HSubstitution*> value);
         void pushStack(std::vector<std::string> rootPath, std::variant<HTree*,HArray*,HSimpleValue*,HSubstitution*> value, HSubstitution *);
 
         //consume
@@ -137,33 +237,51 @@ class HParser {
         void ignoreAllWhitespace();
         void ignoreInlineWhitespace();
         void consumeMember();
-        void consumeElement();
-        void consumeSubstitution();
         void consumeToNextMember();
         void consumeToNextRootMember();
-        void consumeToNextElement();
+        bool separateMember();
+        bool separateElement();
+        bool nestedTooDeep();
+        void stopNesting(std::string const& message, DiagnosticCode code);
 
         //create parsed objects :: Assignment
         HTree * rootTree();
-        HTree * hoconTree(std::vector<std::string> parentPath);
+        HTree * hoconTree(std::vector<std::string> const& parentPath);
+        HTree * hoconTree(std::vector<std::string>& rootPath); // rootPath is the path of the object, and is restored before returning.
         HArray * hoconArray();
         HTree * hoconArraySubTree();
         HSimpleValue * hoconSimpleValue();
         std::vector<std::string> hoconKey();
         std::tuple<std::string, IncludeType, bool> hoconInclude();
         HTree * parseInclude(std::vector<std::string> rootPath);
+        void readInclude(std::string const& link, IncludeType type, int depth, ParsedInclude& out, std::shared_ptr<FileRead> const& pending = nullptr);
+        void prefetchIncludes();
+        bool takePrefetched(int site, std::string const& link, IncludeType type, ParsedInclude& out);
+        void discardPrefetched();
+        void reportAll(std::vector<Diagnostic> const& found);
+        HParser * clone();
 
         //helper methods for creating parsed objects
         HTree * findOrCreatePath(std::vector<std::string> path, HTree * parent);
         static std::vector<std::string> splitPath(std::vector<Token> keyTokens);
         static std::vector<std::string> splitPath(std::string const& path);
         HArray * concatAdjacentArrays();
-        HTree * mergeAdjacentTrees(std::vector<std::string> parentPath);
-        HTree * mergeAdjacentArraySubTrees();
-        HSubstitution * parseSubstitution(std::variant<HTree*,HArray*,HSimpleValue*> prefix, std::vector<std::string> parentPath, bool addingToStack);
-        HSubstitution * parseSubstitution(std::vector<std::string> parentPath, bool addingToStack);
+        HTree * mergeAdjacentTrees(std::vector<std::string>& parentPath);
+        HSubstitution * parseSubstitution(std::variant<HTree*,HArray*,HSimpleValue*> prefix, std::vector<std::string> const& parentPath, bool addingToStack);
+        HSubstitution * parseSubstitution(std::vector<std::string> const& parentPath, bool addingToStack);
+
+        //explicit parse stack, see runFrames
+        std::variant<HTree*, HArray*, HSubstitution*> runFrames(ParseFrame first);
+        void stepTree(ParseStack& parse);
+        void stepArraySubTree(ParseStack& parse);
+        void stepArray(ParseStack& parse);
+        void stepMergeTrees(ParseStack& parse);
+        void stepConcatArrays(ParseStack& parse);
+        void stepSubstitution(ParseStack& parse);
+        void stepSkip(ParseStack& parse);
         bool isInclude(Token t);
-        std::string getFileText(std::string const& link, IncludeType type);
+        static bool scanInclude(std::vector<Token> const& tokens, size_t index, std::string& link, IncludeType& type);
+        static bool needsStack(std::vector<Token> const& tokens);
         
         //HSimpleValue * concatSimpleValues(HSimpleValue * first, HSimpleValue * second);
         // ^ is automatically performed in hoconSimpleValue();
@@ -177,6 +295,8 @@ class HParser {
         std::variant<HTree*, HArray*, HSimpleValue*, HSubstitution*> resolvePath(HPath* path);
         std::variant<HTree*, HArray*, HSimpleValue*, HSubstitution*> concatSubValue(std::variant<HTree *, HArray *, HSimpleValue*, HSubstitution*> source, std::variant<HTree *, HArray *, HSimpleValue*, HSubstitution*> target, bool interrupt);
         std::variant<HTree*, HArray*, HSimpleValue*, HSubstitution*> resolvePrevValue(int counter, std::vector<std::string> path);
+        std::variant<HTree*, HArray*, HSimpleValue*> resolveLazy(HSubstitution * sub) const;
+        const std::string * findVariable(std::vector<std::string> const& path);
         /*
          * Note: to do substitutions, we need to keep an auxillary file keeping track of all object member additions and modifications
          * also, we need to give the substitution a handle on where to enter the file, if it is a self referential substitution.
@@ -186,6 +306,7 @@ class HParser {
 
         //error reporting
         void error(int line, std::string const& message);
+        void error(int line, std::string const& message, DiagnosticCode code);
         void report(int line, std::string const& where, std::string const& message);
     public:
         bool run(); 
@@ -195,8 +316,12 @@ class HParser {
         ~HParser();
         //access methods:
         std::variant<HTree*, HArray*> getRoot();
-        std::variant<HTree*, HArray*, HSimpleValue*> getByPath(std::vector<std::string> const& path);
-        std::string getValueString(std::string const& path);
+        std::variant<HTree*, HArray*, HSimpleValue*> getByPath(std::vector<std::string> const& path) const;
+        std::variant<HTree*, HArray*, HSimpleValue*> findByPath(std::string_view path, LookupError& error, HTree * from = nullptr) const;
+        std::variant<HTree*, HArray*, HSimpleValue*, HSubstitution*> readValue(std::variant<HTree*, HArray*, HSimpleValue*, HSubstitution*> const& value) const;
+        void resolveAll(std::variant<HTree*, HArray*, HSimpleValue*, HSubstitution*> const& value) const;
+        std::string getValueString(std::string const& path) const;
+        bool buildPathIndex();
 };
 
 
@@ -0,0 +1,86 @@
+#include "hocon-resolver.hpp"
+
+bool IncludeResolver::stamped() const {
+    return false;
+}
+
+std::shared_ptr<FileRead> IncludeResolver::read(std::string const& link) {
+    return readAll(std::vector<std::string>{link}).front();
+}
+
+FileResolver::FileResolver(std::shared_ptr<FileReader> reader) : reader(reader) {}
+
+bool FileResolver::accepts(std::string const&, IncludeType type) const {
+    return type == FILEPATH;
+}
+
+std::vector<std::shared_ptr<FileRead>> FileResolver::readAll(std::vector<std::string> const& links) {
+    return (reader ? *reader : FileReader::shared()).readAll(links);
+}
+
+bool FileResolver::stamped() const {
+    return true;
+}
+
+#ifdef HOCON_CURL
+UrlResolver::UrlResolver(std::shared_ptr<HttpFetcher> fetcher) : fetcher(fetcher) {}
+
+bool UrlResolver::accepts(std::string const&, IncludeType type) const {
+    return type == URL;
+}
+
+std::vector<std::shared_ptr<FileRead>> UrlResolver::readAll(std::vector<std::string> const& links) {
+    return (fetcher ? *fetcher : HttpFetcher::shared()).readAll(links);
+}
+#endif
+
+MemoryResolver::MemoryResolver(std::unordered_map<std::string, std::string> sources) : sources(std::move(sources)) {}
+
+void MemoryResolver::add(std::string const& name, std::string const& content) {
+    sources[name] = content;
+}
+
+bool MemoryResolver::accepts(std::string const& link, IncludeType) const {
+    return sources.count(link) > 0;
+}
+
+std::vector<std::shared_ptr<FileRead>> MemoryResolver::readAll(std::vector<std::string> const& links) {
+    std::vector<std::shared_ptr<FileRead>> reads;
+    for (auto const& link : links) {
+        auto read = std::make_shared<FileRead>(link);
+        auto found = sources.find(link);
+        if (found != sources.end()) {
+            read->content = found->second;
+        }
+        read->complete(found != sources.end());
+        reads.push_back(read);
+    }
+    return reads;
+}
+
+ResolverChain::ResolverChain(std::vector<std::shared_ptr<IncludeResolver>> resolvers) : resolvers(std::move(resolvers)) {}
+
+void ResolverChain::add(std::shared_ptr<IncludeResolver> resolver) {
+    resolvers.push_back(resolver);
+}
+
+IncludeResolver * ResolverChain::find(std::string const& link, IncludeType type) const {
+    for (auto const& resolver : resolvers) {
+        if (resolver->accepts(link, type)) {
+            return resolver.get();
+        }
+    }
+    return nullptr;
+}
+
+ResolverChain const& ResolverChain::defaults() {
+    static ResolverChain chain = []() {
+        ResolverChain chain;
+        chain.add(std::make_shared<FileResolver>(std::make_shared<InlineFileReader>()));
+#ifdef HOCON_CURL
+        chain.add(std::make_shared<UrlResolver>());
+#endif
+        return chain;
+    }();
+    return chain;
+}
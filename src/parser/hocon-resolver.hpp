@@ -0,0 +1,91 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "hocon-io.hpp"
+#ifdef HOCON_CURL
+#include "hocon-http.hpp"
+#endif
+
+enum IncludeType {
+    URL, FILEPATH, HEURISTIC
+};
+
+/*
+    Finds the text of the includes it accepts. readAll starts every read at once and returns without waiting for any,
+    like a FileReader, and must be safe to call from several threads. A link no resolver accepts is an include that
+    could not be opened.
+*/
+class IncludeResolver {
+    public:
+        virtual ~IncludeResolver() = default;
+        virtual bool accepts(std::string const& link, IncludeType type) const = 0;
+        virtual std::vector<std::shared_ptr<FileRead>> readAll(std::vector<std::string> const& links) = 0;
+        // true if reads carry the stamp of a file on disk: their parses may then be kept in the include cache, and
+        // reloads watch them.
+        virtual bool stamped() const;
+        std::shared_ptr<FileRead> read(std::string const& link);
+};
+
+/*
+    file() includes, read from disk through reader, or FileReader::shared() if it is null. The shared reader is only
+    started by the first read.
+*/
+class FileResolver : public IncludeResolver {
+    private:
+        std::shared_ptr<FileReader> reader;
+    public:
+        FileResolver(std::shared_ptr<FileReader> reader = nullptr);
+        bool accepts(std::string const& link, IncludeType type) const override;
+        std::vector<std::shared_ptr<FileRead>> readAll(std::vector<std::string> const& links) override;
+        bool stamped() const override;
+};
+
+#ifdef HOCON_CURL
+/*
+    url() includes, fetched through fetcher, or HttpFetcher::shared() if it is null. curl is only initialized by the
+    first fetch, so loads without url includes never pay for it.
+*/
+class UrlResolver : public IncludeResolver {
+    private:
+        std::shared_ptr<HttpFetcher> fetcher;
+    public:
+        UrlResolver(std::shared_ptr<HttpFetcher> fetcher = nullptr);
+        bool accepts(std::string const& link, IncludeType type) const override;
+        std::vector<std::shared_ptr<FileRead>> readAll(std::vector<std::string> const& links) override;
+};
+#endif
+
+/*
+    Includes served from memory by name, with no I/O, e.g. a bundle of configuration compiled into the binary. It
+    accepts any include whose link is one of its names, whatever its type, so it also serves heuristic includes
+    (include "name"), which no other resolver accepts. Sources must all be added before the first load using it.
+*/
+class MemoryResolver : public IncludeResolver {
+    private:
+        std::unordered_map<std::string, std::string> sources;
+    public:
+        MemoryResolver() = default;
+        MemoryResolver(std::unordered_map<std::string, std::string> sources);
+        void add(std::string const& name, std::string const& content);
+        bool accepts(std::string const& link, IncludeType type) const override;
+        std::vector<std::shared_ptr<FileRead>> readAll(std::vector<std::string> const& links) override;
+};
+
+/*
+    Resolvers tried in order: an include is read by the first one that accepts it. A chain is not changed once a load
+    uses it.
+*/
+class ResolverChain {
+    private:
+        std::vector<std::shared_ptr<IncludeResolver>> resolvers;
+    public:
+        ResolverChain() = default;
+        ResolverChain(std::vector<std::shared_ptr<IncludeResolver>> resolvers);
+        void add(std::shared_ptr<IncludeResolver> resolver); // tried after those added before it.
+        IncludeResolver * find(std::string const& link, IncludeType type) const; // nullptr if none accepts the link.
+        // file includes read in place (InlineFileReader), then, when built with curl, url includes through
+        // HttpFetcher::shared(). used by parsers that were not given a chain.
+        static ResolverChain const& defaults();
+};
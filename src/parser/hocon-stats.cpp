@@ -0,0 +1,143 @@
+#include "hocon-stats.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <sstream>
+
+thread_local LoadStats * activeStats = nullptr;
+
+const char * phaseName(StatsPhase phase) {
+    static const char * names[PHASE_COUNT] = {"lex", "parse", "include_fetch", "include_parse", "resolve", "index"};
+    return names[phase];
+}
+
+const char * counterName(StatsCounter counter) {
+    static const char * names[COUNTER_COUNT] = {"tokens", "nodes", "deep_copies", "stack_entries", "path_steps", "substitutions"};
+    return names[counter];
+}
+
+void LoadStats::reset() {
+    *this = LoadStats();
+}
+
+/*
+    Adds the phases, counters and events of other, collected on another thread for part of the same load. A phase that
+    is open here is skipped, as it would be if other's phases had been timed here, nested in it.
+*/
+void LoadStats::merge(LoadStats const& other) {
+    for (int p = 0; p < PHASE_COUNT; p++) {
+        if (openPhases[p] == 0) {
+            phaseNs[p] += other.phaseNs[p];
+        }
+    }
+    for (int c = 0; c < COUNTER_COUNT; c++) {
+        counters[c] += other.counters[c];
+    }
+    events.insert(events.end(), other.events.begin(), other.events.end());
+}
+
+/*
+    One "name: value" line per phase (in milliseconds) and per counter.
+*/
+std::string LoadStats::str() const {
+    std::ostringstream out;
+    char buffer[64];
+    for (int p = 0; p < PHASE_COUNT; p++) {
+        std::snprintf(buffer, sizeof(buffer), "%.3f", phaseNs[p] / 1e6);
+        out << phaseName((StatsPhase) p) << "_ms: " << buffer << "\n";
+    }
+    for (int c = 0; c < COUNTER_COUNT; c++) {
+        out << counterName((StatsCounter) c) << ": " << counters[c] << "\n";
+    }
+    return out.str();
+}
+
+MemoryUsage LoadStats::peakMemory() const {
+    MemoryUsage peak;
+    for (int p = 0; p < PHASE_COUNT; p++) {
+        if (phaseMemory[p].total() > peak.total()) {
+            peak = phaseMemory[p];
+        }
+    }
+    return peak;
+}
+
+static void writeJsonString(std::ostream& out, std::string const& str) {
+    out << '"';
+    for (char c : str) {
+        if (c == '"' || c == '\\') {
+            out << '\\' << c;
+        } else if ((unsigned char) c < 0x20) {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", (unsigned char) c);
+            out << escaped;
+        } else {
+            out << c;
+        }
+    }
+    out << '"';
+}
+
+static std::string microseconds(uint64_t ns) {
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%.3f", ns / 1e3);
+    return buffer;
+}
+
+/*
+    Writes every phase as a complete ("X") event and the counters as a single counter ("C") event at the end of the load.
+    Timestamps are in microseconds from the start of the load.
+*/
+void LoadStats::writeTrace(std::ostream& out) const {
+    out << "{\"traceEvents\":[";
+    uint64_t end = 0;
+    for (auto const& event : events) {
+        out << "{\"name\":\"" << phaseName(event.phase) << "\",\"cat\":\"hocon\",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.thread
+            << ",\"ts\":" << microseconds(event.startNs) << ",\"dur\":" << microseconds(event.durationNs);
+        if (!event.detail.empty()) {
+            out << ",\"args\":{\"detail\":";
+            writeJsonString(out, event.detail);
+            out << "}";
+        }
+        out << "},";
+        end = std::max(end, event.startNs + event.durationNs);
+    }
+    out << "{\"name\":\"counters\",\"cat\":\"hocon\",\"ph\":\"C\",\"pid\":1,\"tid\":1,\"ts\":" << microseconds(end) << ",\"args\":{";
+    for (int c = 0; c < COUNTER_COUNT; c++) {
+        out << (c ? "," : "") << "\"" << counterName((StatsCounter) c) << "\":" << counters[c];
+    }
+    out << "}}]}";
+}
+
+StatsScope::StatsScope(LoadStats * stats) : previous(activeStats) {
+    activeStats = stats;
+}
+
+StatsScope::~StatsScope() {
+    activeStats = previous;
+}
+
+PhaseTimer::PhaseTimer(StatsPhase phase) : stats(activeStats), phase(phase) {
+    if (stats) {
+        stats->openPhases[phase]++;
+        start = std::chrono::steady_clock::now();
+    }
+}
+
+PhaseTimer::PhaseTimer(StatsPhase phase, std::string const& detail) : PhaseTimer(phase) {
+    if (stats) {
+        this->detail = detail;
+    }
+}
+
+PhaseTimer::~PhaseTimer() {
+    if (!stats) {
+        return;
+    }
+    auto end = std::chrono::steady_clock::now();
+    uint64_t duration = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+    if (--stats->openPhases[phase] == 0) {
+        stats->phaseNs[phase] += duration;
+    }
+    uint64_t offset = std::chrono::duration_cast<std::chrono::nanoseconds>(start - stats->started).count();
+    stats->events.push_back(TraceEvent{phase, std::move(detail), offset, duration, stats->thread});
+}
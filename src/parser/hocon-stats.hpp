@@ -0,0 +1,97 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "hocon-memory.hpp"
+
+/*
+    Load instrumentation. While a LoadStats is active on a thread (StatsScope), the loader times each phase with a
+    PhaseTimer and bumps counters with countStat. With no active LoadStats both reduce to a thread local load and a
+    branch, so loads that did not ask for statistics pay next to nothing.
+
+    Phases nest: an include is fetched, lexed and parsed inside the parse of the file that includes it, so the totals
+    overlap (parse includes every include, lex includes the lexing of included files). A phase nested in itself, like
+    an include inside an include, is only counted once. Includes parsed ahead on other threads collect into stats of
+    their own, merged into the load's when they are spliced, so with parallel includes the phase totals can add up to
+    more than the time the load took.
+*/
+enum StatsPhase {
+    PHASE_LEX, PHASE_PARSE, PHASE_INCLUDE_FETCH, PHASE_INCLUDE_PARSE, PHASE_RESOLVE, PHASE_INDEX, PHASE_COUNT
+};
+
+enum StatsCounter {
+    COUNT_TOKENS,           // tokens lexed, included files too.
+    COUNT_NODES,            // HTree, HArray, HSimpleValue and HSubstitution nodes created, copies included.
+    COUNT_DEEP_COPIES,      // nodes created by deepCopy, a subtree copy counts each of its nodes.
+    COUNT_STACK_ENTRIES,    // values pushed to HParser::stack.
+    COUNT_PATH_STEPS,       // stack entries compared while resolving substitution paths.
+    COUNT_SUBSTITUTIONS,    // calls to resolveSub, nested substitutions included.
+    COUNTER_COUNT
+};
+
+const char * phaseName(StatsPhase phase);
+const char * counterName(StatsCounter counter);
+
+struct TraceEvent {
+    StatsPhase phase;
+    std::string detail;     // the include link, for include phases.
+    uint64_t startNs;       // since the start of the load.
+    uint64_t durationNs;
+    int thread = 1;         // trace thread id, LoadStats::thread of the stats the phase was timed into.
+};
+
+struct LoadStats {
+    uint64_t phaseNs[PHASE_COUNT] = {};
+    uint64_t counters[COUNTER_COUNT] = {};
+    std::vector<TraceEvent> events; // one per timed phase, in the order they finished or were merged.
+    MemoryUsage phaseMemory[PHASE_COUNT]; // held at the end of the lex, parse, resolve and index phases of the loaded file.
+    std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+    int openPhases[PHASE_COUNT] = {};
+    int thread = 1;
+
+    void reset();
+    void merge(LoadStats const& other);
+    std::string str() const;
+    void writeTrace(std::ostream& out) const; // Chrome trace event format, for chrome://tracing or Perfetto.
+    MemoryUsage peakMemory() const; // the largest phaseMemory snapshot.
+};
+
+extern thread_local LoadStats * activeStats;
+
+inline void countStat(StatsCounter counter, uint64_t amount = 1) {
+    if (activeStats) {
+        activeStats->counters[counter] += amount;
+    }
+}
+
+/*
+    Makes stats the active LoadStats of the calling thread until the scope ends. nullptr disables collection.
+*/
+class StatsScope {
+    private:
+        LoadStats * previous;
+    public:
+        StatsScope(LoadStats * stats);
+        ~StatsScope();
+        StatsScope(StatsScope const&) = delete;
+        StatsScope& operator=(StatsScope const&) = delete;
+};
+
+/*
+    Times a phase from construction to destruction into the active LoadStats, if there is one.
+*/
+class PhaseTimer {
+    private:
+        LoadStats * stats;
+        StatsPhase phase;
+        std::string detail;
+        std::chrono::steady_clock::time_point start;
+    public:
+        PhaseTimer(StatsPhase phase);
+        PhaseTimer(StatsPhase phase, std::string const& detail);
+        ~PhaseTimer();
+        PhaseTimer(PhaseTimer const&) = delete;
+        PhaseTimer& operator=(PhaseTimer const&) = delete;
+};
@@ -0,0 +1,376 @@
+#include "hocon-stream.hpp"
+#include "hocon-p.hpp"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+HEventParser::HEventParser(HEventHandler& handler, SubstitutionPolicy policy) : handler(handler), policy(policy), maxDepth(DEFAULT_MAX_DEPTH) {}
+
+void HEventParser::setMaxDepth(int depth) {
+    maxDepth = depth;
+}
+
+bool HEventParser::parseString(std::string const& text) {
+    valid = true;
+    depth = 0;
+    return parseSource(text.data(), text.size(), false);
+}
+
+bool HEventParser::parseFile(std::string const& filename) {
+    valid = true;
+    depth = 0;
+    return streamFile(filename, false, true);
+}
+
+// look ahead helpers. once an error was reported every lookup sees the end of the file, which unwinds the parse.
+
+Token const& HEventParser::peek() {
+    if (lookahead.empty()) {
+        lookahead.push_back(valid ? lexer->next() : Token(ENDFILE, "EOF", "", 0));
+        if (lexer->hasError) {
+            fail(lookahead.front().line, "invalid token " + lookahead.front().lexeme);
+        }
+    }
+    return lookahead.front();
+}
+
+Token HEventParser::advance() {
+    Token out = peek();
+    lookahead.pop_front();
+    return out;
+}
+
+bool HEventParser::check(TokenType type) {
+    return peek().type == type;
+}
+
+bool HEventParser::check(std::vector<TokenType> const& types) {
+    for (auto type : types) {
+        if (check(type)) return true;
+    }
+    return false;
+}
+
+bool HEventParser::match(TokenType type) {
+    if (check(type)) {
+        advance();
+        return true;
+    }
+    return false;
+}
+
+void HEventParser::ignoreAllWhitespace() {
+    while (check(WHITESPACE) || check(NEWLINE)) {
+        advance();
+    }
+}
+
+void HEventParser::ignoreInlineWhitespace() {
+    while (check(WHITESPACE)) {
+        advance();
+    }
+}
+
+/*
+    Reports the first error only and stops the parse.
+    @returns false, so callers can return fail(...) directly.
+*/
+bool HEventParser::fail(int line, std::string const& message) {
+    if (valid) {
+        valid = false;
+        handler.onError(line, message);
+    }
+    lookahead.clear();
+    lookahead.push_back(Token(ENDFILE, "EOF", "", line));
+    return false;
+}
+
+/*
+    Streams one source. An included source continues the members of the object it appears in, so it does not open an
+    object of its own. The lexer and look ahead of the including source are restored afterwards.
+*/
+bool HEventParser::parseSource(const char * data, size_t size, bool included) {
+    Lexer source(data, size);
+    Lexer * outer = lexer;
+    std::deque<Token> outerLookahead;
+    outerLookahead.swap(lookahead);
+    lexer = &source;
+
+    ignoreAllWhitespace();
+    bool ok;
+    if (included) {
+        ok = parseNested(match(LEFT_BRACE) ? RIGHT_BRACE : ENDFILE);
+    } else {
+        ok = parseDocument();
+    }
+    if (ok) {
+        ignoreAllWhitespace();
+        if (!check(ENDFILE)) {
+            ok = fail(peek().line, "Expected EOF, got " + peek().lexeme);
+        }
+    }
+
+    lexer = outer;
+    lookahead.swap(outerLookahead);
+    return ok && valid;
+}
+
+/*
+    Maps filename and streams it, so the file is paged in as the lexer reaches it instead of being read into memory.
+*/
+bool HEventParser::streamFile(std::string const& filename, bool included, bool required) {
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return required ? fail(0, "File " + filename + " failed to open") : true;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        close(fd);
+        return fail(0, "File " + filename + " failed to open");
+    }
+    if (info.st_size == 0) {
+        close(fd);
+        return parseSource("", 0, included);
+    }
+    void * mapped = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        return fail(0, "File " + filename + " could not be mapped");
+    }
+    madvise(mapped, info.st_size, MADV_SEQUENTIAL);
+    bool ok = parseSource(static_cast<const char*>(mapped), info.st_size, included);
+    munmap(mapped, info.st_size);
+    return ok;
+}
+
+bool HEventParser::parseDocument() {
+    if (match(LEFT_BRACKET)) {
+        handler.onArrayStart();
+        if (!parseNested(RIGHT_BRACKET)) return false;
+    } else {
+        handler.onObjectStart();
+        if (!parseNested(match(LEFT_BRACE) ? RIGHT_BRACE : ENDFILE)) return false;
+    }
+    handler.onEnd();
+    return true;
+}
+
+/*
+    An object or array that was reported as started and not yet as ended.
+*/
+struct EventLevel {
+    TokenType close;        // RIGHT_BRACE, RIGHT_BRACKET, or ENDFILE for a braceless root.
+    size_t keyObjects = 0;  // objects opened by the dotted key of the member being streamed, ended after its value.
+};
+
+/*
+    Streams the members of an object, or the elements of an array, up to and including close. The objects and arrays
+    opened on the way are kept on a stack of their own rather than the call stack, so only maxDepth limits how deeply
+    they may nest. Adjacent objects or arrays ({a = 1} {b = 2}) are reported as one.
+*/
+bool HEventParser::parseNested(TokenType close) {
+    std::vector<EventLevel> open{EventLevel{close}};
+    while (true) {
+        bool array = open.back().close == RIGHT_BRACKET;
+        ignoreAllWhitespace();
+        if (match(open.back().close)) {
+            if (open.size() == 1) {
+                return true;
+            }
+            ignoreInlineWhitespace();
+            if (match(array ? LEFT_BRACKET : LEFT_BRACE)) {
+                continue;
+            }
+            open.pop_back();
+            depth--;
+            handler.onEnd();
+            if ((check(SUB) || check(SUB_OPTIONAL)) && !parseScalar()) {
+                return false;
+            }
+        } else if (check(ENDFILE)) {
+            return fail(peek().line, array ? "Imbalanced []" : "Imbalanced {}");
+        } else if (!array && check(UNQUOTED_STRING) && peek().lexeme == "include") {
+            if (!parseInclude()) return false;
+        } else {
+            if (!array && !parseKey(open.back().keyObjects)) {
+                return false;
+            }
+            if ((check(LEFT_BRACE) || check(LEFT_BRACKET)) && depth == maxDepth) {
+                return fail(peek().line, "objects and arrays are nested deeper than " + std::to_string(maxDepth) + " levels");
+            }
+            if (check(LEFT_BRACE) || check(LEFT_BRACKET)) {
+                bool object = advance().type == LEFT_BRACE;
+                if (object) {
+                    handler.onObjectStart();
+                } else {
+                    handler.onArrayStart();
+                }
+                depth++;
+                open.push_back(EventLevel{object ? RIGHT_BRACE : RIGHT_BRACKET});
+                continue;
+            }
+            if (!parseScalar()) {
+                return false;
+            }
+        }
+
+        // a member or element ended.
+        EventLevel& level = open.back();
+        for (; level.keyObjects > 0; level.keyObjects--) {
+            handler.onEnd();
+        }
+        ignoreInlineWhitespace();
+        if (check(level.close)) {
+            continue;
+        }
+        if (!check(COMMA) && !check(NEWLINE)) {
+            if (level.close == RIGHT_BRACKET) {
+                return fail(peek().line, "Expected comma or newline, got " + peek().lexeme + " after array element");
+            }
+            return fail(peek().line, "Unexpected symbol " + peek().lexeme + " after member");
+        }
+        ignoreAllWhitespace();
+        match(COMMA);
+    }
+}
+
+/*
+    Streams the key of a member and its separator: key = value, key : value or key { ... }. The key is split like
+    HParser::hoconKey, with every segment but the last opening an object; keyObjects is set to their number, for the
+    caller to end them after the value.
+*/
+bool HEventParser::parseKey(size_t& keyObjects) {
+    int line = peek().line;
+    std::vector<Token> keyTokens;
+    while (check(SIMPLE_VALUES) || check(WHITESPACE)) {
+        keyTokens.push_back(advance());
+    }
+    while (!keyTokens.empty() && keyTokens.back().type == WHITESPACE) {
+        keyTokens.pop_back();
+    }
+    if (keyTokens.empty()) {
+        return fail(line, "Expected a key, got " + peek().lexeme);
+    }
+    std::vector<std::string> path = HParser::splitPath(keyTokens);
+    for (auto const& key : path) {
+        if (key.empty()) {
+            return fail(line, "cannot use the empty string \"\" as a key or a path");
+        }
+    }
+    ignoreAllWhitespace();
+    for (size_t i = 0; i + 1 < path.size(); i++) {
+        handler.onKey(path[i]);
+        handler.onObjectStart();
+    }
+    handler.onKey(path.back());
+    keyObjects = path.size() - 1;
+    if (check(LEFT_BRACE)) { // implied separator case. ex: foo {}
+        return true;
+    } else if (match(EQUAL) || match(COLON)) {
+        ignoreAllWhitespace();
+        return true;
+    } else if (check(PLUS_EQUAL)) {
+        return fail(line, "+= needs the previous value of '" + path.back() + "' and cannot be streamed");
+    }
+    return fail(peek().line, "Expected '=' or ':', got " + peek().lexeme + ", after the key '" + path.back() + "'");
+}
+
+/*
+    Streams a value that is not an object or array, or the substitution following one. A simple value made of several
+    tokens is reported as the concatenated string, like HParser::hoconSimpleValue. A value containing a substitution
+    is handled according to the substitution policy.
+*/
+bool HEventParser::parseScalar() {
+    int line = peek().line;
+    std::vector<Token> parts;
+    bool substitution = false;
+    while (check(SIMPLE_VALUES) || check(WHITESPACE) || check(SUB) || check(SUB_OPTIONAL)) {
+        substitution = substitution || check(SUB) || check(SUB_OPTIONAL);
+        parts.push_back(advance());
+    }
+    while (!parts.empty() && parts.back().type == WHITESPACE) {
+        parts.pop_back();
+    }
+    if (parts.empty()) {
+        return fail(line, "Expected a value, got " + peek().lexeme);
+    }
+    std::string text;
+    for (auto const& part : parts) {
+        text += part.lexeme;
+    }
+    if (substitution) {
+        if (policy == SUBSTITUTIONS_REJECT) {
+            return fail(line, "substitutions cannot be streamed, got " + text);
+        }
+        if (check(LEFT_BRACE) || check(LEFT_BRACKET)) {
+            return fail(line, "a substitution followed by an object or array cannot be streamed");
+        }
+        handler.onSubstitution(text);
+    } else if (parts.size() > 1) {
+        handler.onScalar(text);
+    } else if (parts[0].type == NULLVALUE) {
+        handler.onNull();
+    } else {
+        handler.onScalar(parts[0].literal);
+    }
+    return true;
+}
+
+/*
+    Streams a file() include in place, like HParser::parseInclude splices the included tree. Heuristic includes
+    (include "name") are skipped like in HParser, and url() includes are rejected.
+*/
+bool HEventParser::parseInclude() {
+    int line = advance().line;
+    ignoreInlineWhitespace();
+    bool required = false;
+    IncludeType type = HEURISTIC;
+    std::string link;
+    if (check(QUOTED_STRING)) {
+        link = std::get<std::string>(advance().literal);
+    } else if (check(UNQUOTED_STRING)) {
+        if (peek().lexeme == "required") {
+            required = true;
+            advance();
+            if (!match(LEFT_PAREN)) {
+                return fail(peek().line, "expected '(', got " + peek().lexeme);
+            }
+            ignoreInlineWhitespace();
+        }
+        if (peek().lexeme == "url") {
+            type = URL;
+        } else if (peek().lexeme == "file") {
+            type = FILEPATH;
+        } else {
+            return fail(peek().line, "expected url or file, got " + peek().lexeme);
+        }
+        advance();
+        if (!match(LEFT_PAREN)) {
+            return fail(peek().line, "expected '(', got " + peek().lexeme);
+        }
+        ignoreInlineWhitespace();
+        if (!check(QUOTED_STRING)) {
+            return fail(peek().line, "expected a quoted string, got " + peek().lexeme);
+        }
+        link = std::get<std::string>(advance().literal);
+        if (!match(RIGHT_PAREN) || (required && !match(RIGHT_PAREN))) {
+            return fail(peek().line, "unterminated ()");
+        }
+    } else {
+        return fail(peek().line, "expected a quoted string, or one of \"required\", \"url\", or \"file\", got " + peek().lexeme);
+    }
+    if (type == URL) {
+        return fail(line, "url includes cannot be streamed");
+    }
+    if (type == HEURISTIC) {
+        return true;
+    }
+    if (includes == MAX_INCLUDE_NESTING) {
+        return fail(line, "includes are nested more than " + std::to_string(MAX_INCLUDE_NESTING) + " levels deep, " + link + " is probably part of an include cycle");
+    }
+    includes++;
+    bool ok = streamFile(link, true, required);
+    includes--;
+    return ok;
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include <lexer.hpp>
+#include <token.hpp>
+#include <deque>
+#include <string>
+#include <variant>
+#include <vector>
+
+/*
+    How the event parser treats substitutions, which cannot be resolved without keeping the document.
+    REPORT passes the value as written to onSubstitution, REJECT stops the parse with an error.
+*/
+enum SubstitutionPolicy {
+    SUBSTITUTIONS_REPORT, SUBSTITUTIONS_REJECT
+};
+
+/*
+    Receives the events of a streamed parse. Every method has an empty default, so a handler only overrides the events
+    it needs. A dotted key (a.b = 1) is reported as nested objects, and nothing is merged: a key defined twice is
+    reported twice, in document order, and adjacent objects or arrays ({a = 1} {b = 2}) are reported as one.
+*/
+class HEventHandler {
+    public:
+        virtual ~HEventHandler() = default;
+        virtual void onObjectStart() {}
+        virtual void onArrayStart() {}
+        virtual void onEnd() {} // closes the innermost open object or array.
+        virtual void onKey(std::string const&) {}
+        virtual void onScalar(std::variant<int, double, bool, std::string> const&) {}
+        virtual void onNull() {}
+        virtual void onSubstitution(std::string const&) {} // the value as written, ex: "${a.b} suffix".
+        virtual void onError(int, std::string const&) {} // the line and message of the error that stopped the parse.
+};
+
+/*
+    Push parser that reports a document to an HEventHandler instead of building HTree/HArray nodes. Tokens are pulled
+    from the lexer one at a time and nothing is kept once reported, so besides the source text (mapped, not read, for
+    files) memory use is bounded by the nesting depth of the document.
+
+    Parsing stops at the first error, which is reported through onError. += is rejected since it needs the previous
+    value, url() includes are rejected, and file() includes are streamed in place.
+*/
+class HEventParser {
+    private:
+        HEventHandler& handler;
+        SubstitutionPolicy policy;
+        Lexer * lexer = nullptr;
+        std::deque<Token> lookahead;
+        bool valid = true;
+        int maxDepth;
+        int depth = 0; // objects and arrays currently open. parsing stops with an error past maxDepth.
+        int includes = 0; // files being streamed in place of an include.
+
+        Token const& peek();
+        Token advance();
+        bool check(TokenType type);
+        bool check(std::vector<TokenType> const& types);
+        bool match(TokenType type);
+        void ignoreAllWhitespace();
+        void ignoreInlineWhitespace();
+        bool fail(int line, std::string const& message);
+
+        bool parseDocument();
+        bool parseNested(TokenType close);
+        bool parseKey(size_t& keyObjects);
+        bool parseScalar();
+        bool parseInclude();
+        bool parseSource(const char * data, size_t size, bool included);
+        bool streamFile(std::string const& filename, bool included, bool required);
+    public:
+        HEventParser(HEventHandler& handler, SubstitutionPolicy policy);
+        void setMaxDepth(int depth); // DEFAULT_MAX_DEPTH unless set.
+        bool parseString(std::string const& text);
+        bool parseFile(std::string const& filename);
+};
@@ -0,0 +1,283 @@
+#include "hocon-writer.hpp"
+#include <charconv>
+#include <cmath>
+#include <stdexcept>
+
+const size_t WRITER_FLUSH_SIZE = 1 << 16;
+const std::string_view WRITER_INDENT = "    "; // same as INDENT in hocon-p.cpp, so RENDER_HOCON matches str().
+
+// characters that need an escape in a JSON string.
+static const struct EscapeTable {
+    bool escape[256] = {};
+    constexpr EscapeTable() {
+        for (int c = 0; c < 0x20; c++) escape[c] = true;
+        escape[static_cast<unsigned char>('"')] = true;
+        escape[static_cast<unsigned char>('\\')] = true;
+    }
+} JSON_ESCAPES;
+
+HWriter::HWriter(std::ostream& out, RenderFormat format) : buffer(ownBuffer), out(&out), format(format) {
+    ownBuffer.reserve(WRITER_FLUSH_SIZE + 1024);
+}
+
+HWriter::HWriter(std::string& out, RenderFormat format) : buffer(out), format(format) {}
+
+HWriter::~HWriter() {
+    flush();
+}
+
+void HWriter::write(HTree const * tree) {
+    writeValue(const_cast<HTree*>(tree), 0);
+    flush();
+}
+
+void HWriter::write(HArray const * arr) {
+    writeValue(const_cast<HArray*>(arr), 0);
+    flush();
+}
+
+void HWriter::write(std::variant<HTree*, HArray*, HSimpleValue*, HSubstitution*> const& value) {
+    writeValue(value, 0);
+    flush();
+}
+
+void HWriter::flush() {
+    if (out && !buffer.empty()) {
+        out->write(buffer.data(), buffer.size());
+        buffer.clear();
+    }
+}
+
+void HWriter::flushIfFull() {
+    if (out && buffer.size() >= WRITER_FLUSH_SIZE) {
+        flush();
+    }
+}
+
+void HWriter::put(std::string_view text) {
+    buffer.append(text);
+    flushIfFull();
+}
+
+void HWriter::put(char c) {
+    buffer.push_back(c);
+}
+
+/*
+    Starts a line indented level times. Compact JSON has neither.
+*/
+void HWriter::newline(size_t level) {
+    if (format == RENDER_JSON_COMPACT) {
+        return;
+    }
+    size_t width = level * WRITER_INDENT.size();
+    while (indents.size() < width) {
+        indents.append(WRITER_INDENT);
+    }
+    put('\n');
+    put(std::string_view(indents).substr(0, width));
+}
+
+static bool isEmptyContainer(std::variant<HTree*, HArray*, HSimpleValue*, HSubstitution*> const& value) {
+    return (std::holds_alternative<HTree*>(value) && std::get<HTree*>(value)->members.empty()) ||
+        (std::holds_alternative<HArray*>(value) && std::get<HArray*>(value)->elements.empty());
+}
+
+/*
+    Writes value and everything below it. The objects and arrays being written are kept on an explicit stack instead of
+    recursing, so the depth of the tree is not limited by the call stack. Separators are written before a member rather
+    than after it: in RENDER_HOCON a comma follows every member but the last, except after an empty object or array, as
+    in str().
+*/
+void HWriter::writeValue(std::variant<HTree*, HArray*, HSimpleValue*, HSubstitution*> const& value, size_t level) {
+    std::vector<OpenContainer> open;
+    start(value, level, open);
+    while (!open.empty()) {
+        OpenContainer& top = open.back();
+        size_t i = top.next++;
+        size_t memberLevel = top.level + 1;
+        if (top.tree) {
+            HTree const * tree = top.tree;
+            if (i == tree->memberOrder.size()) {
+                newline(top.level);
+                put('}');
+                open.pop_back();
+                continue;
+            }
+            std::string const& key = tree->memberOrder[i];
+            auto const& member = tree->members.at(key);
+            if (format == RENDER_HOCON) {
+                if (i > 0 && !isEmptyContainer(tree->members.at(tree->memberOrder[i - 1]))) {
+                    put(',');
+                }
+                newline(memberLevel);
+                put(key);
+                put(" : ");
+                start(member, memberLevel, open);
+                continue;
+            }
+            if (std::holds_alternative<HSubstitution*>(member)) {
+                HSubstitution const * sub = std::get<HSubstitution*>(member);
+                if (sub->resolved && std::holds_alternative<HTree*>(sub->resolvedValue) && !std::get<HTree*>(sub->resolvedValue)) {
+                    continue; // an optional substitution that resolved to nothing leaves no member.
+                }
+            }
+            if (top.written++ > 0) {
+                put(',');
+            }
+            newline(memberLevel);
+            writeJsonString(key);
+            put(format == RENDER_JSON ? std::string_view(": ") : std::string_view(":"));
+            start(member, memberLevel, open);
+        } else {
+            HArray const * arr = top.arr;
+            if (i == arr->elements.size()) {
+                newline(top.level);
+                put(']');
+                open.pop_back();
+                continue;
+            }
+            if (i > 0 && (format != RENDER_HOCON || !isEmptyContainer(arr->elements[i - 1]))) {
+                put(',');
+            }
+            newline(memberLevel);
+            start(arr->elements[i], memberLevel, open);
+        }
+    }
+}
+
+/*
+    Writes a scalar or substitution completely, and only the opening bracket of a non-empty object or array, which is
+    pushed on open for writeValue to continue with.
+*/
+void HWriter::start(std::variant<HTree*, HArray*, HSimpleValue*, HSubstitution*> const& value, size_t level, std::vector<OpenContainer>& open) {
+    switch (value.index()) {
+        case 0: {
+            HTree const * tree = std::get<HTree*>(value);
+            if (tree->members.empty()) {
+                put("{}");
+            } else {
+                put('{');
+                open.push_back(OpenContainer{tree, nullptr, level});
+            }
+            break;
+        }
+        case 1: {
+            HArray const * arr = std::get<HArray*>(value);
+            if (arr->elements.empty()) {
+                put("[]");
+            } else {
+                put(format == RENDER_HOCON ? std::string_view("[ ") : std::string_view("["));
+                open.push_back(OpenContainer{nullptr, arr, level});
+            }
+            break;
+        }
+        case 2: writeSimpleValue(std::get<HSimpleValue*>(value), level); break;
+        case 3: writeSubstitution(std::get<HSubstitution*>(value), level, open); break;
+    }
+}
+
+/*
+    RENDER_HOCON writes values like HSimpleValue::str(). Like str(), the lines of a multi-line string are indented as far
+    as the members of its parent, which is one level less than the value itself. JSON writes the lexer's unquoted null
+    as null.
+*/
+void HWriter::writeSimpleValue(HSimpleValue const * value, size_t level) {
+    if (format == RENDER_HOCON) {
+        if (std::holds_alternative<std::string>(value->svalue)) {
+            std::string const& text = std::get<std::string>(value->svalue);
+            bool quoted = !text.empty() && text[0] == '"';
+            if (!quoted) put('"');
+            size_t start = 0;
+            size_t end;
+            while ((end = text.find('\n', start)) != std::string::npos) {
+                put(std::string_view(text).substr(start, end - start));
+                newline(level > 0 ? level - 1 : 0);
+                start = end + 1;
+            }
+            put(std::string_view(text).substr(start));
+            if (!quoted) put('"');
+        } else {
+            for (size_t i = 0; i < value->defaultEnd; i++) {
+                put(value->tokenParts[i].lexeme);
+            }
+        }
+        return;
+    }
+    char number[32];
+    switch (value->svalue.index()) {
+        case 0: {
+            auto result = std::to_chars(number, number + sizeof(number), std::get<int>(value->svalue));
+            put(std::string_view(number, result.ptr - number));
+            break;
+        }
+        case 1: {
+            double d = std::get<double>(value->svalue);
+            if (!std::isfinite(d)) {
+                put("null");
+                break;
+            }
+            auto result = std::to_chars(number, number + sizeof(number), d);
+            put(std::string_view(number, result.ptr - number));
+            break;
+        }
+        case 2:
+            put(std::get<bool>(value->svalue) ? std::string_view("true") : std::string_view("false"));
+            break;
+        case 3:
+            if (value->defaultEnd == 1 && value->tokenParts[0].type == UNQUOTED_STRING && value->tokenParts[0].lexeme == "null") {
+                put("null");
+            } else {
+                writeJsonString(std::get<std::string>(value->svalue));
+            }
+            break;
+    }
+}
+
+void HWriter::writeSubstitution(HSubstitution const * sub, size_t level, std::vector<OpenContainer>& open) {
+    if (format == RENDER_HOCON) {
+        put(sub->str());
+        return;
+    }
+    if (!sub->resolved) {
+        throw std::runtime_error("Error: the substitution at path " + pathToString(sub->getPath()) + " is not resolved and cannot be written as JSON");
+    }
+    if (std::holds_alternative<HTree*>(sub->resolvedValue) && !std::get<HTree*>(sub->resolvedValue)) {
+        put("null"); // only reached in arrays, objects leave the member out.
+        return;
+    }
+    std::visit([this, level, &open](auto * resolved) { start(resolved, level, open); }, sub->resolvedValue);
+}
+
+/*
+    Writes text as a quoted JSON string, copying the runs between characters that need an escape in one piece.
+*/
+void HWriter::writeJsonString(std::string_view text) {
+    static const char HEX[] = "0123456789abcdef";
+    put('"');
+    size_t start = 0;
+    for (size_t i = 0; i < text.size(); i++) {
+        unsigned char c = static_cast<unsigned char>(text[i]);
+        if (!JSON_ESCAPES.escape[c]) {
+            continue;
+        }
+        buffer.append(text.data() + start, i - start);
+        start = i + 1;
+        switch (c) {
+            case '"': buffer.append("\\\""); break;
+            case '\\': buffer.append("\\\\"); break;
+            case '\b': buffer.append("\\b"); break;
+            case '\f': buffer.append("\\f"); break;
+            case '\n': buffer.append("\\n"); break;
+            case '\r': buffer.append("\\r"); break;
+            case '\t': buffer.append("\\t"); break;
+            default:
+                buffer.append("\\u00");
+                buffer.push_back(HEX[c >> 4]);
+                buffer.push_back(HEX[c & 0xF]);
+        }
+    }
+    buffer.append(text.data() + start, text.size() - start);
+    put('"');
+    flushIfFull();
+}
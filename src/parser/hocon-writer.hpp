@@ -0,0 +1,60 @@
+#pragma once
+#include "hocon-p.hpp"
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <variant>
+#include <vector>
+
+/*
+    Output formats of HWriter. RENDER_HOCON is the layout of HTree::str() (without debug annotations), RENDER_JSON is
+    indented JSON and RENDER_JSON_COMPACT is JSON without any whitespace.
+*/
+enum RenderFormat {
+    RENDER_HOCON, RENDER_JSON, RENDER_JSON_COMPACT
+};
+
+/*
+    Renders a tree in a single pass, indenting by depth as it goes instead of re-splitting the rendered children like
+    str() used to. Output is collected in a buffer that is flushed to the stream every WRITER_FLUSH_SIZE bytes, or
+    appended directly to a string.
+
+    The JSON formats write lazily resolved substitutions as their value and throw std::runtime_error on a substitution
+    that is not resolved, since it has no JSON form. RENDER_HOCON writes substitutions like str().
+*/
+class HWriter {
+    private:
+        std::string ownBuffer;
+        std::string& buffer;
+        std::ostream * out = nullptr;
+        RenderFormat format;
+        std::string indents;
+
+        void put(std::string_view text);
+        void put(char c);
+        void newline(size_t level);
+        void flushIfFull();
+        struct OpenContainer {  // an object (tree set) or array being written by writeValue.
+            HTree const * tree;
+            HArray const * arr;
+            size_t level;
+            size_t next = 0;    // index of the next member or element.
+            size_t written = 0; // JSON members written so far, optional substitutions that resolved to nothing are left out.
+        };
+
+        void writeValue(std::variant<HTree*, HArray*, HSimpleValue*, HSubstitution*> const& value, size_t level);
+        void start(std::variant<HTree*, HArray*, HSimpleValue*, HSubstitution*> const& value, size_t level, std::vector<OpenContainer>& open);
+        void writeSimpleValue(HSimpleValue const * value, size_t level);
+        void writeSubstitution(HSubstitution const * sub, size_t level, std::vector<OpenContainer>& open);
+        void writeJsonString(std::string_view text);
+    public:
+        HWriter(std::ostream& out, RenderFormat format);
+        HWriter(std::string& out, RenderFormat format); // appends to out.
+        ~HWriter();
+        HWriter(HWriter const&) = delete;
+        HWriter& operator=(HWriter const&) = delete;
+        void write(HTree const * tree);
+        void write(HArray const * arr);
+        void write(std::variant<HTree*, HArray*, HSimpleValue*, HSubstitution*> const& value);
+        void flush();
+};
@@ -0,0 +1,258 @@
+#include "compiled.hpp"
+#include <algorithm>
+#include <deque>
+#include <fstream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+    Returns the offset of str in the string table, appending it if it has not been added yet.
+*/
+static uint32_t addString(std::string const& str, std::string& table, std::unordered_map<std::string, uint32_t>& offsets) {
+    auto found = offsets.find(str);
+    if (found != offsets.end()) {
+        return found->second;
+    }
+    uint32_t offset = table.size();
+    table += str;
+    offsets.insert(std::make_pair(str, offset));
+    return offset;
+}
+
+/*
+    Flattens a resolved tree into the compiled format and writes it to filename. Nodes are laid out breadth first so
+    the children of every object/array occupy a contiguous range of the node table.
+    @returns false if the tree still holds substitutions or the file could not be written.
+*/
+bool writeCompiledConfig(std::variant<HTree*, HArray*> root, std::string const& filename) {
+    std::vector<CompiledNode> nodes;
+    std::string strings;
+    std::unordered_map<std::string, uint32_t> offsets;
+    std::deque<std::pair<std::variant<HTree*, HArray*, HSimpleValue*, HSubstitution*>, uint32_t>> queue;
+
+    nodes.push_back(CompiledNode{});
+    if (std::holds_alternative<HTree*>(root)) {
+        queue.push_back(std::make_pair(std::get<HTree*>(root), 0));
+    } else {
+        queue.push_back(std::make_pair(std::get<HArray*>(root), 0));
+    }
+    while (!queue.empty()) {
+        auto [value, index] = queue.front();
+        queue.pop_front();
+        if (std::holds_alternative<HTree*>(value)) {
+            HTree * tree = std::get<HTree*>(value);
+            std::vector<std::string> keys = tree->memberOrder;
+            std::sort(keys.begin(), keys.end());
+            nodes[index].type = COMPILED_OBJECT;
+            nodes[index].first = nodes.size();
+            nodes[index].count = keys.size();
+            for (auto const& key : keys) {
+                CompiledNode child{};
+                child.keyOffset = addString(key, strings, offsets);
+                child.keyLength = key.size();
+                nodes.push_back(child);
+                queue.push_back(std::make_pair(tree->members.at(key), nodes.size() - 1));
+            }
+        } else if (std::holds_alternative<HArray*>(value)) {
+            HArray * arr = std::get<HArray*>(value);
+            nodes[index].type = COMPILED_ARRAY;
+            nodes[index].first = nodes.size();
+            nodes[index].count = arr->elements.size();
+            for (auto e : arr->elements) {
+                nodes.push_back(CompiledNode{});
+                queue.push_back(std::make_pair(e, nodes.size() - 1));
+            }
+        } else if (std::holds_alternative<HSimpleValue*>(value)) {
+            std::variant<int, double, bool, std::string> const& svalue = std::get<HSimpleValue*>(value)->svalue;
+            switch (svalue.index()) {
+                case 0:
+                    nodes[index].type = COMPILED_INT;
+                    nodes[index].intValue = std::get<int>(svalue);
+                    break;
+                case 1:
+                    nodes[index].type = COMPILED_DOUBLE;
+                    nodes[index].doubleValue = std::get<double>(svalue);
+                    break;
+                case 2:
+                    nodes[index].type = COMPILED_BOOL;
+                    nodes[index].intValue = std::get<bool>(svalue);
+                    break;
+                case 3:
+                    nodes[index].type = COMPILED_STRING;
+                    nodes[index].first = addString(std::get<std::string>(svalue), strings, offsets);
+                    nodes[index].count = std::get<std::string>(svalue).size();
+                    break;
+            }
+        } else {
+            return false; // only resolved configurations can be compiled.
+        }
+    }
+
+    CompiledHeader header{};
+    std::copy(COMPILED_MAGIC, COMPILED_MAGIC + 4, header.magic);
+    header.version = COMPILED_VERSION;
+    header.nodeCount = nodes.size();
+    header.nodesOffset = sizeof(CompiledHeader);
+    header.stringsOffset = header.nodesOffset + nodes.size() * sizeof(CompiledNode);
+    header.stringsSize = strings.size();
+
+    std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        return false;
+    }
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(nodes.data()), nodes.size() * sizeof(CompiledNode));
+    out.write(strings.data(), strings.size());
+    return out.good();
+}
+
+/*
+    Maps a compiled configuration file into memory. The header and, in one pass over the node table, every child
+    range and string offset are checked against the mapping, so a truncated or corrupt file is not valid rather than
+    read out of bounds by the lookups.
+*/
+CompiledConfig::CompiledConfig(std::string const& filename) {
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t) info.st_size < sizeof(CompiledHeader)) {
+        close(fd);
+        return;
+    }
+    void * mapped = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        return;
+    }
+    base = static_cast<const char*>(mapped);
+    size = info.st_size;
+
+    const CompiledHeader * header = reinterpret_cast<const CompiledHeader*>(base);
+    if (!std::equal(COMPILED_MAGIC, COMPILED_MAGIC + 4, header->magic) || header->version != COMPILED_VERSION || header->nodeCount == 0) {
+        return;
+    }
+    if ((size_t) header->nodesOffset + (size_t) header->nodeCount * sizeof(CompiledNode) > size ||
+        (size_t) header->stringsOffset + header->stringsSize > size) {
+        return;
+    }
+    if (header->nodesOffset % alignof(CompiledNode) != 0) {
+        return;
+    }
+    nodes = reinterpret_cast<const CompiledNode*>(base + header->nodesOffset);
+    strings = base + header->stringsOffset;
+    nodeCount = header->nodeCount;
+    valid = checkNodes(header->stringsSize);
+}
+
+/*
+    Checks that every key and string value lies in the string table, and that the children of every object and array
+    are nodes after it in the table, as writeCompiledConfig lays them out, so walking the tree always ends.
+*/
+bool CompiledConfig::checkNodes(uint32_t stringsSize) const {
+    for (uint32_t i = 0; i < nodeCount; i++) {
+        CompiledNode const& node = nodes[i];
+        if ((uint64_t) node.keyOffset + node.keyLength > stringsSize || node.type > COMPILED_STRING) {
+            return false;
+        }
+        if (node.type == COMPILED_STRING && (uint64_t) node.first + node.count > stringsSize) {
+            return false;
+        }
+        if ((node.type == COMPILED_OBJECT || node.type == COMPILED_ARRAY) && node.count > 0 &&
+            (node.first <= i || (uint64_t) node.first + node.count > nodeCount)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+CompiledConfig::~CompiledConfig() {
+    if (base) {
+        munmap(const_cast<char*>(base), size);
+    }
+}
+
+const CompiledNode * CompiledConfig::root() const {
+    return valid ? nodes : nullptr;
+}
+
+/*
+    Walks the path expression segment by segment, using the same splitting rules as HParser::splitPath but without
+    allocating the segments. The path is relative to from, or to the root if from is null.
+    @returns nullptr if the path does not exist.
+*/
+const CompiledNode * CompiledConfig::find(std::string_view path, const CompiledNode * from) const {
+    if (!valid || path.empty()) {
+        return nullptr;
+    }
+    std::string_view view = path;
+    const CompiledNode * curr = from ? from : root();
+    size_t start = 0;
+    size_t current = 0;
+    while (current < view.size()) {
+        if (view[current] == '.') {
+            curr = child(curr, view.substr(start, current - start));
+            if (!curr) return nullptr;
+            start = ++current;
+        } else if (view[current] == '"') {
+            current++;
+            while (current < view.size() && view[current] != '"') {
+                current++;
+            }
+            current++;
+        } else {
+            current++;
+        }
+    }
+    if (start < view.size()) {
+        curr = child(curr, view.substr(start));
+    }
+    return curr;
+}
+
+/*
+    Binary searches the sorted children of an object for key.
+*/
+const CompiledNode * CompiledConfig::child(const CompiledNode * node, std::string_view key) const {
+    if (!node || node->type != COMPILED_OBJECT) {
+        return nullptr;
+    }
+    const CompiledNode * begin = nodes + node->first;
+    const CompiledNode * end = begin + node->count;
+    const CompiledNode * found = std::lower_bound(begin, end, key, [this](CompiledNode const& n, std::string_view k) {
+        return this->key(&n) < k;
+    });
+    if (found != end && this->key(found) == key) {
+        return found;
+    }
+    return nullptr;
+}
+
+std::string_view CompiledConfig::key(const CompiledNode * node) const {
+    return std::string_view(strings + node->keyOffset, node->keyLength);
+}
+
+std::string_view CompiledConfig::stringValue(const CompiledNode * node) const {
+    return std::string_view(strings + node->first, node->count);
+}
+
+/*
+    String form of a scalar node, matching how ConfigFile renders HSimpleValue values.
+*/
+std::string CompiledConfig::valueAsString(const CompiledNode * node) const {
+    switch (node->type) {
+        case COMPILED_INT:
+            return std::to_string((int) node->intValue);
+        case COMPILED_DOUBLE:
+            return std::to_string(node->doubleValue);
+        case COMPILED_BOOL:
+            return node->intValue ? std::string("true") : std::string("false");
+        case COMPILED_STRING:
+            return std::string(stringValue(node));
+        default:
+            return "";
+    }
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <variant>
+#include <hocon-p.hpp>
+
+/*
+    Flat binary form of a fully resolved configuration. The file is position independent: every reference is an
+    offset from the start of the file, so it can be mmap'd and read in place.
+
+    layout:
+        CompiledHeader
+        CompiledNode[nodeCount]     node 0 is the root. children of an object/array are contiguous,
+                                    object children are sorted by key so lookups can binary search.
+        char[stringsSize]           string table holding keys and string values (not null terminated).
+*/
+
+const char COMPILED_MAGIC[4] = {'H', 'O', 'C', 'B'};
+const uint32_t COMPILED_VERSION = 1;
+
+enum CompiledType {
+    COMPILED_OBJECT, COMPILED_ARRAY, COMPILED_INT, COMPILED_DOUBLE, COMPILED_BOOL, COMPILED_STRING
+};
+
+struct CompiledHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t nodeCount;
+    uint32_t nodesOffset;
+    uint32_t stringsOffset;
+    uint32_t stringsSize;
+};
+
+struct CompiledNode {
+    uint32_t keyOffset;
+    uint32_t keyLength;
+    uint32_t type;
+    uint32_t first;         // object/array: index of the first child. string: offset of the value.
+    uint32_t count;         // object/array: number of children. string: length of the value.
+    uint32_t reserved;
+    int64_t intValue;       // int and bool values.
+    double doubleValue;
+};
+
+class CompiledConfig {
+    private:
+        const char * base = nullptr;
+        size_t size = 0;
+        const CompiledNode * nodes = nullptr;
+        const char * strings = nullptr;
+        uint32_t nodeCount = 0;
+        bool checkNodes(uint32_t stringsSize) const;
+    public:
+        bool valid = false;
+        CompiledConfig(std::string const& filename);
+        ~CompiledConfig();
+        CompiledConfig(CompiledConfig const&) = delete;
+        CompiledConfig& operator=(CompiledConfig const&) = delete;
+
+        const CompiledNode * root() const;
+        const CompiledNode * find(std::string_view path, const CompiledNode * from = nullptr) const;
+        const CompiledNode * child(const CompiledNode * node, std::string_view key) const;
+        std::string_view key(const CompiledNode * node) const;
+        std::string_view stringValue(const CompiledNode * node) const;
+        std::string valueAsString(const CompiledNode * node) const;
+};
+
+bool writeCompiledConfig(std::variant<HTree*, HArray*> root, std::string const& filename);
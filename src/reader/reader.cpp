@@ -1,7 +1,11 @@
 #include "reader.hpp"
+#include <algorithm>
+#include <charconv>
 
 using namespace std;
 
+static std::atomic<uint64_t> nextLoadId{1}; // identifies each load, so ConfigPath handles can tell whether their node is still current.
+
 template<typename ... Ts>                                                 
 struct Overload : Ts ... { 
     using Ts::operator() ...;
@@ -44,8 +48,230 @@ std::vector<std::string> splitString(std::string str, char delim) {
     }
 }
 
-ConfigFile::ConfigFile(char * filename) {
+// typed conversions for parsed values, shared by the string path and ConfigPath getters.
+
+std::string simpleGetString(std::variant<HTree*,HArray*,HSimpleValue*> res, std::string const& str) {
+    if (std::holds_alternative<HSimpleValue*>(res)) {
+        return std::visit(simpleValueAsString, std::get<HSimpleValue*>(res)->svalue);
+    }
+    throw std::runtime_error("Error: getStringByPath encountered an invalid value at path " + str);
+}
+
+bool simpleAsBool(const HSimpleValue * value, std::string const& str) {
+    if (std::holds_alternative<bool>(value->svalue)) {
+        return std::get<bool>(value->svalue);
+    } else if (std::holds_alternative<std::string>(value->svalue)) {
+        std::string const& val = std::get<std::string>(value->svalue);
+        if (val == "true" || val == "yes" || val == "on") {
+            return true;
+        } else if (val == "false" || val == "no" || val == "off") {
+            return false;
+        } else {
+            throw std::runtime_error("Error: getBoolByPath encountered an invalid value '" + val + "' at path " + str);
+        }
+    } else {
+        throw std::runtime_error("Error: getBoolByPath encountered an invalid value type at path " + str);
+    }
+}
+
+double simpleAsDouble(const HSimpleValue * value, std::string const& str) {
+    if (std::holds_alternative<std::string>(value->svalue)) {
+        return std::strtod(std::get<std::string>(value->svalue).c_str(), nullptr); // really should add a check for a valid string value here.
+    } else if (std::holds_alternative<int>(value->svalue)) {
+        return (double) std::get<int>(value->svalue);
+    } else if (std::holds_alternative<double>(value->svalue)) {
+        return std::get<double>(value->svalue);
+    } else {
+        throw std::runtime_error("Error: getDoubleByPath encountered an invalid value at path " + str);
+    }
+}
+
+/*
+    Converts the string value val at path str with std::stoi.
+    @returns the leading integer of val, throwing the runtime_error of the getters if it has none or it is out of range.
+*/
+int stringAsInt(std::string const& val, std::string const& str) {
+    try {
+        return std::stoi(val);
+    } catch (std::logic_error const& e) { // std::invalid_argument and std::out_of_range.
+        throw std::runtime_error("Error: getIntByPath encountered an invalid value '" + val + "' at path " + str);
+    }
+}
+
+int simpleAsInt(const HSimpleValue * value, std::string const& str) {
+    if (std::holds_alternative<std::string>(value->svalue)) {
+        return stringAsInt(std::get<std::string>(value->svalue), str);
+    } else if (std::holds_alternative<int>(value->svalue)) {
+        return std::get<int>(value->svalue);
+    } else if (std::holds_alternative<double>(value->svalue)) {
+        return (int) std::get<double>(value->svalue);
+    } else {
+        throw std::runtime_error("Error: getIntByPath encountered an invalid value at path " + str);
+    }
+}
+
+// typed conversions for values read from a compiled configuration, mirroring the HSimpleValue getters above.
+
+std::string compiledGetString(const CompiledConfig * compiled, const CompiledNode * node, std::string const& str) {
+    if (node && node->type != COMPILED_OBJECT && node->type != COMPILED_ARRAY) {
+        return compiled->valueAsString(node);
+    }
+    throw std::runtime_error("Error: getStringByPath encountered an invalid value at path " + str);
+}
+
+bool compiledAsBool(const CompiledConfig * compiled, const CompiledNode * node, std::string const& str) {
+    if (node->type == COMPILED_BOOL) {
+        return node->intValue != 0;
+    } else if (node->type == COMPILED_STRING) {
+        std::string_view val = compiled->stringValue(node);
+        if (val == "true" || val == "yes" || val == "on") {
+            return true;
+        } else if (val == "false" || val == "no" || val == "off") {
+            return false;
+        } else {
+            throw std::runtime_error("Error: getBoolByPath encountered an invalid value '" + std::string(val) + "' at path " + str);
+        }
+    } else {
+        throw std::runtime_error("Error: getBoolByPath encountered an invalid value type at path " + str);
+    }
+}
+
+double compiledAsDouble(const CompiledConfig * compiled, const CompiledNode * node, std::string const& str) {
+    switch (node->type) {
+        case COMPILED_STRING:
+            return std::strtod(std::string(compiled->stringValue(node)).c_str(), nullptr);
+        case COMPILED_INT:
+            return (double) node->intValue;
+        case COMPILED_DOUBLE:
+            return node->doubleValue;
+        default:
+            throw std::runtime_error("Error: getDoubleByPath encountered an invalid value at path " + str);
+    }
+}
+
+int compiledAsInt(const CompiledConfig * compiled, const CompiledNode * node, std::string const& str) {
+    switch (node->type) {
+        case COMPILED_STRING:
+            return stringAsInt(std::string(compiled->stringValue(node)), str);
+        case COMPILED_INT:
+            return (int) node->intValue;
+        case COMPILED_DOUBLE:
+            return (int) node->doubleValue;
+        default:
+            throw std::runtime_error("Error: getIntByPath encountered an invalid value at path " + str);
+    }
+}
+
+// non-throwing conversions for the tryGet getters.
+
+std::optional<int> parseInt(std::string_view str) {
+    int value;
+    auto [end, error] = std::from_chars(str.data(), str.data() + str.size(), value);
+    return (error == std::errc() && end == str.data() + str.size()) ? std::optional<int>(value) : std::nullopt;
+}
+
+std::optional<double> parseDouble(std::string_view str) {
+    double value;
+    auto [end, error] = std::from_chars(str.data(), str.data() + str.size(), value);
+    return (error == std::errc() && end == str.data() + str.size()) ? std::optional<double>(value) : std::nullopt;
+}
+
+std::optional<bool> parseBool(std::string_view str) {
+    if (str == "true" || str == "yes" || str == "on") {
+        return true;
+    } else if (str == "false" || str == "no" || str == "off") {
+        return false;
+    }
+    return std::nullopt;
+}
+
+std::optional<std::string> simpleTryString(const HSimpleValue * value) {
+    return std::visit(simpleValueAsString, value->svalue);
+}
+
+std::optional<bool> simpleTryBool(const HSimpleValue * value) {
+    if (std::holds_alternative<bool>(value->svalue)) {
+        return std::get<bool>(value->svalue);
+    }
+    return std::holds_alternative<std::string>(value->svalue) ? parseBool(std::get<std::string>(value->svalue)) : std::nullopt;
+}
+
+std::optional<double> simpleTryDouble(const HSimpleValue * value) {
+    switch (value->svalue.index()) {
+        case 0:
+            return (double) std::get<int>(value->svalue);
+        case 1:
+            return std::get<double>(value->svalue);
+        case 3:
+            return parseDouble(std::get<std::string>(value->svalue));
+        default:
+            return std::nullopt;
+    }
+}
+
+std::optional<int> simpleTryInt(const HSimpleValue * value) {
+    switch (value->svalue.index()) {
+        case 0:
+            return std::get<int>(value->svalue);
+        case 1:
+            return (int) std::get<double>(value->svalue);
+        case 3:
+            return parseInt(std::get<std::string>(value->svalue));
+        default:
+            return std::nullopt;
+    }
+}
+
+std::optional<std::string> compiledTryString(const CompiledConfig * compiled, const CompiledNode * node) {
+    return (node->type != COMPILED_OBJECT && node->type != COMPILED_ARRAY) ? std::optional<std::string>(compiled->valueAsString(node)) : std::nullopt;
+}
+
+std::optional<bool> compiledTryBool(const CompiledConfig * compiled, const CompiledNode * node) {
+    if (node->type == COMPILED_BOOL) {
+        return node->intValue != 0;
+    }
+    return node->type == COMPILED_STRING ? parseBool(compiled->stringValue(node)) : std::nullopt;
+}
+
+std::optional<double> compiledTryDouble(const CompiledConfig * compiled, const CompiledNode * node) {
+    switch (node->type) {
+        case COMPILED_INT:
+            return (double) node->intValue;
+        case COMPILED_DOUBLE:
+            return node->doubleValue;
+        case COMPILED_STRING:
+            return parseDouble(compiled->stringValue(node));
+        default:
+            return std::nullopt;
+    }
+}
+
+std::optional<int> compiledTryInt(const CompiledConfig * compiled, const CompiledNode * node) {
+    switch (node->type) {
+        case COMPILED_INT:
+            return (int) node->intValue;
+        case COMPILED_DOUBLE:
+            return (int) node->doubleValue;
+        case COMPILED_STRING:
+            return parseInt(compiled->stringValue(node));
+        default:
+            return std::nullopt;
+    }
+}
+
+ConfigFile::ConfigFile(char * filename) : ConfigFile(filename, HOCON) {}
+
+ConfigFile::ConfigFile(char * filename, ConfigFormat format) : filename(filename), format(format) {
     string filename_str = string(filename);
+    if (format == COMPILED) {
+        compiled = new CompiledConfig(filename_str);
+        if (!compiled->valid) {
+            cerr << "ERROR: File " << filename_str << " is not a valid compiled configuration." << endl;
+            exit(1);
+        }
+        loadId = nextLoadId++;
+        return;
+    }
     ifstream conf_file(filename_str);
     if (!conf_file.is_open()) {
         cerr << "ERROR: File " << filename_str << " failed to open." << endl;
@@ -57,198 +283,721 @@ ConfigFile::ConfigFile(char * filename) {
     }
 }
 
+/*
+    Creates an unloaded configuration for filename that shares cache with other configurations of the same file.
+    The file is not read until reload() is called.
+*/
+ConfigFile::ConfigFile(std::string const& filename, std::shared_ptr<IncludeCache> cache) : filename(filename), includeCache(cache) {}
+
 ConfigFile::ConfigFile(HTree * newRoot) {
-    parserPtr = new HParser(newRoot);
+    publish(new HParser(newRoot));
 }
 
 ConfigFile::ConfigFile(HArray * newRoot) {
-    parserPtr = new HParser(newRoot);
+    publish(new HParser(newRoot));
+}
+
+/*
+    Makes parser and its tree the loaded configuration. The previous one is freed once no ConfigView shares it.
+*/
+void ConfigFile::publish(HParser * parser) {
+    loaded = std::shared_ptr<const HParser>(parser, [](const HParser * done) {
+        std::visit(deleteConfigObj, done->rootObject);
+        delete done;
+    });
+    parserPtr = parser;
+    loadId = nextLoadId++;
 }
 
+/*
+    Builds the configuration with HJsonParser, which needs no substitution pass.
+    @returns nullptr if the file is not JSON (or, unless the format is JSON, is read differently by the HOCON parser),
+    setting error if it is not null.
+*/
+HParser * ConfigFile::parseJson(Diagnostic * error) const {
+    PhaseTimer timer(PHASE_PARSE);
+    HJsonParser json(file, format == JSON, maxDepth);
+    std::optional<std::variant<HTree*, HArray*>> root = json.run();
+    if (!root) {
+        if (error) {
+            *error = json.getDiagnostic();
+            error->file = filename;
+        }
+        return nullptr;
+    }
+    HParser * parser = new HParser(std::vector<Token>());
+    parser->rootObject = *root;
+    return parser;
+}
+
+/*
+    Loads the file and prints the configuration as parsed, its stack history, and the configuration once resolved. Plain
+    JSON is parsed by parseJson instead of the lexer and HParser, and is printed the same way.
+*/
 void ConfigFile::runFile() {
+    stats.reset();
+    StatsScope scope(statsEnabled ? &stats : nullptr);
     std::vector<Token> tokens;
-    Lexer lexer = Lexer(file);
-    tokens = lexer.run();
-    if (lexer.hasError) {
-        std::cerr << "Lexer Error occurred. Terminating program." << endl;
+    Diagnostic jsonError;
+    HParser * parser = parseJson(&jsonError);
+    if (parser) {
+        publish(parser);
+        recordMemory(PHASE_PARSE, parser, tokens);
+    } else if (format == JSON) {
+        std::cerr << "JSON Error: [line " << jsonError.line << "] " << jsonError.message << ". Terminating program." << endl;
         exit(1);
-    }
-
-    HParser * parser = new HParser(tokens);
-    parserPtr = parser;
-    parser->lexer = &lexer;
-    parser->parseTokens();
+    } else {
+        {
+            PhaseTimer timer(PHASE_LEX);
+            Lexer lexer = Lexer(file);
+            tokens = lexer.run();
+            countStat(COUNT_TOKENS, tokens.size());
+            if (lexer.hasError) {
+                std::cerr << "Lexer Error occurred. Terminating program." << endl;
+                exit(1);
+            }
+        }
+        recordMemory(PHASE_LEX, nullptr, tokens);
 
-    if(std::holds_alternative<HTree*>(parser->rootObject)) {
-        HTree* p = std::get<HTree*>(parser->rootObject);
-        std::cout << "Root Object String: \n" << p->str() << std::endl;
-    } else if (std::holds_alternative<HArray*>(parser->rootObject)) {
-        HArray * p = std::get<HArray*>(parser->rootObject);
-        std::cout << "Root Array String: \n" << p->str() << std::endl;
+        parser = new HParser(tokens);
+        publish(parser);
+        parser->includeCache = includeCache.get();
+        parser->lazy = resolveMode == LAZY;
+        parser->variables = variables;
+        parser->maxDepth = maxDepth;
+        parser->recordStack = HParser::needsStack(tokens);
+        prepareIncludes(parser, tokens);
+        {
+            PhaseTimer timer(PHASE_PARSE);
+            parser->parseTokens();
+        }
+        recordMemory(PHASE_PARSE, parser, tokens);
     }
+
+    std::cout << (std::holds_alternative<HTree*>(parser->rootObject) ? "Root Object String: \n" : "Root Array String: \n");
+    std::visit([](auto root) { HWriter(std::cout, RENDER_HOCON).write(root); }, parser->rootObject);
+    std::cout << std::endl;
     if (!parser->validConf) {
         std::cout << "Invalid Configuration, Aborted" << std::endl;
         return;
     }
     parser->getStack();
-    parser->resolveSubstitutions();
+    if (resolveMode == LAZY) {
+        return;
+    }
+    {
+        PhaseTimer timer(PHASE_RESOLVE);
+        parser->resolveSubstitutions();
+    }
+    recordMemory(PHASE_RESOLVE, parser, tokens);
     if (!parser->validConf) {
         std::cout << "Invalid Configuration, Aborted" << std::endl;
         return;
     }
-    if (std::holds_alternative<HTree*>(parser->rootObject)) {
-        std::cout << "\nResolved Object String: \n" << std::get<HTree*>(parser->rootObject)->str() << std::endl;
+    std::cout << "\nResolved Object String: \n";
+    std::visit([](auto root) { HWriter(std::cout, RENDER_HOCON).write(root); }, parser->rootObject);
+    std::cout << std::endl;
+}
+
+/*
+    Streams the configuration to out in a single pass. In lazy mode JSON output resolves every substitution first.
+    Throws std::runtime_error for a compiled configuration, which keeps no tree, and when JSON output reaches a
+    substitution that failed to resolve.
+*/
+void ConfigFile::render(std::ostream& out, RenderFormat renderFormat) const {
+    if (!parserPtr) {
+        throw std::runtime_error("Error: only configurations loaded from HOCON or JSON can be rendered");
+    }
+    if (resolveMode == LAZY && renderFormat != RENDER_HOCON) {
+        std::visit([this](auto root) { parserPtr->resolveAll(root); }, parserPtr->rootObject);
+    }
+    std::visit([&out, renderFormat](auto root) { HWriter(out, renderFormat).write(root); }, parserPtr->rootObject);
+}
+
+/*
+    Lexes, parses and resolves the file without printing anything, reading plain JSON through parseJson. The previous
+    configuration, if any, is only replaced when the new one is valid.
+    @returns false if the configuration is invalid.
+*/
+bool ConfigFile::parse() {
+    stats.reset();
+    StatsScope scope(statsEnabled ? &stats : nullptr);
+    Diagnostic jsonError;
+    HParser * parser = parseJson(&jsonError);
+    if (parser) {
+        recordMemory(PHASE_PARSE, parser, std::vector<Token>());
+    } else {
+        if (format == JSON) {
+            diagnostics.push_back(jsonError);
+            return false;
+        }
+        std::vector<Token> tokens;
+        {
+            PhaseTimer timer(PHASE_LEX);
+            Lexer lexer = Lexer(file);
+            lexer.diagnostics = &diagnostics;
+            lexer.sourceName = filename;
+            tokens = lexer.run();
+            countStat(COUNT_TOKENS, tokens.size());
+            if (lexer.hasError) {
+                return false;
+            }
+        }
+        recordMemory(PHASE_LEX, nullptr, tokens);
+        parser = new HParser(tokens);
+        parser->includeCache = includeCache.get();
+        parser->lazy = resolveMode == LAZY;
+        parser->variables = variables;
+        parser->maxDepth = maxDepth;
+        parser->recordStack = HParser::needsStack(tokens);
+        prepareIncludes(parser, tokens);
+        parser->diagnostics = &diagnostics;
+        parser->sourceName = filename;
+        {
+            PhaseTimer timer(PHASE_PARSE);
+            parser->parseTokens();
+        }
+        recordMemory(PHASE_PARSE, parser, tokens);
+        if (parser->validConf && !parser->lazy) {
+            {
+                PhaseTimer timer(PHASE_RESOLVE);
+                parser->resolveSubstitutions();
+            }
+            recordMemory(PHASE_RESOLVE, parser, tokens);
+        }
+        locateDiagnostics(diagnostics, 0, filename, file);
+        if (!parser->validConf) {
+            std::visit(deleteConfigObj, parser->rootObject);
+            delete parser;
+            return false;
+        }
+    }
+    if (pathIndexEnabled && !parser->lazy) {
+        {
+            PhaseTimer timer(PHASE_INDEX);
+            parser->buildPathIndex();
+        }
+        recordMemory(PHASE_INDEX, parser, std::vector<Token>());
+    }
+    parser->diagnostics = nullptr; // lazy resolutions after the load throw instead.
+    publish(parser);
+    return true;
+}
+
+/*
+    Reads the configuration file and builds the configuration: lexing, parsing and resolution only, with nothing
+    rendered or printed. Every error is collected in the result, so an invalid file costs no writes however many errors
+    it has. Included files that did not change since the last load are spliced in from the include cache instead of
+    being read, lexed and parsed again; substitutions are then resolved over the whole document, since stack counters
+    tie every substitution to its position in the include order.
+    On failure the previous configuration, if any, is kept.
+*/
+LoadResult ConfigFile::load() {
+    diagnostics.clear();
+    LoadResult result;
+    result.status = LOAD_UNREADABLE;
+    if (filename.empty() || compiled) {
+        diagnostics.push_back(Diagnostic{DIAG_IO, "only configurations created from a file name can be loaded", filename});
+    } else if (!readFile()) {
+        diagnostics.push_back(Diagnostic{DIAG_IO, "file failed to open", filename});
     } else {
-        std::cout << "\nResolved Object String: \n" << std::get<HArray*>(parser->rootObject)->str() << std::endl;
+        result.status = parse() ? LOAD_OK : LOAD_INVALID;
+    }
+    result.diagnostics = diagnostics;
+    return result;
+}
+
+/*
+    Reads filename into file.
+    @returns false if the file could not be opened.
+*/
+bool ConfigFile::readFile() {
+    ifstream conf_file(filename);
+    if (!conf_file.is_open()) {
+        return false;
+    }
+    ostringstream stream;
+    stream << conf_file.rdbuf();
+    file = stream.str();
+    return true;
+}
+
+/*
+    load() reporting only whether the new configuration was published.
+*/
+bool ConfigFile::reload() {
+    return load().ok();
+}
+
+void ConfigFile::setResolveMode(ResolveMode mode) {
+    resolveMode = mode;
+}
+
+void ConfigFile::setStatsEnabled(bool enabled) {
+    statsEnabled = enabled;
+}
+
+void ConfigFile::setVariables(std::shared_ptr<const VariableMap> variables) {
+    this->variables = variables;
+}
+
+void ConfigFile::setMaxDepth(int depth) {
+    maxDepth = depth;
+}
+
+void ConfigFile::setParallelIncludes(bool enabled) {
+    parallelIncludes = enabled;
+}
+
+void ConfigFile::setFileReader(std::shared_ptr<FileReader> reader) {
+    fileReader = reader;
+}
+
+#ifdef HOCON_CURL
+void ConfigFile::setHttpFetcher(std::shared_ptr<HttpFetcher> fetcher) {
+    httpFetcher = fetcher;
+}
+#endif
+
+void ConfigFile::setIncludeResolvers(std::shared_ptr<const ResolverChain> chain) {
+    resolvers = chain;
+}
+
+/*
+    Gives the parser of tokens the include pool and resolver chain it starts includes ahead with. The shared pool is
+    only started by a load that has an include, the shared file reader by a file include and the shared http fetcher
+    by an url include.
+*/
+void ConfigFile::prepareIncludes(HParser * parser, std::vector<Token> const& tokens) const {
+    bool hasInclude = false;
+    for (Token const& t : tokens) {
+        if (t.type == UNQUOTED_STRING && t.lexeme == "include") {
+            hasInclude = true;
+            break;
+        }
+    }
+    if (!hasInclude) {
+        return;
+    }
+    parser->includePool = parallelIncludes ? &IncludePool::shared() : nullptr;
+    if (resolvers) {
+        parser->resolvers = resolvers;
+        return;
+    }
+    std::shared_ptr<ResolverChain> chain = std::make_shared<ResolverChain>();
+    chain->add(std::make_shared<FileResolver>(fileReader));
+#ifdef HOCON_CURL
+    chain->add(std::make_shared<UrlResolver>(httpFetcher));
+#endif
+    parser->resolvers = chain;
+}
+
+void ConfigFile::setPathIndexEnabled(bool enabled) {
+    pathIndexEnabled = enabled;
+}
+
+bool ConfigFile::hasPathIndex() const {
+    return parserPtr && parserPtr->pathIndex;
+}
+
+std::vector<Diagnostic> const& ConfigFile::getDiagnostics() const {
+    return diagnostics;
+}
+
+LoadStats const& ConfigFile::getStats() const {
+    return stats;
+}
+
+/*
+    Stats only: records the memory the load holds at the end of phase. tokens is the lexer output, which stays alive
+    next to the parser's own copy until the load returns.
+*/
+void ConfigFile::recordMemory(StatsPhase phase, const HParser * parser, std::vector<Token> const& tokens) {
+    if (!statsEnabled) {
+        return;
     }
+    MemoryUsage usage = parser ? measureMemory(*parser) : MemoryUsage();
+    MemoryUsage lexed = measureTokens(tokens);
+    usage.bytes[MEM_TOKENS] += lexed.bytes[MEM_TOKENS];
+    usage.counts[MEM_TOKENS] += lexed.counts[MEM_TOKENS];
+    stats.phaseMemory[phase] = usage;
+}
+
+/*
+    Memory retained by the loaded configuration: what it keeps between loads, as opposed to the peak held while loading
+    (LoadStats::peakMemory). Empty for a compiled configuration, which only maps its file.
+*/
+MemoryUsage ConfigFile::getMemoryUsage() const {
+    return parserPtr ? measureMemory(*parserPtr) : MemoryUsage();
+}
+
+/*
+    @returns every file reached through an include while loading, in include order and without duplicates.
+*/
+std::vector<std::string> ConfigFile::getIncludedFiles() const {
+    std::vector<std::string> out;
+    if (!parserPtr) {
+        return out;
+    }
+    std::unordered_set<std::string> seen;
+    for (auto const& stamp : parserPtr->dependencies) {
+        if (seen.insert(stamp.path).second) {
+            out.push_back(stamp.path);
+        }
+    }
+    return out;
 }
 
 ConfigFile::~ConfigFile() {
-    std::visit(deleteConfigObj, parserPtr->rootObject);
-    delete parserPtr;
+    delete compiled;
 }
 
-std::string ConfigFile::getStringByPath(std::string const& str) {
-    std::vector<std::string> path = HParser::splitPath(str);
-    std::variant<HTree*,HArray*,HSimpleValue*> res = parserPtr->getByPath(path);
-    if (std::holds_alternative<HSimpleValue*>(res)) {
-        return std::visit(simpleValueAsString, std::get<HSimpleValue*>(res)->svalue);
-    } else {
-        throw std::runtime_error("Error: getStringByPath encountered an invalid value at path " + str);
+std::string ConfigFile::getStringByPath(std::string const& str) const {
+    if (compiled) {
+        return compiledGetString(compiled, compiled->find(str), str);
     }
+    return simpleGetString(lookupPath(str), str);
 }
 
-std::string ConfigFile::getStringByPath(std::string const& str, std::string const& defaultVal) {
-    std::vector<std::string> path = HParser::splitPath(str);
-    std::variant<HTree*,HArray*,HSimpleValue*> res = parserPtr->getByPath(path);
-    if (std::holds_alternative<HSimpleValue*>(res)) {
-        return std::visit(simpleValueAsString, std::get<HSimpleValue*>(res)->svalue);
-    } else {
-        return defaultVal;
+std::string ConfigFile::getStringByPath(std::string const& str, std::string const& defaultVal) const {
+    if (compiled) {
+        const CompiledNode * node = compiled->find(str);
+        return (node && node->type != COMPILED_OBJECT && node->type != COMPILED_ARRAY) ? compiled->valueAsString(node) : defaultVal;
     }
+    std::variant<HTree*,HArray*,HSimpleValue*> res = lookupPath(str);
+    return std::holds_alternative<HSimpleValue*>(res) ? std::visit(simpleValueAsString, std::get<HSimpleValue*>(res)->svalue) : defaultVal;
 }
 
-bool ConfigFile::getBoolByPath(std::string const& str) {
-    std::variant<HTree*,HArray*,HSimpleValue*> res = parserPtr->getByPath(HParser::splitPath(str));
-    if (std::holds_alternative<HSimpleValue*>(res)) {
-        std::variant<int, double, bool, std::string> svalue = std::get<HSimpleValue*>(res)->svalue;
-        if (std::holds_alternative<bool>(svalue)) {
-            return std::get<bool>(svalue);
-        } else if (std::holds_alternative<std::string>(svalue)) {
-            std::string val = std::get<std::string>(svalue);
-            if (val == "true" || val == "yes" || val == "on") {
-                return true;
-            } else if (val == "false" || val == "no" || val == "off") {
-                return false;
-            } else {
-                throw std::runtime_error("Error: getBoolByPath encountered an invalid value '" + val + "' at path " + str);
-            }
-        } else {
-            throw std::runtime_error("Error: getBoolByPath encountered an invalid value type at path " + str);
+bool ConfigFile::getBoolByPath(std::string const& str) const {
+    if (compiled) {
+        const CompiledNode * node = compiled->find(str);
+        if (!node) {
+            throw std::runtime_error("Error: the path, " + str + " doesn't exist in the configuration");
         }
-    } else {
+        return compiledAsBool(compiled, node, str);
+    }
+    std::variant<HTree*,HArray*,HSimpleValue*> res = lookupPath(str);
+    if (!std::holds_alternative<HSimpleValue*>(res)) {
         throw std::runtime_error("Error: the path, " + str + " doesn't exist in the configuration");
     }
+    return simpleAsBool(std::get<HSimpleValue*>(res), str);
 }
 
-bool ConfigFile::getBoolByPath(std::string const& str, bool defaultVal) {
-    std::variant<HTree*,HArray*,HSimpleValue*> res = parserPtr->getByPath(HParser::splitPath(str));
-    if (std::holds_alternative<HSimpleValue*>(res)) {
-        std::variant<int, double, bool, std::string> svalue = std::get<HSimpleValue*>(res)->svalue;
-        if (std::holds_alternative<bool>(svalue)) {
-            return std::get<bool>(svalue);
-        } else if (std::holds_alternative<std::string>(svalue)) {
-            std::string val = std::get<std::string>(svalue);
-            if (val == "true" || val == "yes" || val == "on") {
-                return true;
-            } else if (val == "false" || val == "no" || val == "off") {
-                return false;
-            } else {
-                throw std::runtime_error("Error: getBoolByPath encountered an invalid value '" + val + "' at path " + str);
-            }
-        } else {
-            throw std::runtime_error("Error: getBoolByPath encountered an invalid value type at path " + str);
+bool ConfigFile::getBoolByPath(std::string const& str, bool defaultVal) const {
+    if (compiled) {
+        const CompiledNode * node = compiled->find(str);
+        return node ? compiledAsBool(compiled, node, str) : defaultVal;
+    }
+    std::variant<HTree*,HArray*,HSimpleValue*> res = lookupPath(str);
+    return std::holds_alternative<HSimpleValue*>(res) ? simpleAsBool(std::get<HSimpleValue*>(res), str) : defaultVal;
+}
+
+double ConfigFile::getDoubleByPath(std::string const& str) const {
+    if (compiled) {
+        const CompiledNode * node = compiled->find(str);
+        if (!node) {
+            throw std::runtime_error("Error: getDoubleByPath encountered an invalid value at path " + str);
         }
-    } else {
-        return defaultVal;
+        return compiledAsDouble(compiled, node, str);
+    }
+    std::variant<HTree*,HArray*,HSimpleValue*> res = lookupPath(str);
+    if (!std::holds_alternative<HSimpleValue*>(res)) {
+        throw std::runtime_error("Error: getDoubleByPath encountered an invalid value at path " + str);
     }
+    return simpleAsDouble(std::get<HSimpleValue*>(res), str);
 }
 
-double ConfigFile::getDoubleByPath(std::string const& str) {
-    std::variant<HTree*,HArray*,HSimpleValue*> res = parserPtr->getByPath(HParser::splitPath(str));
-    if (std::holds_alternative<HSimpleValue*>(res)) {
-        std::variant<int, double, bool, std::string> svalue = std::get<HSimpleValue*>(res)->svalue;
-        if (std::holds_alternative<std::string>(svalue)) {
-            return std::strtod(std::get<std::string>(svalue).c_str(), nullptr); // really should add a check for a valid string value here.
-        } else if (std::holds_alternative<int>(svalue)) {
-            return (double) std::get<int>(svalue);
-        } else if (std::holds_alternative<double>(svalue)) {
-            return std::get<double>(svalue);
-        } else {
-            throw std::runtime_error("Error: getBoolByPath encountered an invalid value at path " + str);
+double ConfigFile::getDoubleByPath(std::string const& str, double defaultVal) const {
+    if (compiled) {
+        const CompiledNode * node = compiled->find(str);
+        return node ? compiledAsDouble(compiled, node, str) : defaultVal;
+    }
+    std::variant<HTree*,HArray*,HSimpleValue*> res = lookupPath(str);
+    return std::holds_alternative<HSimpleValue*>(res) ? simpleAsDouble(std::get<HSimpleValue*>(res), str) : defaultVal;
+}
+
+int ConfigFile::getIntByPath(std::string const& str) const {
+    if (compiled) {
+        const CompiledNode * node = compiled->find(str);
+        if (!node) {
+            throw std::runtime_error("Error: getIntByPath encountered an invalid value at path " + str);
         }
-    } else {
-        throw std::runtime_error("Error: getBoolByPath encountered an invalid value at path " + str);
+        return compiledAsInt(compiled, node, str);
+    }
+    std::variant<HTree*,HArray*,HSimpleValue*> res = lookupPath(str);
+    if (!std::holds_alternative<HSimpleValue*>(res)) {
+        throw std::runtime_error("Error: getIntByPath encountered an invalid value at path " + str);
     }
+    return simpleAsInt(std::get<HSimpleValue*>(res), str);
 }
 
-double ConfigFile::getDoubleByPath(std::string const& str, double defaultVal) {
-    std::variant<HTree*,HArray*,HSimpleValue*> res = parserPtr->getByPath(HParser::splitPath(str));
-    if (std::holds_alternative<HSimpleValue*>(res)) {
-        std::variant<int, double, bool, std::string> svalue = std::get<HSimpleValue*>(res)->svalue;
-        if (std::holds_alternative<std::string>(svalue)) {
-            return std::strtod(str.c_str(), nullptr); // really should add a check for a valid string value here.
-        } else if (std::holds_alternative<int>(svalue)) {
-            return (double) std::get<int>(svalue);
-        } else if (std::holds_alternative<double>(svalue)) {
-            return std::get<double>(svalue);
-        } else {
-            throw std::runtime_error("Error: getBoolByPath encountered an invalid value at path " + str);
+int ConfigFile::getIntByPath(std::string const& str, int defaultVal) const {
+    if (compiled) {
+        const CompiledNode * node = compiled->find(str);
+        return node ? compiledAsInt(compiled, node, str) : defaultVal;
+    }
+    std::variant<HTree*,HArray*,HSimpleValue*> res = lookupPath(str);
+    return std::holds_alternative<HSimpleValue*>(res) ? simpleAsInt(std::get<HSimpleValue*>(res), str) : defaultVal;
+}
+
+/*
+    Splits path once and, when this configuration is loaded, resolves it to its node so that later lookups through the
+    handle are a couple of pointer loads. The handle stays usable after a reload or with another ConfigFile: the stored
+    node is only trusted by the load it came from, any other configuration walks the pre-split segments instead.
+*/
+ConfigPath ConfigFile::compile(std::string const& path) const {
+    ConfigPath out;
+    out.expression = path;
+    out.segments = HParser::splitPath(path);
+    out.loadId = loadId;
+    if (compiled) {
+        out.compiledNode = compiled->find(path);
+    } else if (parserPtr && !out.segments.empty() && std::holds_alternative<HTree*>(parserPtr->rootObject)) {
+        out.node = parserPtr->getByPath(out.segments);
+    }
+    return out;
+}
+
+const CompiledNode * ConfigFile::lookupCompiled(ConfigPath const& path) const {
+    return (loadId != 0 && path.loadId == loadId) ? path.compiledNode : compiled->find(path.expression);
+}
+
+/*
+    The node at a string path, through the path index when the configuration has one.
+*/
+std::variant<HTree*,HArray*,HSimpleValue*> ConfigFile::lookupPath(std::string const& str) const {
+    if (parserPtr->pathIndex) {
+        LookupError error;
+        return parserPtr->findByPath(str, error);
+    }
+    return parserPtr->getByPath(HParser::splitPath(str));
+}
+
+std::variant<HTree*,HArray*,HSimpleValue*> ConfigFile::lookup(ConfigPath const& path) const {
+    return (loadId != 0 && path.loadId == loadId) ? path.node : parserPtr->getByPath(path.segments);
+}
+
+std::string ConfigFile::getStringByPath(ConfigPath const& path) const {
+    if (compiled) {
+        return compiledGetString(compiled, lookupCompiled(path), path.expression);
+    }
+    return simpleGetString(lookup(path), path.expression);
+}
+
+std::string ConfigFile::getStringByPath(ConfigPath const& path, std::string const& defaultVal) const {
+    if (compiled) {
+        const CompiledNode * node = lookupCompiled(path);
+        return (node && node->type != COMPILED_OBJECT && node->type != COMPILED_ARRAY) ? compiled->valueAsString(node) : defaultVal;
+    }
+    std::variant<HTree*,HArray*,HSimpleValue*> res = lookup(path);
+    return std::holds_alternative<HSimpleValue*>(res) ? std::visit(simpleValueAsString, std::get<HSimpleValue*>(res)->svalue) : defaultVal;
+}
+
+bool ConfigFile::getBoolByPath(ConfigPath const& path) const {
+    if (compiled) {
+        const CompiledNode * node = lookupCompiled(path);
+        if (!node) {
+            throw std::runtime_error("Error: the path, " + path.expression + " doesn't exist in the configuration");
         }
-    } else {
-        return defaultVal;
+        return compiledAsBool(compiled, node, path.expression);
     }
+    std::variant<HTree*,HArray*,HSimpleValue*> res = lookup(path);
+    if (!std::holds_alternative<HSimpleValue*>(res)) {
+        throw std::runtime_error("Error: the path, " + path.expression + " doesn't exist in the configuration");
+    }
+    return simpleAsBool(std::get<HSimpleValue*>(res), path.expression);
 }
 
-int ConfigFile::getIntByPath(std::string const& str) {
-    std::variant<HTree*,HArray*,HSimpleValue*> res = parserPtr->getByPath(HParser::splitPath(str));
-    if (std::holds_alternative<HSimpleValue*>(res)) {
-        std::variant<int, double, bool, std::string> svalue = std::get<HSimpleValue*>(res)->svalue;
-        if (std::holds_alternative<std::string>(svalue)) {
-            return std::stoi(str); // really should add a check for a valid string value here.
-        } else if (std::holds_alternative<int>(svalue)) {
-            return std::get<int>(svalue);
-        } else if (std::holds_alternative<double>(svalue)) {
-            return (int) std::get<double>(svalue);
-        } else {
-            throw std::runtime_error("Error: getBoolByPath encountered an invalid value at path " + str);
+bool ConfigFile::getBoolByPath(ConfigPath const& path, bool defaultVal) const {
+    if (compiled) {
+        const CompiledNode * node = lookupCompiled(path);
+        return node ? compiledAsBool(compiled, node, path.expression) : defaultVal;
+    }
+    std::variant<HTree*,HArray*,HSimpleValue*> res = lookup(path);
+    return std::holds_alternative<HSimpleValue*>(res) ? simpleAsBool(std::get<HSimpleValue*>(res), path.expression) : defaultVal;
+}
+
+double ConfigFile::getDoubleByPath(ConfigPath const& path) const {
+    if (compiled) {
+        const CompiledNode * node = lookupCompiled(path);
+        if (!node) {
+            throw std::runtime_error("Error: getDoubleByPath encountered an invalid value at path " + path.expression);
         }
-    } else {
-        throw std::runtime_error("Error: getBoolByPath encountered an invalid value at path " + str);
+        return compiledAsDouble(compiled, node, path.expression);
+    }
+    std::variant<HTree*,HArray*,HSimpleValue*> res = lookup(path);
+    if (!std::holds_alternative<HSimpleValue*>(res)) {
+        throw std::runtime_error("Error: getDoubleByPath encountered an invalid value at path " + path.expression);
     }
+    return simpleAsDouble(std::get<HSimpleValue*>(res), path.expression);
 }
 
-int ConfigFile::getIntByPath(std::string const& str, int defaultVal) {
-    std::variant<HTree*,HArray*,HSimpleValue*> res = parserPtr->getByPath(HParser::splitPath(str));
-    if (std::holds_alternative<HSimpleValue*>(res)) {
-        std::variant<int, double, bool, std::string> svalue = std::get<HSimpleValue*>(res)->svalue;
-        if (std::holds_alternative<std::string>(svalue)) {
-            return std::stoi(str); // really should add a check for a valid string value here.
-        } else if (std::holds_alternative<int>(svalue)) {
-            return std::get<int>(svalue);
-        } else if (std::holds_alternative<double>(svalue)) {
-            return (int) std::get<double>(svalue);
-        } else {
-            throw std::runtime_error("Error: getBoolByPath encountered an invalid value at path " + str);
+double ConfigFile::getDoubleByPath(ConfigPath const& path, double defaultVal) const {
+    if (compiled) {
+        const CompiledNode * node = lookupCompiled(path);
+        return node ? compiledAsDouble(compiled, node, path.expression) : defaultVal;
+    }
+    std::variant<HTree*,HArray*,HSimpleValue*> res = lookup(path);
+    return std::holds_alternative<HSimpleValue*>(res) ? simpleAsDouble(std::get<HSimpleValue*>(res), path.expression) : defaultVal;
+}
+
+int ConfigFile::getIntByPath(ConfigPath const& path) const {
+    if (compiled) {
+        const CompiledNode * node = lookupCompiled(path);
+        if (!node) {
+            throw std::runtime_error("Error: getIntByPath encountered an invalid value at path " + path.expression);
         }
-    } else {
-        return defaultVal;
+        return compiledAsInt(compiled, node, path.expression);
+    }
+    std::variant<HTree*,HArray*,HSimpleValue*> res = lookup(path);
+    if (!std::holds_alternative<HSimpleValue*>(res)) {
+        throw std::runtime_error("Error: getIntByPath encountered an invalid value at path " + path.expression);
+    }
+    return simpleAsInt(std::get<HSimpleValue*>(res), path.expression);
+}
+
+int ConfigFile::getIntByPath(ConfigPath const& path, int defaultVal) const {
+    if (compiled) {
+        const CompiledNode * node = lookupCompiled(path);
+        return node ? compiledAsInt(compiled, node, path.expression) : defaultVal;
     }
+    std::variant<HTree*,HArray*,HSimpleValue*> res = lookup(path);
+    return std::holds_alternative<HSimpleValue*>(res) ? simpleAsInt(std::get<HSimpleValue*>(res), path.expression) : defaultVal;
 }
 
-ConfigFile ConfigFile::getConfig(std::string const& str) {
-    std::variant<HTree*,HArray*,HSimpleValue*> res = parserPtr->getByPath(HParser::splitPath(str));
-    if (std::holds_alternative<HTree*>(res)) {
+BindPlan::BindPlan(std::vector<std::string> const& paths, std::vector<BindType> const& types) : types(types) {
+    for (auto const& path : paths) {
+        segments.push_back(HParser::splitPath(path));
+    }
+    for (size_t i = 0; i < paths.size(); i++) {
+        order.push_back(i);
+    }
+    std::stable_sort(order.begin(), order.end(), [this](size_t a, size_t b) {
+        return segments[a] < segments[b];
+    });
+}
+
+/*
+    Visits every path of the plan in sorted order. objects[i] holds the object reached by the first i segments of the
+    previous path, so a path only walks the segments it does not share with the one before it.
+    child(node, key) returns the object member key of node, or a null node if there is none.
+*/
+template<typename Node, typename Child, typename Leaf>
+static void walkPlan(BindPlan const& plan, Node root, Child child, Leaf leaf) {
+    std::vector<Node> objects{root};
+    const std::vector<std::string> * previous = nullptr;
+    for (size_t index : plan.order) {
+        std::vector<std::string> const& segments = plan.segments[index];
+        if (segments.empty()) {
+            continue;
+        }
+        size_t keep = 1;
+        while (previous && keep < objects.size() && keep < segments.size() && (*previous)[keep - 1] == segments[keep - 1]) {
+            keep++;
+        }
+        objects.resize(keep);
+        previous = &segments;
+        Node curr = objects.back();
+        for (size_t i = keep - 1; curr && i + 1 < segments.size(); i++) {
+            curr = child(curr, segments[i]);
+            if (curr) {
+                objects.push_back(curr);
+            }
+        }
+        if (curr) {
+            leaf(curr, segments.back(), index);
+        }
+    }
+}
+
+/*
+    Looks up every path of the plan in a single traversal and converts each value to the type of its field.
+    @returns one value per field, empty where the path is missing. a value of the wrong type also sets errors[field].
+*/
+std::vector<BoundValue> ConfigFile::fetch(BindPlan const& plan, std::vector<std::string>& errors) const {
+    std::vector<BoundValue> values(plan.segments.size());
+    if (compiled) {
+        walkPlan(plan, compiled->root(), [this](const CompiledNode * node, std::string const& key) {
+            const CompiledNode * found = compiled->child(node, key);
+            return (found && found->type == COMPILED_OBJECT) ? found : nullptr;
+        }, [this, &plan, &values, &errors](const CompiledNode * node, std::string const& key, size_t index) {
+            const CompiledNode * found = compiled->child(node, key);
+            if (!found) {
+                return;
+            }
+            try {
+                switch (plan.types[index]) {
+                    case BIND_INT: values[index] = compiledAsInt(compiled, found, key); break;
+                    case BIND_DOUBLE: values[index] = compiledAsDouble(compiled, found, key); break;
+                    case BIND_BOOL: values[index] = compiledAsBool(compiled, found, key); break;
+                    case BIND_STRING: values[index] = compiledGetString(compiled, found, key); break;
+                }
+            } catch (std::exception const& e) {
+                errors[index] = "value has the wrong type";
+            }
+        });
+        return values;
+    }
+    if (!parserPtr || !std::holds_alternative<HTree*>(parserPtr->rootObject)) {
+        return values;
+    }
+    const HParser * parser = parserPtr;
+    walkPlan(plan, (const HTree *) std::get<HTree*>(parserPtr->rootObject), [parser](const HTree * node, std::string const& key) -> const HTree * {
+        auto member = node->members.find(key);
+        if (member == node->members.end()) {
+            return nullptr;
+        }
+        try {
+            std::variant<HTree*, HArray*, HSimpleValue*, HSubstitution*> value = parser->readValue(member->second);
+            return std::holds_alternative<HTree*>(value) ? std::get<HTree*>(value) : nullptr;
+        } catch (std::runtime_error const& e) {
+            return nullptr;
+        }
+    }, [parser, &plan, &values, &errors](const HTree * node, std::string const& key, size_t index) {
+        auto member = node->members.find(key);
+        if (member == node->members.end()) {
+            return;
+        }
+        std::variant<HTree*, HArray*, HSimpleValue*, HSubstitution*> read;
+        try {
+            read = parser->readValue(member->second);
+        } catch (std::runtime_error const& e) {
+            errors[index] = "substitution failed to resolve";
+            return;
+        }
+        if (std::holds_alternative<HTree*>(read) && !std::get<HTree*>(read)) {
+            return;
+        }
+        if (!std::holds_alternative<HSimpleValue*>(read)) {
+            errors[index] = "value is not a simple value";
+            return;
+        }
+        const HSimpleValue * value = std::get<HSimpleValue*>(read);
+        try {
+            switch (plan.types[index]) {
+                case BIND_INT: values[index] = simpleAsInt(value, key); break;
+                case BIND_DOUBLE: values[index] = simpleAsDouble(value, key); break;
+                case BIND_BOOL: values[index] = simpleAsBool(value, key); break;
+                case BIND_STRING: values[index] = std::visit(simpleValueAsString, value->svalue); break;
+            }
+        } catch (std::exception const& e) {
+            errors[index] = "value has the wrong type";
+        }
+    });
+    return values;
+}
+
+ConfigFile ConfigFile::getConfig(std::string const& str) const {
+    if (compiled) {
+        throw std::runtime_error("Error: getConfig is not supported on a compiled configuration");
+    }
+    std::variant<HTree*,HArray*,HSimpleValue*> res = lookupPath(str);
+    // the HParser constructors deep copy the subtree, so the returned ConfigFile owns its own root. lazy substitutions
+    // are resolved first so the copy holds their values.
+    if (parserPtr->lazy && !(std::holds_alternative<HTree*>(res) && !std::get<HTree*>(res))) {
+        std::visit([this](auto node) { parserPtr->resolveAll(node); }, res);
+    }
+    if (std::holds_alternative<HTree*>(res) && std::get<HTree*>(res)) {
         return ConfigFile(std::get<HTree*>(res));
     } else if (std::holds_alternative<HArray*>(res)) {
         return ConfigFile(std::get<HArray*>(res));
@@ -257,11 +1006,241 @@ ConfigFile ConfigFile::getConfig(std::string const& str) {
     }
 }
 
-bool ConfigFile::pathExists(std::string const& str) {
-    std::variant<HTree*,HArray*,HSimpleValue*> res = parserPtr->getByPath(HParser::splitPath(str));
-    if (std::holds_alternative<HTree*>(res) && !(std::get<HTree*>(res))) {
+bool ConfigFile::pathExists(std::string const& str) const {
+    if (compiled) {
+        return compiled->find(str) != nullptr;
+    }
+    LookupError error;
+    parserPtr->findByPath(str, error);
+    return error != LOOKUP_MISSING;
+}
+
+/*
+    Shared body of the tryGet getters of ConfigFile and ConfigView: finds the node below tree or compiledNode (the root
+    if null) without throwing and converts it with the conversion for the format the configuration was loaded from.
+*/
+template<typename T, typename FromSimple, typename FromCompiled>
+static std::optional<T> tryGetFrom(const HParser * parser, HTree * tree, const CompiledConfig * compiled, const CompiledNode * compiledNode,
+                                   std::string_view path, LookupError * error, FromSimple fromSimple, FromCompiled fromCompiled) {
+    LookupError status = LOOKUP_MISSING;
+    std::optional<T> out;
+    if (compiled) {
+        if (const CompiledNode * node = compiled->find(path, compiledNode)) {
+            out = fromCompiled(compiled, node);
+            status = out ? LOOKUP_OK : LOOKUP_WRONG_TYPE;
+        }
+    } else if (parser) {
+        std::variant<HTree*, HArray*, HSimpleValue*> res = parser->findByPath(path, status, tree);
+        if (status == LOOKUP_OK) {
+            out = std::holds_alternative<HSimpleValue*>(res) ? fromSimple(std::get<HSimpleValue*>(res)) : std::nullopt;
+            status = out ? LOOKUP_OK : LOOKUP_WRONG_TYPE;
+        }
+    }
+    if (error) {
+        *error = status;
+    }
+    return out;
+}
+
+std::optional<std::string> ConfigFile::tryGetStringByPath(std::string_view path, LookupError * error) const {
+    return tryGetFrom<std::string>(parserPtr, nullptr, compiled, nullptr, path, error, simpleTryString, compiledTryString);
+}
+
+std::optional<bool> ConfigFile::tryGetBoolByPath(std::string_view path, LookupError * error) const {
+    return tryGetFrom<bool>(parserPtr, nullptr, compiled, nullptr, path, error, simpleTryBool, compiledTryBool);
+}
+
+std::optional<double> ConfigFile::tryGetDoubleByPath(std::string_view path, LookupError * error) const {
+    return tryGetFrom<double>(parserPtr, nullptr, compiled, nullptr, path, error, simpleTryDouble, compiledTryDouble);
+}
+
+std::optional<int> ConfigFile::tryGetIntByPath(std::string_view path, LookupError * error) const {
+    return tryGetFrom<int>(parserPtr, nullptr, compiled, nullptr, path, error, simpleTryInt, compiledTryInt);
+}
+
+static std::string joinPath(std::string const& prefix, std::string const& path) {
+    return prefix.empty() ? path : prefix + "." + path;
+}
+
+ConfigView::ConfigView(std::shared_ptr<const ConfigFile> config, std::shared_ptr<const HParser> parser, HTree * tree, const CompiledNode * compiledNode, std::string prefix) :
+    config(std::move(config)), parser(std::move(parser)), tree(tree), compiledNode(compiledNode), prefix(std::move(prefix)) {}
+
+ConfigView::ConfigView(std::shared_ptr<const ConfigFile> config) : config(std::move(config)), parser(this->config->loaded) {
+    if (this->config->compiled) {
+        compiledNode = this->config->compiled->root();
+        compiledNode = (compiledNode && compiledNode->type == COMPILED_OBJECT) ? compiledNode : nullptr;
+    } else if (parser && std::holds_alternative<HTree*>(parser->rootObject)) {
+        tree = std::get<HTree*>(parser->rootObject);
+    }
+    if (!tree && !compiledNode) {
+        throw std::runtime_error("Error: a ConfigView needs a loaded configuration with an object at its root");
+    }
+}
+
+/*
+    A view of the object at path, relative to this view. Only the path is walked; lazy substitutions on it are resolved.
+*/
+ConfigView ConfigView::getView(std::string const& str) const {
+    if (compiledNode) {
+        const CompiledNode * node = findCompiled(str, true);
+        if (node->type != COMPILED_OBJECT) {
+            throw std::runtime_error("Error: getView encountered a non object at path " + joinPath(prefix, str));
+        }
+        return ConfigView(config, nullptr, nullptr, node, joinPath(prefix, str));
+    }
+    LookupError error;
+    std::variant<HTree*, HArray*, HSimpleValue*> res = parser->findByPath(str, error, tree);
+    if (error == LOOKUP_UNRESOLVED) {
+        throw std::runtime_error("Error: the substitution at path " + joinPath(prefix, str) + " could not be resolved");
+    } else if (error == LOOKUP_MISSING) {
+        throw std::runtime_error("Error: the path, " + joinPath(prefix, str) + " doesn't exist in the configuration");
+    } else if (!std::holds_alternative<HTree*>(res)) {
+        throw std::runtime_error("Error: getView encountered a non object at path " + joinPath(prefix, str));
+    }
+    return ConfigView(config, parser, std::get<HTree*>(res), nullptr, joinPath(prefix, str));
+}
+
+/*
+    @returns the value at path, or nullptr if there is no value there and required is false. A substitution that fails
+    to resolve throws either way, as it does for the ConfigFile getters.
+*/
+const HSimpleValue * ConfigView::findValue(std::string const& str, bool required) const {
+    LookupError error;
+    std::variant<HTree*, HArray*, HSimpleValue*> res = parser->findByPath(str, error, tree);
+    if (error == LOOKUP_UNRESOLVED) {
+        throw std::runtime_error("Error: the substitution at path " + joinPath(prefix, str) + " could not be resolved");
+    } else if (error == LOOKUP_OK && std::holds_alternative<HSimpleValue*>(res)) {
+        return std::get<HSimpleValue*>(res);
+    } else if (required) {
+        throw std::runtime_error("Error: the path, " + joinPath(prefix, str) + " doesn't exist in the configuration");
+    }
+    return nullptr;
+}
+
+const CompiledNode * ConfigView::findCompiled(std::string const& str, bool required) const {
+    const CompiledNode * node = config->compiled->find(str, compiledNode);
+    if (!node && required) {
+        throw std::runtime_error("Error: the path, " + joinPath(prefix, str) + " doesn't exist in the configuration");
+    }
+    return node;
+}
+
+std::string ConfigView::getStringByPath(std::string const& str) const {
+    if (compiledNode) {
+        return compiledGetString(config->compiled, findCompiled(str, false), joinPath(prefix, str));
+    }
+    return std::visit(simpleValueAsString, findValue(str, true)->svalue);
+}
+
+std::string ConfigView::getStringByPath(std::string const& str, std::string const& defaultVal) const {
+    if (compiledNode) {
+        const CompiledNode * node = findCompiled(str, false);
+        return (node && node->type != COMPILED_OBJECT && node->type != COMPILED_ARRAY) ? config->compiled->valueAsString(node) : defaultVal;
+    }
+    const HSimpleValue * value = findValue(str, false);
+    return value ? std::visit(simpleValueAsString, value->svalue) : defaultVal;
+}
+
+bool ConfigView::getBoolByPath(std::string const& str) const {
+    if (compiledNode) {
+        return compiledAsBool(config->compiled, findCompiled(str, true), joinPath(prefix, str));
+    }
+    return simpleAsBool(findValue(str, true), joinPath(prefix, str));
+}
+
+bool ConfigView::getBoolByPath(std::string const& str, bool defaultVal) const {
+    if (compiledNode) {
+        const CompiledNode * node = findCompiled(str, false);
+        return node ? compiledAsBool(config->compiled, node, joinPath(prefix, str)) : defaultVal;
+    }
+    const HSimpleValue * value = findValue(str, false);
+    return value ? simpleAsBool(value, joinPath(prefix, str)) : defaultVal;
+}
+
+double ConfigView::getDoubleByPath(std::string const& str) const {
+    if (compiledNode) {
+        return compiledAsDouble(config->compiled, findCompiled(str, true), joinPath(prefix, str));
+    }
+    return simpleAsDouble(findValue(str, true), joinPath(prefix, str));
+}
+
+double ConfigView::getDoubleByPath(std::string const& str, double defaultVal) const {
+    if (compiledNode) {
+        const CompiledNode * node = findCompiled(str, false);
+        return node ? compiledAsDouble(config->compiled, node, joinPath(prefix, str)) : defaultVal;
+    }
+    const HSimpleValue * value = findValue(str, false);
+    return value ? simpleAsDouble(value, joinPath(prefix, str)) : defaultVal;
+}
+
+int ConfigView::getIntByPath(std::string const& str) const {
+    if (compiledNode) {
+        return compiledAsInt(config->compiled, findCompiled(str, true), joinPath(prefix, str));
+    }
+    return simpleAsInt(findValue(str, true), joinPath(prefix, str));
+}
+
+int ConfigView::getIntByPath(std::string const& str, int defaultVal) const {
+    if (compiledNode) {
+        const CompiledNode * node = findCompiled(str, false);
+        return node ? compiledAsInt(config->compiled, node, joinPath(prefix, str)) : defaultVal;
+    }
+    const HSimpleValue * value = findValue(str, false);
+    return value ? simpleAsInt(value, joinPath(prefix, str)) : defaultVal;
+}
+
+std::optional<std::string> ConfigView::tryGetStringByPath(std::string_view path, LookupError * error) const {
+    return tryGetFrom<std::string>(parser.get(), tree, config->compiled, compiledNode, path, error, simpleTryString, compiledTryString);
+}
+
+std::optional<bool> ConfigView::tryGetBoolByPath(std::string_view path, LookupError * error) const {
+    return tryGetFrom<bool>(parser.get(), tree, config->compiled, compiledNode, path, error, simpleTryBool, compiledTryBool);
+}
+
+std::optional<double> ConfigView::tryGetDoubleByPath(std::string_view path, LookupError * error) const {
+    return tryGetFrom<double>(parser.get(), tree, config->compiled, compiledNode, path, error, simpleTryDouble, compiledTryDouble);
+}
+
+std::optional<int> ConfigView::tryGetIntByPath(std::string_view path, LookupError * error) const {
+    return tryGetFrom<int>(parser.get(), tree, config->compiled, compiledNode, path, error, simpleTryInt, compiledTryInt);
+}
+
+bool ConfigView::pathExists(std::string const& str) const {
+    if (compiledNode) {
+        return findCompiled(str, false) != nullptr;
+    }
+    LookupError error;
+    parser->findByPath(str, error, tree);
+    return error != LOOKUP_MISSING;
+}
+
+/*
+    Writes the resolved configuration in the compiled binary format, parsing the file first if runFile has not been called.
+    @returns false if the configuration is invalid or could not be written.
+*/
+bool ConfigFile::writeCompiled(std::string const& filename) {
+    if (compiled) {
+        return false;
+    }
+    if (!parserPtr && !parse()) {
         return false;
+    }
+    if (!parserPtr->lazy) {
+        return writeCompiledConfig(parserPtr->rootObject, filename);
+    }
+    // lazy substitutions stay in the tree, so write a copy holding their resolved values.
+    std::variant<HTree*, HArray*> copy;
+    try {
+        std::visit([this](auto root) { parserPtr->resolveAll(root); }, parserPtr->rootObject);
+    } catch (std::runtime_error const& e) {
+        return false;
+    }
+    if (std::holds_alternative<HTree*>(parserPtr->rootObject)) {
+        copy = std::get<HTree*>(parserPtr->rootObject)->deepCopy();
     } else {
-        return true;
+        copy = std::get<HArray*>(parserPtr->rootObject)->deepCopy();
     }
+    bool written = writeCompiledConfig(copy, filename);
+    std::visit(deleteConfigObj, copy);
+    return written;
 }
\ No newline at end of file
@@ -0,0 +1,168 @@
+#include "watcher.hpp"
+#include <cerrno>
+#include <filesystem>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+const uint32_t WATCH_EVENTS = IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE | IN_ATTRIB;
+const int WATCH_SETTLE_MS = 20; // wait this long for more events so one editor save causes a single rebuild.
+
+static std::string absolutePath(std::string const& path) {
+    return std::filesystem::absolute(path).lexically_normal().string();
+}
+
+ConfigSnapshot::ConfigSnapshot(ConfigWatcher * watcher, uint64_t slot, std::shared_ptr<const ConfigFile> * config) : watcher(watcher), slot(slot), config(config) {}
+
+ConfigSnapshot::ConfigSnapshot(ConfigSnapshot&& other) : watcher(other.watcher), slot(other.slot), config(other.config) {
+    other.watcher = nullptr;
+}
+
+ConfigSnapshot::~ConfigSnapshot() {
+    if (watcher) {
+        watcher->readers[slot].fetch_sub(1);
+    }
+}
+
+bool ConfigSnapshot::valid() const {
+    return config != nullptr;
+}
+
+const ConfigFile * ConfigSnapshot::operator->() const {
+    return config->get();
+}
+
+const ConfigFile & ConfigSnapshot::operator*() const {
+    return **config;
+}
+
+ConfigView ConfigSnapshot::view() const {
+    return ConfigView(*config);
+}
+
+ConfigView ConfigSnapshot::view(std::string const& path) const {
+    return ConfigView(*config).getView(path);
+}
+
+ConfigWatcher::ConfigWatcher(std::string const& filename) : filename(filename) {
+    inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    watchedFiles.insert(absolutePath(filename));
+    std::string dir = std::filesystem::path(absolutePath(filename)).parent_path().string();
+    int wd = inotify_add_watch(inotifyFd, dir.c_str(), WATCH_EVENTS);
+    if (wd >= 0) {
+        watchedDirs[wd] = dir;
+    }
+    rebuild();
+    worker = std::thread(&ConfigWatcher::run, this);
+}
+
+ConfigWatcher::~ConfigWatcher() {
+    uint64_t one = 1;
+    ssize_t written = write(wakeFd, &one, sizeof(one));
+    (void) written;
+    worker.join();
+    close(inotifyFd);
+    close(wakeFd);
+    delete current.load();
+}
+
+/*
+    Registers the caller as a reader and returns the current configuration. Never blocks.
+*/
+ConfigSnapshot ConfigWatcher::acquire() {
+    uint64_t slot = epoch.load() & 1;
+    readers[slot].fetch_add(1);
+    return ConfigSnapshot(this, slot, current.load());
+}
+
+size_t ConfigWatcher::getGeneration() const {
+    return generation.load();
+}
+
+size_t ConfigWatcher::getFailures() const {
+    return failures.load();
+}
+
+/*
+    Loads a new configuration from disk, reusing unchanged includes through the shared include cache, and publishes it.
+    @returns false if the new configuration is invalid, in which case the current one stays published.
+*/
+bool ConfigWatcher::rebuild() {
+    std::shared_ptr<ConfigFile> next = std::make_shared<ConfigFile>(filename, includeCache);
+    if (!next->reload()) {
+        failures++;
+        return false;
+    }
+    watchFiles(next.get());
+    publish(new std::shared_ptr<const ConfigFile>(std::move(next)));
+    return true;
+}
+
+/*
+    Swaps in next and releases the previous configuration once no snapshot can still be using it.
+*/
+void ConfigWatcher::publish(std::shared_ptr<const ConfigFile> * next) {
+    std::shared_ptr<const ConfigFile> * previous = current.exchange(next);
+    generation++;
+    for (int i = 0; i < 2; i++) {
+        uint64_t drained = epoch.fetch_add(1) & 1;
+        while (readers[drained].load() != 0) {
+            std::this_thread::yield();
+        }
+    }
+    delete previous;
+}
+
+/*
+    Adds watches for the directories of every file the configuration included, so that edits, atomic renames and
+    newly created optional includes are all noticed.
+*/
+void ConfigWatcher::watchFiles(ConfigFile * config) {
+    for (auto const& file : config->getIncludedFiles()) {
+        std::string path = absolutePath(file);
+        if (!watchedFiles.insert(path).second) {
+            continue;
+        }
+        std::string dir = std::filesystem::path(path).parent_path().string();
+        int wd = inotify_add_watch(inotifyFd, dir.c_str(), WATCH_EVENTS);
+        if (wd >= 0) {
+            watchedDirs[wd] = dir;
+        }
+    }
+}
+
+void ConfigWatcher::run() {
+    alignas(struct inotify_event) char buffer[4096];
+    struct pollfd fds[2] = {{inotifyFd, POLLIN, 0}, {wakeFd, POLLIN, 0}};
+    while (true) {
+        if (poll(fds, 2, -1) < 0 && errno != EINTR) {
+            return;
+        }
+        if (fds[1].revents & POLLIN) {
+            return;
+        }
+        bool changed = false;
+        while (true) {
+            ssize_t length = read(inotifyFd, buffer, sizeof(buffer));
+            if (length <= 0) {
+                // drained; give the writer a moment to finish renames before rebuilding.
+                struct pollfd settle = {inotifyFd, POLLIN, 0};
+                if (poll(&settle, 1, WATCH_SETTLE_MS) > 0) continue;
+                break;
+            }
+            for (char * ptr = buffer; ptr < buffer + length; ) {
+                struct inotify_event * event = reinterpret_cast<struct inotify_event*>(ptr);
+                auto dir = watchedDirs.find(event->wd);
+                if (dir != watchedDirs.end() && event->len > 0 && watchedFiles.count(dir->second + "/" + event->name)) {
+                    changed = true;
+                }
+                ptr += sizeof(struct inotify_event) + event->len;
+            }
+        }
+        if (changed) {
+            rebuild();
+        }
+    }
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include "reader.hpp"
+
+class ConfigWatcher;
+
+/*
+    Read guard for the configuration published by a ConfigWatcher. The configuration stays alive until the snapshot is
+    destroyed, so snapshots should be short lived (one per request) to let replaced configurations be reclaimed.
+    Only the const (thread safe) ConfigFile API is exposed, since many readers share the same configuration.
+    Components that hold on to (part of) the configuration should take a ConfigView instead, which keeps the
+    configuration it reads alive on its own.
+*/
+class ConfigSnapshot {
+    private:
+        ConfigWatcher * watcher;
+        uint64_t slot;
+        std::shared_ptr<const ConfigFile> * config;
+    public:
+        ConfigSnapshot(ConfigWatcher * watcher, uint64_t slot, std::shared_ptr<const ConfigFile> * config);
+        ConfigSnapshot(ConfigSnapshot&& other);
+        ConfigSnapshot(ConfigSnapshot const&) = delete;
+        ConfigSnapshot& operator=(ConfigSnapshot const&) = delete;
+        ~ConfigSnapshot();
+        bool valid() const;
+        const ConfigFile * operator->() const;
+        const ConfigFile & operator*() const;
+        ConfigView view() const;                         // a view of the root object.
+        ConfigView view(std::string const& path) const;
+};
+
+/*
+    Watches a configuration file and every file it includes with inotify. When one of them changes, the configuration
+    is rebuilt on the watcher thread and published with an atomic pointer swap.
+
+    Readers call acquire() and never block or take a lock: they register in one of two epoch slots before loading the
+    current pointer. After a swap the watcher flips the epoch twice, waiting each time for the slot that new readers no
+    longer enter to drain, before dropping its reference to the replaced configuration. The configuration itself is
+    deleted once the last ConfigView of it is gone too.
+*/
+class ConfigWatcher {
+    friend class ConfigSnapshot;
+    private:
+        std::string filename;
+        std::shared_ptr<IncludeCache> includeCache = std::make_shared<IncludeCache>();
+        std::atomic<std::shared_ptr<const ConfigFile>*> current{nullptr};
+        std::atomic<uint64_t> epoch{0};
+        std::atomic<uint64_t> readers[2] = {{0}, {0}};
+        std::atomic<size_t> generation{0};
+        std::atomic<size_t> failures{0};
+        int inotifyFd = -1;
+        int wakeFd = -1;
+        std::unordered_map<int, std::string> watchedDirs;
+        std::unordered_set<std::string> watchedFiles;
+        std::thread worker;
+
+        void run();
+        bool rebuild();
+        void publish(std::shared_ptr<const ConfigFile> * next);
+        void watchFiles(ConfigFile * config);
+    public:
+        ConfigWatcher(std::string const& filename);
+        ~ConfigWatcher();
+        ConfigWatcher(ConfigWatcher const&) = delete;
+        ConfigWatcher& operator=(ConfigWatcher const&) = delete;
+        ConfigSnapshot acquire();
+        size_t getGeneration() const; // number of configurations published so far.
+        size_t getFailures() const;   // number of rebuilds rejected because the configuration was invalid.
+};
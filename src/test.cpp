@@ -1,5 +1,21 @@
 #define CATCH_CONFIG_MAIN
 #include <reader.hpp>
+#include <watcher.hpp>
+#include <hocon-stream.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include <catch2/catch_test_macros.hpp>
 
 HParser initWithString(std::string str) {
@@ -266,6 +282,26 @@ TEST_CASE( "Test Include" ) {
     SECTION( "include file with include" ) {
         // TODO unimplemented
     }
+
+    SECTION( "cached include resolves the same as a fresh parse" ) {
+        IncludeCache cache;
+        std::string conf = "{ refToOtherFile = { a = 2, b = ${otherValue} }, otherValue = 6, includedFile = { include file(\"../tests/test_include_file_with_sub.conf\") }}";
+        HParser first = initWithString(conf);
+        first.includeCache = &cache;
+        first.parseTokens();
+        first.resolveSubstitutions();
+        HParser second = initWithString(conf);
+        second.includeCache = &cache;
+        second.parseTokens();
+        second.resolveSubstitutions();
+        REQUIRE(cache.hits == 1);
+        REQUIRE(second.validConf);
+        REQUIRE(second.dependencies.size() == 1);
+        HTree * root1 = std::get<HTree*>(first.rootObject);
+        HTree * root2 = std::get<HTree*>(second.rootObject);
+        REQUIRE(root1->str() == root2->str());
+        REQUIRE(std::get<int>(std::get<HSimpleValue*>(std::get<HTree*>(std::get<HTree*>(root2->members["includedFile"])->members["a"])->members["b"])->svalue) == 6);
+    }
 }
 
 TEST_CASE( "Key-value separators" ) {
@@ -673,6 +709,1645 @@ TEST_CASE( "Merging Substitutions" ) {
 
 // api method testing.
 
+/*
+    Runs a test case in a directory of its own under the system temporary directory, so the files it writes, and every
+    relative path it reads, stay out of tests/. The directory is removed when the test case ends. Files under tests/
+    are reached with fixture.
+*/
+struct ScratchDirectory {
+    std::filesystem::path previous;
+    std::filesystem::path path;
+
+    ScratchDirectory() : previous(std::filesystem::current_path()),
+        path(std::filesystem::temp_directory_path() / ("hocon-tests-" + std::to_string(getpid()))) {
+        std::filesystem::create_directories(path);
+        std::filesystem::current_path(path);
+    }
+
+    ~ScratchDirectory() {
+        std::filesystem::current_path(previous);
+        std::error_code ignored;
+        std::filesystem::remove_all(path, ignored);
+    }
+
+    std::string fixture(std::string const& name) const {
+        return (previous / ".." / "tests" / name).string();
+    }
+};
+
+void writeTestFile(std::string const& name, std::string const& content) {
+    std::ofstream out(name, std::ios::trunc);
+    out << content;
+}
+
+TEST_CASE( "Reload" ) {
+    ScratchDirectory scratch;
+    writeTestFile("reload_root.conf", "a = 1\nb = { include file(\"reload_changed.conf\") }\nc = { include file(\"reload_same.conf\") }\nd = ${b.x}");
+    writeTestFile("reload_changed.conf", "x = 1");
+    writeTestFile("reload_same.conf", "y = 2");
+    ConfigFile file = ConfigFile((char *) "reload_root.conf");
+    REQUIRE(file.reload());
+    REQUIRE(file.getIntByPath("d") == 1);
+    REQUIRE(file.getIncludedFiles() == std::vector<std::string>{"reload_changed.conf", "reload_same.conf"});
+
+    SECTION( "changed include is picked up" ) {
+        writeTestFile("reload_changed.conf", "x = 22");
+        REQUIRE(file.reload());
+        REQUIRE(file.getIntByPath("b.x") == 22);
+        REQUIRE(file.getIntByPath("d") == 22);
+        REQUIRE(file.getIntByPath("c.y") == 2);
+    }
+
+    SECTION( "invalid reload keeps the previous configuration" ) {
+        writeTestFile("reload_changed.conf", "x = ${missing}");
+        REQUIRE_FALSE(file.reload());
+        REQUIRE(file.getIntByPath("d") == 1);
+    }
+}
+
+bool waitForGeneration(ConfigWatcher& watcher, size_t generation) {
+    for (int i = 0; i < 500 && watcher.getGeneration() < generation; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return watcher.getGeneration() >= generation;
+}
+
+TEST_CASE( "ConfigWatcher" ) {
+    ScratchDirectory scratch;
+    writeTestFile("watch_root.conf", "a = 1\nb = { include file(\"watch_include.conf\") }");
+    writeTestFile("watch_include.conf", "x = 1");
+    ConfigWatcher watcher("watch_root.conf");
+    REQUIRE(watcher.getGeneration() == 1);
+    REQUIRE(watcher.acquire()->getIntByPath("b.x") == 1);
+
+    SECTION( "included file change publishes a new snapshot" ) {
+        ConfigSnapshot old = watcher.acquire();
+        writeTestFile("watch_include.conf", "x = 2");
+        REQUIRE(waitForGeneration(watcher, 2));
+        REQUIRE(watcher.acquire()->getIntByPath("b.x") == 2);
+        REQUIRE(old->getIntByPath("b.x") == 1);
+    }
+
+    SECTION( "root file change publishes a new snapshot" ) {
+        writeTestFile("watch_root.conf", "a = 3\nb = { include file(\"watch_include.conf\") }");
+        REQUIRE(waitForGeneration(watcher, 2));
+        REQUIRE(watcher.acquire()->getIntByPath("a") == 3);
+    }
+
+    SECTION( "views keep their configuration after a reload" ) {
+        ConfigView included = watcher.acquire().view("b");
+        writeTestFile("watch_include.conf", "x = 2");
+        REQUIRE(waitForGeneration(watcher, 2));
+        REQUIRE(watcher.acquire().view("b").getIntByPath("x") == 2);
+        REQUIRE(included.getIntByPath("x") == 1);
+    }
+
+    SECTION( "invalid change keeps the current snapshot" ) {
+        writeTestFile("watch_include.conf", "x = ${missing}");
+        for (int i = 0; i < 500 && watcher.getFailures() == 0; i++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        REQUIRE(watcher.getFailures() >= 1);
+        REQUIRE(watcher.acquire()->getIntByPath("b.x") == 1);
+    }
+}
+
+TEST_CASE( "Compiled config" ) {
+    ScratchDirectory scratch;
+    HParser parser = initWithString("a = 2\nb { c = text, d = 1.5, e = yes }\nf = [1, 2]\ng = ${b.c}");
+    parser.parseTokens();
+    parser.resolveSubstitutions();
+    REQUIRE(writeCompiledConfig(parser.rootObject, "test_compiled.hcb"));
+    ConfigFile file = ConfigFile((char *) "test_compiled.hcb", COMPILED);
+
+    SECTION( "typed getters read from the mapped file" ) {
+        REQUIRE(file.getIntByPath("a") == 2);
+        REQUIRE(file.getStringByPath("a") == "2");
+        REQUIRE(file.getStringByPath("b.c") == "text");
+        REQUIRE(file.getDoubleByPath("b.d") == 1.5);
+        REQUIRE(file.getBoolByPath("b.e") == true);
+        REQUIRE(file.getStringByPath("g") == "text");
+    }
+
+    SECTION( "missing paths" ) {
+        REQUIRE(file.pathExists("b.c"));
+        REQUIRE(file.pathExists("f"));
+        REQUIRE_FALSE(file.pathExists("b.x"));
+        REQUIRE_FALSE(file.pathExists("a.b"));
+        REQUIRE(file.getIntByPath("b.x", 7) == 7);
+        REQUIRE_THROWS(file.getStringByPath("b"));
+    }
+
+    SECTION( "compiling a configuration file" ) {
+        std::string fixture = scratch.fixture("test_include_file.conf");
+        ConfigFile source = ConfigFile(&fixture[0]);
+        REQUIRE(source.writeCompiled("test_compiled_file.hcb"));
+        ConfigFile out = ConfigFile((char *) "test_compiled_file.hcb", COMPILED);
+        REQUIRE(out.getIntByPath("c") == 2);
+        REQUIRE(out.getStringByPath("d") == "value");
+    }
+
+    SECTION( "node ranges and string offsets are checked at load" ) {
+        std::ifstream in("test_compiled.hcb", std::ios::binary);
+        std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        REQUIRE(CompiledConfig("test_compiled.hcb").valid);
+        auto corrupt = [&bytes](uint32_t node, size_t field, uint32_t value) {
+            std::string copy = bytes;
+            size_t at = sizeof(CompiledHeader) + node * sizeof(CompiledNode) + field;
+            std::memcpy(&copy[at], &value, sizeof(value));
+            writeTestFile("test_corrupt.hcb", copy);
+            return CompiledConfig("test_corrupt.hcb").valid;
+        };
+        REQUIRE_FALSE(corrupt(0, offsetof(CompiledNode, count), 1000));
+        REQUIRE_FALSE(corrupt(0, offsetof(CompiledNode, first), 0));
+        REQUIRE_FALSE(corrupt(1, offsetof(CompiledNode, keyOffset), 1 << 20));
+        REQUIRE_FALSE(corrupt(1, offsetof(CompiledNode, keyLength), 1 << 20));
+        REQUIRE_FALSE(corrupt(1, offsetof(CompiledNode, type), 99));
+        REQUIRE(corrupt(1, offsetof(CompiledNode, keyLength), 0));
+    }
+}
+
+TEST_CASE( "Path handles" ) {
+    ScratchDirectory scratch;
+    writeTestFile("handles.conf", "a { b { c = 5, d = \"7\", e = yes, f = 2.5 } }\ng = ${a.b.c}");
+    ConfigFile file = ConfigFile((char *) "handles.conf");
+    REQUIRE(file.reload());
+    ConfigPath c = file.compile("a.b.c");
+    ConfigPath missing = file.compile("a.b.x");
+
+    SECTION( "typed getters accept a handle" ) {
+        REQUIRE(file.getIntByPath(c) == 5);
+        REQUIRE(file.getStringByPath(c) == "5");
+        REQUIRE(file.getIntByPath(file.compile("a.b.d")) == 7);
+        REQUIRE(file.getBoolByPath(file.compile("a.b.e")) == true);
+        REQUIRE(file.getDoubleByPath(file.compile("a.b.f")) == 2.5);
+        REQUIRE(file.getIntByPath(file.compile("g")) == 5);
+        REQUIRE(file.getIntByPath(missing, 3) == 3);
+        REQUIRE_THROWS(file.getIntByPath(missing));
+    }
+
+    SECTION( "string paths and handles fail with the same error" ) {
+        auto message = [](auto get) {
+            try {
+                get();
+            } catch (std::runtime_error const& e) {
+                return std::string(e.what());
+            }
+            return std::string("no runtime_error");
+        };
+        REQUIRE(message([&] { file.getIntByPath("a.b.x"); }) == message([&] { file.getIntByPath(missing); }));
+        REQUIRE(message([&] { file.getDoubleByPath("a.b.x"); }) == message([&] { file.getDoubleByPath(missing); }));
+        REQUIRE(message([&] { file.getIntByPath("a.b.x"); }).find("getIntByPath") != std::string::npos);
+        REQUIRE(message([&] { file.getDoubleByPath("a.b.x"); }).find("getDoubleByPath") != std::string::npos);
+        REQUIRE(message([&] { file.getIntByPath("a.b.e"); }) == "Error: getIntByPath encountered an invalid value 'yes' at path a.b.e");
+        REQUIRE(message([&] { file.getIntByPath(file.compile("a.b.e")); }) == "Error: getIntByPath encountered an invalid value 'yes' at path a.b.e");
+    }
+
+    SECTION( "handles survive a reload" ) {
+        writeTestFile("handles.conf", "a { b { c = 6 } }");
+        REQUIRE(file.reload());
+        REQUIRE(file.getIntByPath(c) == 6);
+        REQUIRE(file.getIntByPath(missing, 3) == 3);
+    }
+
+    SECTION( "handles work with another configuration" ) {
+        HParser parser = initWithString("a { b { c = 9 } }");
+        parser.parseTokens();
+        parser.resolveSubstitutions();
+        REQUIRE(writeCompiledConfig(parser.rootObject, "test_handles.hcb"));
+        ConfigFile compiled = ConfigFile((char *) "test_handles.hcb", COMPILED);
+        REQUIRE(compiled.getIntByPath(c) == 9);
+        REQUIRE(compiled.getIntByPath(compiled.compile("a.b.c")) == 9);
+        REQUIRE(compiled.getIntByPath(missing, 3) == 3);
+    }
+}
+
+struct BoundSettings {
+    int port;
+    std::string host;
+    double ratio;
+    bool verbose;
+    int workers;
+    std::string name;
+
+    static std::vector<ConfigField<BoundSettings>> configFields() {
+        return {
+            {"server.http.port", &BoundSettings::port},
+            {"server.http.host", &BoundSettings::host, "localhost"},
+            {"server.ratio", &BoundSettings::ratio, 0.5},
+            {"verbose", &BoundSettings::verbose, false},
+            {"server.workers", &BoundSettings::workers, 4},
+            {"name", &BoundSettings::name},
+        };
+    }
+};
+
+TEST_CASE( "Struct binding" ) {
+    ScratchDirectory scratch;
+    SECTION( "fields are filled in one call" ) {
+        writeTestFile("bind.conf", "server { http { port = 8080, host = example.com }, ratio = 0.25 }\nverbose = yes\nname = ${server.http.host}");
+        ConfigFile file = ConfigFile((char *) "bind.conf");
+        REQUIRE(file.reload());
+        BindResult<BoundSettings> result = file.bind<BoundSettings>();
+        REQUIRE(result.ok());
+        REQUIRE(result.value.port == 8080);
+        REQUIRE(result.value.host == "example.com");
+        REQUIRE(result.value.ratio == 0.25);
+        REQUIRE(result.value.verbose == true);
+        REQUIRE(result.value.workers == 4);
+        REQUIRE(result.value.name == "example.com");
+
+        REQUIRE(file.writeCompiled("test_bind.hcb"));
+        ConfigFile compiled = ConfigFile((char *) "test_bind.hcb", COMPILED);
+        BindResult<BoundSettings> fromCompiled = compiled.bind<BoundSettings>();
+        REQUIRE(fromCompiled.ok());
+        REQUIRE(fromCompiled.value.port == 8080);
+        REQUIRE(fromCompiled.value.name == "example.com");
+    }
+
+    SECTION( "errors are collected" ) {
+        writeTestFile("bind.conf", "server { http { port = eighty }, workers = { n = 2 } }\nverbose = maybe");
+        ConfigFile file = ConfigFile((char *) "bind.conf");
+        REQUIRE(file.reload());
+        BindResult<BoundSettings> result = file.bind<BoundSettings>();
+        REQUIRE(result.errors.size() == 4);
+        REQUIRE(result.errors[0].path == "server.http.port");
+        REQUIRE(result.errors[1].path == "verbose");
+        REQUIRE(result.errors[2].path == "server.workers");
+        REQUIRE(result.errors[3].path == "name");
+        REQUIRE(result.errors[3].message == "required path does not exist");
+        REQUIRE(result.value.host == "localhost");
+        REQUIRE(result.value.workers == 4);
+    }
+}
+
+TEST_CASE( "Lazy substitutions" ) {
+    ScratchDirectory scratch;
+    writeTestFile("lazy.conf", "base { host = example, port = 80 }\nurl = ${base.host} ${base.port}\nserver = ${base} { port = 8080 }\n"
+        "list = [1, ${base.port}]\nmaybe = ${?missing}\nbroken = ${missing}\npath = a\npath = ${path}b");
+    ConfigFile file = ConfigFile((char *) "lazy.conf");
+    file.setResolveMode(LAZY);
+    REQUIRE(file.reload()); // broken is never read, so it does not fail the load.
+
+    SECTION( "substitutions resolve on first access" ) {
+        REQUIRE(file.getStringByPath("url") == "example 80");
+        REQUIRE(file.getStringByPath("url") == "example 80");
+        REQUIRE(file.getIntByPath("server.port") == 8080);
+        REQUIRE(file.getStringByPath("server.host") == "example");
+        REQUIRE(file.getStringByPath("path") == "ab");
+        REQUIRE_FALSE(file.pathExists("maybe"));
+        REQUIRE(file.getIntByPath("maybe", 3) == 3);
+    }
+
+    SECTION( "a failed substitution throws when read" ) {
+        REQUIRE_THROWS(file.getStringByPath("broken"));
+        REQUIRE_THROWS(file.getStringByPath("broken", "default"));
+        REQUIRE(file.getIntByPath("base.port") == 80);
+    }
+
+    SECTION( "subtrees and compiled output hold resolved values" ) {
+        ConfigFile server = file.getConfig("server");
+        REQUIRE(server.getIntByPath("port") == 8080);
+        REQUIRE(server.getStringByPath("host") == "example");
+        REQUIRE_FALSE(file.writeCompiled("test_lazy.hcb"));
+        writeTestFile("lazy.conf", "base { port = 80 }\nlist = [1, ${base.port}]\nmaybe = ${?missing}");
+        REQUIRE(file.reload());
+        REQUIRE(file.writeCompiled("test_lazy.hcb"));
+        ConfigFile compiled = ConfigFile((char *) "test_lazy.hcb", COMPILED);
+        REQUIRE(compiled.getIntByPath("base.port") == 80);
+        REQUIRE_FALSE(compiled.pathExists("maybe"));
+    }
+
+    SECTION( "concurrent first access resolves once" ) {
+        std::atomic<int> mismatches{0};
+        std::vector<std::thread> readers;
+        for (int t = 0; t < 16; t++) {
+            readers.emplace_back([&file, &mismatches]() {
+                if (file.getStringByPath("url") != "example 80") mismatches++;
+                if (file.getIntByPath("server.port") != 8080) mismatches++;
+            });
+        }
+        for (auto& reader : readers) {
+            reader.join();
+        }
+        REQUIRE(mismatches.load() == 0);
+    }
+}
+
+TEST_CASE( "Concurrent reads" ) {
+    ScratchDirectory scratch;
+    writeTestFile("concurrent.conf", "a = 1\nb { c = text, d = 1.5, e { f = true } }\nlist = [1, 2, 3]\ng = ${b.c}");
+    ConfigFile file = ConfigFile((char *) "concurrent.conf");
+    REQUIRE(file.reload());
+    const ConfigFile& shared = file;
+
+    std::atomic<int> mismatches{0};
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 64; t++) {
+        readers.emplace_back([&shared, &mismatches]() {
+            for (int i = 0; i < 200; i++) {
+                if (shared.getIntByPath("a") != 1) mismatches++;
+                if (shared.getStringByPath("b.c") != "text") mismatches++;
+                if (shared.getDoubleByPath("b.d") != 1.5) mismatches++;
+                if (!shared.getBoolByPath("b.e.f")) mismatches++;
+                if (shared.getStringByPath("g") != "text") mismatches++;
+                if (shared.getIntByPath("b.missing", 5) != 5) mismatches++;
+                if (shared.pathExists("b.x") || !shared.pathExists("list")) mismatches++;
+                if (shared.getConfig("b").getStringByPath("c") != "text") mismatches++;
+            }
+        });
+    }
+    for (auto& reader : readers) {
+        reader.join();
+    }
+    REQUIRE(mismatches.load() == 0);
+}
+
+class RecordingHandler : public HEventHandler {
+    public:
+        std::vector<std::string> events;
+        void onObjectStart() override { events.push_back("{"); }
+        void onArrayStart() override { events.push_back("["); }
+        void onEnd() override { events.push_back("end"); }
+        void onKey(std::string const& key) override { events.push_back("key " + key); }
+        void onScalar(std::variant<int, double, bool, std::string> const& value) override {
+            switch (value.index()) {
+                case 0: events.push_back("int " + std::to_string(std::get<int>(value))); break;
+                case 1: events.push_back("double " + std::to_string(std::get<double>(value))); break;
+                case 2: events.push_back(std::get<bool>(value) ? "true" : "false"); break;
+                case 3: events.push_back("string " + std::get<std::string>(value)); break;
+            }
+        }
+        void onNull() override { events.push_back("null"); }
+        void onSubstitution(std::string const& expression) override { events.push_back("sub " + expression); }
+        void onError(int, std::string const&) override { events.push_back("error"); }
+};
+
+TEST_CASE( "Streaming events" ) {
+    ScratchDirectory scratch;
+    SECTION( "objects, arrays and scalars" ) {
+        RecordingHandler handler;
+        HEventParser parser(handler, SUBSTITUTIONS_REPORT);
+        REQUIRE(parser.parseString("a.b = 1\nc { d = [1.5, true, x] }\ne = some text 2\n"));
+        std::vector<std::string> expected = {"{", "key a", "{", "key b", "int 1", "end", "key c", "{", "key d", "[",
+            "double 1.500000", "true", "string x", "end", "end", "key e", "string some text 2", "end"};
+        REQUIRE(handler.events == expected);
+    }
+
+    SECTION( "substitutions follow the policy" ) {
+        RecordingHandler reported;
+        HEventParser reportParser(reported, SUBSTITUTIONS_REPORT);
+        REQUIRE(reportParser.parseString("a = ${b.c} suffix"));
+        REQUIRE(reported.events[2] == "sub ${b.c} suffix");
+
+        RecordingHandler rejected;
+        HEventParser rejectParser(rejected, SUBSTITUTIONS_REJECT);
+        REQUIRE_FALSE(rejectParser.parseString("a = 1\nb = ${a}"));
+        REQUIRE(rejected.events.back() == "error");
+    }
+
+    SECTION( "values that need the document are rejected" ) {
+        RecordingHandler handler;
+        HEventParser parser(handler, SUBSTITUTIONS_REPORT);
+        REQUIRE_FALSE(parser.parseString("a = [1]\na += 2"));
+        REQUIRE_FALSE(parser.parseString("a = {b = 1"));
+        REQUIRE_FALSE(parser.parseString("\"\" = 1"));
+    }
+
+    SECTION( "includes and files are streamed in place" ) {
+        writeTestFile("stream_root.conf", "a = 1\nb { include file(\"" + scratch.fixture("test_include_file.conf") + "\") }\nc = [x, y]");
+        RecordingHandler handler;
+        HEventParser parser(handler, SUBSTITUTIONS_REJECT);
+        REQUIRE(parser.parseFile("stream_root.conf"));
+        std::vector<std::string> expected = {"{", "key a", "int 1", "key b", "{", "key c", "int 2", "key d", "string value",
+            "end", "key c", "[", "string x", "string y", "end", "end"};
+        REQUIRE(handler.events == expected);
+        REQUIRE_FALSE(parser.parseFile("stream_missing.conf"));
+    }
+}
+
+TEST_CASE( "JSON fast path" ) {
+    ScratchDirectory scratch;
+    SECTION( "detected JSON builds the same tree as the HOCON parser" ) {
+        std::string json = "{\"a\": 1, \"b\": {\"c\": [1.5, -2, 1e3, true, false, null], \"d\": \"text value\"},\n \"e.f\": [], \"g\": {}}";
+        std::optional<std::variant<HTree*, HArray*>> root = HJsonParser(json, false).run();
+        REQUIRE(root.has_value());
+        HParser hocon = initWithString(json);
+        hocon.parseTokens();
+        REQUIRE(std::get<HTree*>(*root)->str() == std::get<HTree*>(hocon.rootObject)->str());
+        delete std::get<HTree*>(*root);
+        delete std::get<HTree*>(hocon.rootObject);
+
+        std::optional<std::variant<HTree*, HArray*>> arr = HJsonParser("[1, {\"a\": \"b\"}]", false).run();
+        REQUIRE(arr.has_value());
+        REQUIRE(std::holds_alternative<HArray*>(*arr));
+        delete std::get<HArray*>(*arr);
+    }
+
+    SECTION( "input the HOCON parser reads differently is left to it" ) {
+        REQUIRE_FALSE(HJsonParser("a = 1", false).run().has_value());
+        REQUIRE_FALSE(HJsonParser("{\"a\": \"x\\ny\"}", false).run().has_value());
+        REQUIRE_FALSE(HJsonParser("{\"\": 1}", false).run().has_value());
+        REQUIRE_FALSE(HJsonParser("{\"a\": {\"b\": 1}, \"a\": {\"c\": 2}}", false).run().has_value());
+        REQUIRE_FALSE(HJsonParser("{\"a\": 12345678901}", false).run().has_value());
+        REQUIRE_FALSE(HJsonParser("{\"a\": 1,}", false).run().has_value());
+        REQUIRE_FALSE(HJsonParser("{\"a\": ${b}}", false).run().has_value());
+    }
+
+    SECTION( "strict mode decodes escapes and replaces duplicates" ) {
+        std::optional<std::variant<HTree*, HArray*>> root = HJsonParser("{\"a\": \"x\\n\\u00e9\\ud83d\\ude00\", \"b\": 1, \"b\": 12345678901}", true).run();
+        REQUIRE(root.has_value());
+        HTree * tree = std::get<HTree*>(*root);
+        REQUIRE(std::get<std::string>(std::get<HSimpleValue*>(tree->members.at("a"))->svalue) == "x\n\u00e9\U0001F600");
+        REQUIRE(std::get<double>(std::get<HSimpleValue*>(tree->members.at("b"))->svalue) == 12345678901.0);
+        REQUIRE(tree->memberOrder.size() == 2);
+        delete tree;
+        HJsonParser invalid("{\"a\": 1\n\"b\": 2}", true);
+        REQUIRE_FALSE(invalid.run().has_value());
+        REQUIRE(invalid.getDiagnostic().line == 2);
+    }
+
+    SECTION( "loading" ) {
+        writeTestFile("fast.json", "{\"server\": {\"port\": 8080, \"host\": \"example\"}, \"ratio\": 0.5}");
+        ConfigFile detected = ConfigFile((char *) "fast.json");
+        REQUIRE(detected.reload());
+        REQUIRE(detected.getIntByPath("server.port") == 8080);
+        REQUIRE(detected.getStringByPath("server.host") == "example");
+        ConfigFile strict = ConfigFile((char *) "fast.json", JSON);
+        REQUIRE(strict.reload());
+        REQUIRE(strict.getDoubleByPath("ratio") == 0.5);
+
+        writeTestFile("fast.json", "{\"server\": {\"port\": 8080}, \"copy\": ${server.port}}");
+        REQUIRE(detected.reload());
+        REQUIRE(detected.getIntByPath("copy") == 8080);
+        REQUIRE_FALSE(strict.reload());
+        REQUIRE(strict.getDoubleByPath("ratio") == 0.5);
+    }
+
+    SECTION( "runFile prints JSON like any other configuration" ) {
+        writeTestFile("fast.json", "{\"a\": 1, \"b\": {\"c\": [1, 2]}}");
+        writeTestFile("slow.conf", "a = 1\nb { c = [1, 2] }");
+        auto printed = [](const char * name) {
+            std::ostringstream text;
+            std::streambuf * out = std::cout.rdbuf(text.rdbuf());
+            ConfigFile((char *) name).runFile();
+            std::cout.rdbuf(out);
+            return text.str();
+        };
+        std::string json = printed("fast.json");
+        REQUIRE(json.find("Resolved Object String") != std::string::npos);
+        REQUIRE(json == printed("slow.conf"));
+    }
+}
+
+TEST_CASE( "Rendering" ) {
+    ScratchDirectory scratch;
+    writeTestFile("render.conf", "a = 1\nb { c = [1, {x = y}, []], d = {} }\ne = text\nf = ${b.c}");
+    ConfigFile file = ConfigFile((char *) "render.conf");
+    REQUIRE(file.reload());
+
+    SECTION( "pretty HOCON keeps the str() layout" ) {
+        HParser parser = initWithString("a = 1\nb { c = [1, {x = y}, []], d = {} }\ne = text");
+        parser.parseTokens();
+        std::string expected = "{\n    a : 1,\n    b : {\n        c : [ \n            1,\n            {\n                x : \"y\"\n"
+            "            },\n            []\n        ],\n        d : {}\n    },\n    e : \"text\"\n}";
+        HTree * root = std::get<HTree*>(parser.rootObject);
+        REQUIRE(root->str() == expected);
+        std::ostringstream out;
+        HWriter(out, RENDER_HOCON).write(root);
+        REQUIRE(out.str() == expected);
+        delete root;
+    }
+
+    SECTION( "JSON and compact JSON" ) {
+        std::ostringstream pretty;
+        file.render(pretty, RENDER_JSON);
+        REQUIRE(pretty.str() == "{\n    \"a\": 1,\n    \"b\": {\n        \"c\": [\n            1,\n            {\n                \"x\": \"y\"\n"
+            "            },\n            []\n        ],\n        \"d\": {}\n    },\n    \"e\": \"text\",\n    \"f\": [\n        1,\n"
+            "        {\n            \"x\": \"y\"\n        },\n        []\n    ]\n}");
+        std::ostringstream compact;
+        file.render(compact, RENDER_JSON_COMPACT);
+        REQUIRE(compact.str() == "{\"a\":1,\"b\":{\"c\":[1,{\"x\":\"y\"},[]],\"d\":{}},\"e\":\"text\",\"f\":[1,{\"x\":\"y\"},[]]}");
+    }
+
+    SECTION( "strings are escaped and lazy substitutions written as their value" ) {
+        std::optional<std::variant<HTree*, HArray*>> root = HJsonParser("[\"q\\\"\\\\\\n\\u0001\", 1.5, -2, true, null]", true).run();
+        std::string out;
+        HWriter(out, RENDER_JSON_COMPACT).write(std::get<HArray*>(*root));
+        REQUIRE(out == "[\"q\\\"\\\\\\n\\u0001\",1.5,-2,true,null]");
+        delete std::get<HArray*>(*root);
+
+        file.setResolveMode(LAZY);
+        REQUIRE(file.reload());
+        std::ostringstream lazy;
+        file.render(lazy, RENDER_JSON_COMPACT);
+        REQUIRE(lazy.str() == "{\"a\":1,\"b\":{\"c\":[1,{\"x\":\"y\"},[]],\"d\":{}},\"e\":\"text\",\"f\":[1,{\"x\":\"y\"},[]]}");
+    }
+
+    SECTION( "unresolved substitutions have no JSON form" ) {
+        HParser parser = initWithString("a = 1\nb = ${a}");
+        parser.parseTokens();
+        std::string out;
+        HTree * root = std::get<HTree*>(parser.rootObject);
+        REQUIRE_THROWS(HWriter(out, RENDER_JSON).write(root));
+        delete root;
+    }
+}
+
+TEST_CASE( "Load statistics" ) {
+    ScratchDirectory scratch;
+    writeTestFile("stats_root.conf", "a = 1\nb = { include file(\"stats_include.conf\") }\nc = ${b.x}\nd = [${a}, 2]");
+    writeTestFile("stats_include.conf", "x = 5\ny = ${x}");
+    ConfigFile file = ConfigFile((char *) "stats_root.conf");
+
+    SECTION( "disabled by default" ) {
+        REQUIRE(file.reload());
+        LoadStats const& stats = file.getStats();
+        REQUIRE(stats.events.empty());
+        for (int c = 0; c < COUNTER_COUNT; c++) {
+            REQUIRE(stats.counters[c] == 0);
+        }
+    }
+
+    SECTION( "phases and counters" ) {
+        file.setStatsEnabled(true);
+        REQUIRE(file.reload());
+        REQUIRE(file.getIntByPath("c") == 5);
+        LoadStats const& stats = file.getStats();
+        REQUIRE(stats.counters[COUNT_TOKENS] > 0);
+        REQUIRE(stats.counters[COUNT_NODES] > 0);
+        REQUIRE(stats.counters[COUNT_DEEP_COPIES] > 0);
+        REQUIRE(stats.counters[COUNT_STACK_ENTRIES] >= 5);
+        REQUIRE(stats.counters[COUNT_PATH_STEPS] > 0);
+        REQUIRE(stats.counters[COUNT_SUBSTITUTIONS] >= 3);
+        REQUIRE(stats.phaseNs[PHASE_PARSE] >= stats.phaseNs[PHASE_INCLUDE_PARSE]);
+        bool fetched = false;
+        for (auto const& event : stats.events) {
+            fetched = fetched || (event.phase == PHASE_INCLUDE_FETCH && event.detail == "stats_include.conf");
+        }
+        REQUIRE(fetched);
+        REQUIRE(stats.str().find("include_fetch_ms: ") != std::string::npos);
+
+        std::ostringstream trace;
+        stats.writeTrace(trace);
+        REQUIRE(trace.str().rfind("{\"traceEvents\":[", 0) == 0);
+        REQUIRE(trace.str().find("\"name\":\"resolve\",\"cat\":\"hocon\",\"ph\":\"X\"") != std::string::npos);
+        REQUIRE(trace.str().find("\"detail\":\"stats_include.conf\"") != std::string::npos);
+        REQUIRE(trace.str().find("\"substitutions\":") != std::string::npos);
+
+        file.setStatsEnabled(false);
+        REQUIRE(file.reload());
+        REQUIRE(file.getStats().counters[COUNT_NODES] == 0);
+    }
+}
+
+TEST_CASE( "Memory accounting" ) {
+    ScratchDirectory scratch;
+    // retained bytes per member for two reference corpora. the budgets leave about 15% over the current layout, so
+    // growth in any category fails here, and compaction work should lower them.
+    std::string flat;
+    for (int i = 0; i < 500; i++) {
+        flat += "member" + std::to_string(i) + " = \"value " + std::to_string(i) + "\"\n";
+    }
+    std::string nested;
+    for (int i = 0; i < 100; i++) {
+        std::string n = std::to_string(i);
+        nested += "group" + n + " { host = \"h" + n + ".example.com\", port = " + std::to_string(8000 + i) + ", tags = [a, b] }\nref" + n + " = ${group" + n + ".host}\n";
+    }
+    writeTestFile("memory_flat.conf", flat);
+    writeTestFile("memory_nested.conf", nested);
+
+    SECTION( "flat corpus" ) {
+        ConfigFile file = ConfigFile((char *) "memory_flat.conf");
+        file.setStatsEnabled(true);
+        REQUIRE(file.reload());
+        MemoryUsage retained = file.getMemoryUsage();
+        REQUIRE(retained.counts[MEM_SIMPLE_VALUES] == 500);
+        REQUIRE(retained.counts[MEM_TREES] == 1);
+        REQUIRE(retained.counts[MEM_TOKEN_PARTS] == 500);
+        REQUIRE(retained.bytes[MEM_TOKENS] > 0);
+        REQUIRE(retained.bytes[MEM_STACK] == 0); // no substitutions or includes, so the parser keeps no stack.
+        REQUIRE(retained.total() < 500 * 1200);
+        REQUIRE(file.getStats().peakMemory().total() >= retained.total());
+        REQUIRE(file.getStats().phaseMemory[PHASE_LEX].bytes[MEM_TOKENS] > 0);
+        REQUIRE(file.getStats().phaseMemory[PHASE_LEX].counts[MEM_TREES] == 0);
+    }
+
+    SECTION( "nested corpus with substitutions" ) {
+        ConfigFile file = ConfigFile((char *) "memory_nested.conf");
+        file.setStatsEnabled(true);
+        REQUIRE(file.reload());
+        MemoryUsage retained = file.getMemoryUsage();
+        REQUIRE(retained.counts[MEM_TREES] == 101);
+        REQUIRE(retained.counts[MEM_ARRAYS] == 100);
+        REQUIRE(retained.counts[MEM_SUBSTITUTIONS] == 0);
+        REQUIRE(retained.bytes[MEM_STACK] > 0);
+        REQUIRE(file.getStats().phaseMemory[PHASE_PARSE].counts[MEM_SUBSTITUTIONS] == 100);
+        REQUIRE(retained.total() < 100 * 9000);
+        REQUIRE(file.getStats().peakMemory().total() >= retained.total());
+    }
+
+    SECTION( "lazy mode keeps the substitutions" ) {
+        ConfigFile file = ConfigFile((char *) "memory_nested.conf");
+        file.setResolveMode(LAZY);
+        REQUIRE(file.reload());
+        REQUIRE(file.getMemoryUsage().counts[MEM_SUBSTITUTIONS] == 100);
+        REQUIRE(file.getStats().peakMemory().total() == 0); // stats were not enabled.
+    }
+}
+
+TEST_CASE( "Concurrent loads sharing an include cache" ) {
+    ScratchDirectory scratch;
+    writeTestFile("batch_common.conf", "port = 8080\nname = common");
+    for (int i = 0; i < 8; i++) {
+        writeTestFile("batch_" + std::to_string(i) + ".conf", "base { include file(\"batch_common.conf\") }\nid = " + std::to_string(i) + "\nport = ${base.port}");
+    }
+    writeTestFile("batch_broken.conf", "base { include file(\"batch_common.conf\") }\nport = ${base.missing}");
+    std::shared_ptr<IncludeCache> cache = std::make_shared<IncludeCache>();
+
+    std::atomic<int> mismatches{0};
+    std::vector<std::thread> jobs;
+    for (int t = 0; t < 8; t++) {
+        jobs.emplace_back([t, &cache, &mismatches]() {
+            for (int round = 0; round < 20; round++) {
+                ConfigFile file = ConfigFile("batch_" + std::to_string((t + round) % 8) + ".conf", cache);
+                if (!file.reload() || !file.getDiagnostics().empty()) mismatches++;
+                if (file.getIntByPath("id") != (t + round) % 8 || file.getIntByPath("port") != 8080) mismatches++;
+                ConfigFile broken = ConfigFile(std::string("batch_broken.conf"), cache);
+                if (broken.reload() || broken.getDiagnostics().empty()) mismatches++;
+            }
+        });
+    }
+    for (auto& job : jobs) {
+        job.join();
+    }
+    REQUIRE(mismatches.load() == 0);
+    REQUIRE(cache->hits > 0);
+
+    ConfigFile missing = ConfigFile(std::string("batch_missing.conf"), cache);
+    REQUIRE_FALSE(missing.reload());
+    REQUIRE(missing.getDiagnostics().size() == 1);
+}
+
+TEST_CASE( "Load diagnostics" ) {
+    ScratchDirectory scratch;
+    // load() must not write anything, so everything printed during these loads fails the test.
+    struct Capture {
+        std::ostringstream text;
+        std::streambuf * out = std::cout.rdbuf(text.rdbuf());
+        std::streambuf * err = std::cerr.rdbuf(text.rdbuf());
+        ~Capture() {
+            std::cout.rdbuf(out);
+            std::cerr.rdbuf(err);
+        }
+    };
+    std::optional<Capture> captured;
+    captured.emplace();
+
+    SECTION( "valid file" ) {
+        writeTestFile("diag_valid.conf", "a = 1\nb = ${a}");
+        ConfigFile file = ConfigFile(std::string("diag_valid.conf"));
+        LoadResult result = file.load();
+        REQUIRE(result.ok());
+        REQUIRE(result.diagnostics.empty());
+        REQUIRE(file.getIntByPath("b") == 1);
+    }
+
+    SECTION( "unreadable file" ) {
+        ConfigFile file = ConfigFile(std::string("diag_missing.conf"));
+        LoadResult result = file.load();
+        REQUIRE(result.status == LOAD_UNREADABLE);
+        REQUIRE(result.diagnostics.size() == 1);
+        REQUIRE(result.diagnostics[0].code == DIAG_IO);
+        REQUIRE(result.diagnostics[0].file == "diag_missing.conf");
+    }
+
+    SECTION( "lexer error has an exact offset" ) {
+        writeTestFile("diag_lex.conf", "a = 1\nb = $x");
+        LoadResult result = ConfigFile(std::string("diag_lex.conf")).load();
+        REQUIRE(result.status == LOAD_INVALID);
+        REQUIRE(result.diagnostics.size() == 1);
+        Diagnostic const& diagnostic = result.diagnostics[0];
+        REQUIRE(diagnostic.code == DIAG_LEX);
+        REQUIRE(diagnostic.file == "diag_lex.conf");
+        REQUIRE(diagnostic.line == 2);
+        REQUIRE(diagnostic.offset == 10);
+        REQUIRE(diagnostic.str() == "diag_lex.conf:2: lex error: Expected { after $, got x");
+    }
+
+    SECTION( "parser error points at its line" ) {
+        writeTestFile("diag_parse.conf", "a = 1\n, = 3");
+        LoadResult result = ConfigFile(std::string("diag_parse.conf")).load();
+        REQUIRE(result.status == LOAD_INVALID);
+        REQUIRE_FALSE(result.diagnostics.empty());
+        REQUIRE(result.diagnostics[0].code == DIAG_PARSE);
+        REQUIRE(result.diagnostics[0].line == 2);
+        REQUIRE(result.diagnostics[0].offset == 6);
+    }
+
+    SECTION( "include and substitution errors" ) {
+        writeTestFile("diag_include.conf", "a { include required(file(\"diag_nope.conf\")) }");
+        LoadResult included = ConfigFile(std::string("diag_include.conf")).load();
+        REQUIRE(included.status == LOAD_INVALID);
+        REQUIRE(included.diagnostics[0].code == DIAG_INCLUDE);
+
+        writeTestFile("diag_inner.conf", "x = 1\ny = $z");
+        writeTestFile("diag_outer.conf", "a { include file(\"diag_inner.conf\") }");
+        LoadResult inner = ConfigFile(std::string("diag_outer.conf")).load();
+        REQUIRE(inner.status == LOAD_INVALID);
+        REQUIRE(inner.diagnostics[0].code == DIAG_LEX);
+        REQUIRE(inner.diagnostics[0].file == "diag_inner.conf");
+        REQUIRE(inner.diagnostics[0].line == 2);
+
+        writeTestFile("diag_sub.conf", "a = 1\nb = ${missing}");
+        LoadResult sub = ConfigFile(std::string("diag_sub.conf")).load();
+        REQUIRE(sub.status == LOAD_INVALID);
+        REQUIRE(sub.diagnostics[0].code == DIAG_SUBSTITUTION);
+        REQUIRE(sub.diagnostics[0].offset == NO_OFFSET);
+    }
+
+    SECTION( "json errors" ) {
+        writeTestFile("diag.json", "{\"a\": 1,\n\"b\": }");
+        ConfigFile file = ConfigFile((char *) "diag.json", JSON);
+        LoadResult result = file.load();
+        REQUIRE(result.status == LOAD_INVALID);
+        REQUIRE(result.diagnostics.size() == 1);
+        REQUIRE(result.diagnostics[0].code == DIAG_JSON);
+        REQUIRE(result.diagnostics[0].line == 2);
+        REQUIRE(result.diagnostics[0].file == "diag.json");
+    }
+
+    SECTION( "many errors" ) {
+        std::string text;
+        for (int i = 0; i < 2000; i++) {
+            text += "k" + std::to_string(i) + " = ${missing" + std::to_string(i) + "}\n";
+        }
+        writeTestFile("diag_many.conf", text);
+        LoadResult result = ConfigFile(std::string("diag_many.conf")).load();
+        REQUIRE(result.status == LOAD_INVALID);
+        REQUIRE(result.diagnostics.size() >= 2000);
+    }
+
+    SECTION( "failed lazy resolution throws without printing" ) {
+        writeTestFile("diag_lazy.conf", "a = ${missing}\nb = 2");
+        ConfigFile file = ConfigFile(std::string("diag_lazy.conf"));
+        file.setResolveMode(LAZY);
+        REQUIRE(file.load().ok());
+        REQUIRE_THROWS(file.getIntByPath("a"));
+        REQUIRE(file.getIntByPath("b") == 2);
+    }
+
+    std::string printed = captured->text.str();
+    captured.reset();
+    REQUIRE(printed == "");
+}
+
+TEST_CASE( "Non-throwing lookups" ) {
+    ScratchDirectory scratch;
+    writeTestFile("try.conf", "a { b = 1, s = text, n = \"42\", d = 2.5, on = yes }\nlist = [1, 2]\nc = ${a.b}\nbroken = ${missing}");
+    LookupError error;
+
+    SECTION( "values, missing paths and wrong types" ) {
+        ConfigFile file = ConfigFile((char *) "try.conf");
+        file.setResolveMode(LAZY);
+        REQUIRE(file.reload());
+        REQUIRE(file.tryGetIntByPath("a.b", &error) == 1);
+        REQUIRE(error == LOOKUP_OK);
+        REQUIRE(file.tryGetIntByPath("c") == 1);
+        REQUIRE(file.tryGetIntByPath("a.n") == 42);
+        REQUIRE(file.tryGetDoubleByPath("a.d") == 2.5);
+        REQUIRE(file.tryGetBoolByPath("a.on") == true);
+        REQUIRE(file.tryGetStringByPath("a.b") == "1");
+
+        REQUIRE_FALSE(file.tryGetIntByPath("a.x", &error));
+        REQUIRE(error == LOOKUP_MISSING);
+        REQUIRE_FALSE(file.tryGetIntByPath("a.b.c", &error)); // path through a scalar
+        REQUIRE(error == LOOKUP_MISSING);
+        REQUIRE_FALSE(file.tryGetIntByPath("x.y.z", &error));
+        REQUIRE(error == LOOKUP_MISSING);
+        REQUIRE_FALSE(file.tryGetIntByPath("", &error));
+        REQUIRE(error == LOOKUP_MISSING);
+        REQUIRE_FALSE(file.tryGetIntByPath("a.s", &error));
+        REQUIRE(error == LOOKUP_WRONG_TYPE);
+        REQUIRE_FALSE(file.tryGetStringByPath("a", &error));
+        REQUIRE(error == LOOKUP_WRONG_TYPE);
+        REQUIRE_FALSE(file.tryGetIntByPath("list", &error));
+        REQUIRE(error == LOOKUP_WRONG_TYPE);
+        REQUIRE_FALSE(file.tryGetIntByPath("broken", &error));
+        REQUIRE(error == LOOKUP_UNRESOLVED);
+
+        REQUIRE_FALSE(file.pathExists("a.b.c"));
+        REQUIRE_FALSE(file.pathExists("x.y"));
+        REQUIRE(file.pathExists("a.s"));
+    }
+
+    SECTION( "compiled configurations" ) {
+        writeTestFile("try.conf", "a { b = 1, s = text, n = \"42\", d = 2.5, on = yes }\nlist = [1, 2]");
+        ConfigFile source = ConfigFile((char *) "try.conf");
+        REQUIRE(source.writeCompiled("test_try.hcb"));
+        ConfigFile file = ConfigFile((char *) "test_try.hcb", COMPILED);
+        REQUIRE(file.tryGetIntByPath("a.b") == 1);
+        REQUIRE(file.tryGetIntByPath("a.n") == 42);
+        REQUIRE(file.tryGetBoolByPath("a.on") == true);
+        REQUIRE(file.tryGetDoubleByPath("a.d") == 2.5);
+        REQUIRE_FALSE(file.tryGetIntByPath("a.x", &error));
+        REQUIRE(error == LOOKUP_MISSING);
+        REQUIRE_FALSE(file.tryGetIntByPath("a.s", &error));
+        REQUIRE(error == LOOKUP_WRONG_TYPE);
+        REQUIRE_FALSE(file.tryGetStringByPath("list", &error));
+        REQUIRE(error == LOOKUP_WRONG_TYPE);
+    }
+}
+
+TEST_CASE( "Configuration views" ) {
+    ScratchDirectory scratch;
+    writeTestFile("view.conf", "db { host = example, port = 5432, pool { size = 4, strict = yes } }\n"
+        "server = ${db} { port = 8080 }\nlist = [1, 2]\nbroken = { x = ${missing} }");
+
+    SECTION( "getters are relative to the view" ) {
+        auto file = std::make_shared<ConfigFile>((char *) "view.conf");
+        file->setResolveMode(LAZY);
+        REQUIRE(file->reload());
+        ConfigView root(file);
+        ConfigView db = root.getView("db");
+        REQUIRE(db.path() == "db");
+        REQUIRE(db.getStringByPath("host") == "example");
+        REQUIRE(db.getIntByPath("port") == 5432);
+        REQUIRE(db.getIntByPath("missing", 7) == 7);
+        REQUIRE(db.getBoolByPath("pool.strict") == true);
+        REQUIRE(db.getDoubleByPath("pool.size") == 4.0);
+        REQUIRE(db.tryGetIntByPath("pool.size") == 4);
+        REQUIRE(db.pathExists("pool"));
+        REQUIRE_FALSE(db.pathExists("db"));
+        ConfigView pool = db.getView("pool");
+        REQUIRE(pool.path() == "db.pool");
+        REQUIRE(pool.getIntByPath("size") == 4);
+        REQUIRE(root.getView("server").getIntByPath("port") == 8080); // a lazy substitution resolved by getView
+        REQUIRE(root.getView("server").getStringByPath("host") == "example");
+        REQUIRE_THROWS(db.getIntByPath("missing"));
+        REQUIRE_THROWS(root.getView("list"));
+        REQUIRE_THROWS(root.getView("db.port"));
+        REQUIRE_THROWS(root.getView("broken").getIntByPath("x"));
+        REQUIRE(root.getView("broken").getIntByPath("y", 1) == 1);
+
+        // views share the configuration, which outlives its last other owner.
+        std::weak_ptr<ConfigFile> weak = file;
+        file.reset();
+        REQUIRE_FALSE(weak.expired());
+        REQUIRE(db.getIntByPath("port") == 5432);
+    }
+
+    SECTION( "views keep reading the tree they were made from after a reload" ) {
+        auto file = std::make_shared<ConfigFile>((char *) "view.conf");
+        file->setResolveMode(LAZY);
+        REQUIRE(file->reload());
+        ConfigView root(file);
+        ConfigView db = root.getView("db");
+        writeTestFile("view.conf", "db { host = changed, port = 1 }");
+        REQUIRE(file->reload());
+        REQUIRE(file->getIntByPath("db.port") == 1);
+        REQUIRE(db.getStringByPath("host") == "example");
+        REQUIRE(db.getIntByPath("port") == 5432);
+        REQUIRE(db.getView("pool").getIntByPath("size") == 4);
+        REQUIRE(root.getView("server").getIntByPath("port") == 8080);
+        REQUIRE(ConfigView(file).getView("db").getStringByPath("host") == "changed");
+    }
+
+    SECTION( "compiled configurations" ) {
+        writeTestFile("view.conf", "db { host = example, port = 5432, pool { size = 4 } }\nlist = [1, 2]");
+        ConfigFile source = ConfigFile((char *) "view.conf");
+        REQUIRE(source.writeCompiled("test_view.hcb"));
+        ConfigView root(std::make_shared<ConfigFile>((char *) "test_view.hcb", COMPILED));
+        ConfigView db = root.getView("db");
+        REQUIRE(db.getStringByPath("host") == "example");
+        REQUIRE(db.getView("pool").getIntByPath("size") == 4);
+        REQUIRE(db.getIntByPath("missing", 7) == 7);
+        REQUIRE_FALSE(db.tryGetIntByPath("host"));
+        REQUIRE_THROWS(root.getView("list"));
+    }
+}
+
+TEST_CASE( "Path index" ) {
+    ScratchDirectory scratch;
+    SECTION( "perfect hash" ) {
+        std::vector<std::string> keys;
+        for (int i = 0; i < 20000; i++) {
+            keys.push_back("k" + std::to_string(i % 7) + ".k" + std::to_string(i));
+        }
+        PathIndex index;
+        std::vector<uint32_t> slots;
+        REQUIRE(index.build(keys, slots));
+        REQUIRE(index.size() == keys.size());
+        std::vector<bool> used(keys.size());
+        size_t wrong = 0;
+        for (size_t i = 0; i < keys.size(); i++) {
+            wrong += slots[i] >= keys.size() || used[slots[i]] || index.find(keys[i]) != slots[i];
+            used[std::min<size_t>(slots[i], keys.size() - 1)] = true;
+        }
+        REQUIRE(wrong == 0);
+        REQUIRE(index.find("k1.k20001") == PATH_INDEX_MISS);
+        REQUIRE(index.find("") == PATH_INDEX_MISS);
+        size_t keyBytes = 0;
+        for (auto const& key : keys) {
+            keyBytes += key.size() + sizeof(uint32_t);
+        }
+        REQUIRE((index.bytes() - keyBytes) * 8 < keys.size() * 5); // under 5 bits per key besides the keys.
+
+        PathIndex empty;
+        REQUIRE(empty.build(std::vector<std::string>(), slots));
+        REQUIRE(empty.find("a") == PATH_INDEX_MISS);
+    }
+
+    SECTION( "lookups through the index" ) {
+        writeTestFile("index.conf", "a { b { c { d { e { f { g { h = 8 } } } } } } }\ns = ${a.b.c.d.e.f.g.h} x\n"
+            "list = [1, 2]\nflag = yes\nx.y = 2.5");
+        ConfigFile file = ConfigFile(std::string("index.conf"));
+        file.setPathIndexEnabled(true);
+        file.setStatsEnabled(true);
+        REQUIRE(file.reload());
+        REQUIRE(file.hasPathIndex());
+        REQUIRE(file.getIntByPath("a.b.c.d.e.f.g.h") == 8);
+        REQUIRE(file.getStringByPath("s") == "8 x");
+        REQUIRE(file.getBoolByPath("flag"));
+        REQUIRE(file.getDoubleByPath("x.y") == 2.5);
+        REQUIRE(file.getIntByPath("a.b.c.d.e.f.g.h.") == 8);
+        REQUIRE(file.getIntByPath("a.b.c.missing", 3) == 3);
+        REQUIRE(file.tryGetIntByPath("a.b.c.d.e.f.g.h") == 8);
+        REQUIRE_FALSE(file.tryGetIntByPath("a.b.c.d.e.f.g.h.i"));
+        REQUIRE(file.pathExists("a.b.c"));
+        REQUIRE(file.pathExists("list"));
+        REQUIRE_FALSE(file.pathExists("a.b.x"));
+        REQUIRE_FALSE(file.pathExists("a.b.c.d.e.f.g.h.i"));
+        REQUIRE(file.getConfig("a.b.c.d").getIntByPath("e.f.g.h") == 8);
+        REQUIRE(file.getStats().phaseMemory[PHASE_INDEX].counts[MEM_PATH_INDEX] == 13);
+    }
+
+    SECTION( "configurations that cannot be indexed" ) {
+        writeTestFile("index.conf", "a { \"b.c\" = 1, d = 2 }");
+        ConfigFile quoted = ConfigFile(std::string("index.conf"));
+        quoted.setPathIndexEnabled(true);
+        REQUIRE(quoted.reload());
+        REQUIRE_FALSE(quoted.hasPathIndex());
+        REQUIRE(quoted.getIntByPath("a.d") == 2);
+
+        writeTestFile("index.conf", "a { b = 1 }\nc = ${a.b}");
+        ConfigFile lazy = ConfigFile(std::string("index.conf"));
+        lazy.setPathIndexEnabled(true);
+        lazy.setResolveMode(LAZY);
+        REQUIRE(lazy.reload());
+        REQUIRE_FALSE(lazy.hasPathIndex());
+        REQUIRE(lazy.getIntByPath("c") == 1);
+    }
+}
+
+TEST_CASE( "Substitution variables" ) {
+    ScratchDirectory scratch;
+    setenv("HOCON_TEST_VAR", "from-env", 1);
+    writeTestFile("vars.conf", "a = ${HOCON_TEST_VAR}\nb = ${?HOCON_TEST_UNSET}\nc = ${local}\nlocal = 1\nd = ${HOCON_TEST.NESTED}");
+
+    SECTION( "the environment is the default" ) {
+        setenv("HOCON_TEST.NESTED", "nested", 1);
+        ConfigFile file = ConfigFile(std::string("vars.conf"));
+        REQUIRE(file.reload());
+        REQUIRE(file.getStringByPath("a") == "from-env");
+        REQUIRE(file.getStringByPath("d") == "nested");
+        REQUIRE_FALSE(file.pathExists("b"));
+        REQUIRE(file.getIntByPath("c") == 1);
+        unsetenv("HOCON_TEST.NESTED");
+    }
+
+    SECTION( "a variable map replaces the environment" ) {
+        auto variables = std::make_shared<VariableMap>();
+        (*variables)["HOCON_TEST_VAR"] = "from-map";
+        (*variables)["HOCON_TEST.NESTED"] = "nested";
+        (*variables)["local"] = "2";
+        ConfigFile file = ConfigFile(std::string("vars.conf"));
+        file.setVariables(variables);
+        REQUIRE(file.reload());
+        REQUIRE(file.getStringByPath("a") == "from-map");
+        REQUIRE(file.getStringByPath("d") == "nested");
+        REQUIRE(file.getIntByPath("c") == 1); // the configuration comes first.
+
+        ConfigFile lazy = ConfigFile(std::string("vars.conf"));
+        lazy.setVariables(variables);
+        lazy.setResolveMode(LAZY);
+        REQUIRE(lazy.reload());
+        REQUIRE(lazy.getStringByPath("a") == "from-map");
+
+        variables->erase("HOCON_TEST.NESTED");
+        REQUIRE_FALSE(file.reload()); // d no longer resolves, and the environment is not consulted.
+        file.setVariables(nullptr);
+        setenv("HOCON_TEST.NESTED", "nested", 1);
+        REQUIRE(file.reload());
+        REQUIRE(file.getStringByPath("a") == "from-env");
+        unsetenv("HOCON_TEST.NESTED");
+    }
+
+    SECTION( "the environment is read once per load" ) {
+        writeTestFile("vars.conf", "a = ${HOCON_TEST_VAR}");
+        ConfigFile file = ConfigFile(std::string("vars.conf"));
+        file.setResolveMode(LAZY);
+        REQUIRE(file.reload());
+        setenv("HOCON_TEST_VAR", "changed", 1);
+        REQUIRE(file.getStringByPath("a") == "changed"); // nothing needed the environment before this read.
+        writeTestFile("vars.conf", "a = ${HOCON_TEST_VAR}\nb = ${HOCON_TEST_VAR}");
+        REQUIRE(file.reload());
+        REQUIRE(file.getStringByPath("a") == "changed");
+        setenv("HOCON_TEST_VAR", "later", 1);
+        REQUIRE(file.getStringByPath("b") == "changed");
+    }
+    unsetenv("HOCON_TEST_VAR");
+}
+
+TEST_CASE( "Deep nesting" ) {
+    ScratchDirectory scratch;
+    auto nested = [](int depth, std::string const& open, std::string const& value, std::string const& close) {
+        std::string text;
+        for (int i = 0; i < depth; i++) text += open;
+        text += value;
+        for (int i = 0; i < depth; i++) text += close;
+        return text;
+    };
+
+    SECTION( "tree walkers do not recurse" ) {
+        const int depth = 100000;
+        HTree * root = new HTree();
+        HTree * curr = root;
+        for (int i = 0; i < depth; i++) {
+            HTree * next = new HTree();
+            curr->addMember("a", next);
+            curr = next;
+        }
+        curr->addMember("v", new HSimpleValue(std::string("leaf"), std::vector<Token>{Token(UNQUOTED_STRING, "leaf", std::string("leaf"), 1)}, 1));
+        REQUIRE(curr->getPath().size() == depth);
+        REQUIRE(root->getUnresolvedSubs().empty());
+
+        HTree * copy = root->deepCopy();
+        root->mergeTrees(copy);
+        std::string out;
+        HWriter(out, RENDER_JSON_COMPACT).write(copy);
+        REQUIRE(out == nested(depth, "{\"a\":", "{\"v\":\"leaf\"}", "}"));
+        delete copy;
+        delete root;
+    }
+
+    SECTION( "documents within the limit load" ) {
+        writeTestFile("deep.conf", "a " + nested(DEFAULT_MAX_DEPTH - 1, "{ a ", "= 1", " }"));
+        ConfigFile file = ConfigFile(std::string("deep.conf"));
+        REQUIRE(file.load().ok());
+        std::string path = "a";
+        for (int i = 1; i < DEFAULT_MAX_DEPTH; i++) path += ".a";
+        REQUIRE(file.getIntByPath(path) == 1);
+        REQUIRE(file.getMemoryUsage().bytes[MEM_STACK] == 0);
+    }
+
+    SECTION( "arrays, substitutions, json and streamed documents nest thousands of levels" ) {
+        const int depth = 5000;
+        writeTestFile("deep.conf", "x = 1\na = " + nested(depth, "[", "${x}", "]") + "\nb " + nested(depth, "{ a ", "= ${x}", " }"));
+        ConfigFile file = ConfigFile(std::string("deep.conf"));
+        REQUIRE(file.load().ok());
+        std::string path = "b";
+        for (int i = 0; i < depth; i++) path += ".a";
+        REQUIRE(file.getIntByPath(path) == 1);
+        std::ostringstream rendered;
+        file.render(rendered, RENDER_JSON_COMPACT);
+        REQUIRE(rendered.str().find(nested(depth, "[", "1", "]")) != std::string::npos);
+
+        writeTestFile("deep.json", nested(depth, "{\"a\":", "1", "}"));
+        ConfigFile json = ConfigFile((char *) "deep.json", JSON);
+        REQUIRE(json.load().ok());
+        REQUIRE(json.getIntByPath(path.substr(2)) == 1);
+
+        RecordingHandler handler;
+        HEventParser parser(handler, SUBSTITUTIONS_REPORT);
+        REQUIRE(parser.parseString(nested(depth, "a { ", "b = [[1]]", " }")));
+        REQUIRE(std::count(handler.events.begin(), handler.events.end(), "end") == depth + 3);
+    }
+
+    SECTION( "deeper documents fail with a single diagnostic" ) {
+        writeTestFile("deep.conf", "a " + nested(50, "{ a ", "= [1]", " }"));
+        ConfigFile file = ConfigFile(std::string("deep.conf"));
+        file.setMaxDepth(50);
+        LoadResult result = file.load();
+        REQUIRE(result.status == LOAD_INVALID);
+        REQUIRE(result.diagnostics.size() == 1);
+        REQUIRE(result.diagnostics[0].message == "objects and arrays are nested deeper than 50 levels");
+        file.setMaxDepth(51);
+        REQUIRE(file.load().ok());
+
+        writeTestFile("deep.json", nested(60, "[", "1", "]"));
+        ConfigFile json = ConfigFile((char *) "deep.json", JSON);
+        json.setMaxDepth(50);
+        result = json.load();
+        REQUIRE(result.status == LOAD_INVALID);
+        REQUIRE(result.diagnostics.size() == 1);
+        REQUIRE(result.diagnostics[0].code == DIAG_JSON);
+
+        RecordingHandler handler;
+        HEventParser parser(handler, SUBSTITUTIONS_REPORT);
+        parser.setMaxDepth(50);
+        REQUIRE_FALSE(parser.parseString(nested(60, "a { ", "b = 1", " }")));
+        REQUIRE(handler.events.back() == "error");
+    }
+
+    SECTION( "an include cycle fails with a single diagnostic" ) {
+        writeTestFile("cycle.conf", "a { include file(\"cycle.conf\") }");
+        ConfigFile file = ConfigFile(std::string("cycle.conf"));
+        LoadResult result = file.load();
+        REQUIRE(result.status == LOAD_INVALID);
+        REQUIRE(result.diagnostics.size() == 1);
+        REQUIRE(result.diagnostics[0].code == DIAG_INCLUDE);
+        REQUIRE(result.diagnostics[0].message.find("nested more than 50 levels") != std::string::npos);
+
+        RecordingHandler handler;
+        HEventParser parser(handler, SUBSTITUTIONS_REPORT);
+        REQUIRE_FALSE(parser.parseFile("cycle.conf"));
+        REQUIRE(handler.events.back() == "error");
+    }
+}
+
+TEST_CASE( "Parallel includes" ) {
+    ScratchDirectory scratch;
+    std::string root = "base = 10\n";
+    for (int i = 0; i < 12; i++) {
+        std::string n = std::to_string(i);
+        writeTestFile("par_" + n + ".conf", "y = " + n + "\nz = ${base}\nleaf { include file(\"par_leaf" + n + ".conf\") }");
+        writeTestFile("par_leaf" + n + ".conf", "w = " + n + "\nv = [" + n + ", x]");
+        root += "m" + n + " { include file(\"par_" + n + ".conf\") }\nr" + n + " = ${m" + n + ".y}\ns" + n + " = ${m" + n + ".leaf.v}\n";
+    }
+    root += "opt { include file(\"par_missing.conf\") }\n";
+    writeTestFile("par_root.conf", root);
+
+    SECTION( "same configuration and counters as reading includes in place" ) {
+        ConfigFile sequential((char *) "par_root.conf");
+        sequential.setParallelIncludes(false);
+        sequential.setStatsEnabled(true);
+        ConfigFile parallel((char *) "par_root.conf");
+        parallel.setStatsEnabled(true);
+        REQUIRE(sequential.load().ok());
+        REQUIRE(parallel.load().ok());
+        std::ostringstream expected, actual;
+        sequential.render(expected, RENDER_JSON);
+        parallel.render(actual, RENDER_JSON);
+        REQUIRE(actual.str() == expected.str());
+        REQUIRE(parallel.getIntByPath("r7") == 7);
+        REQUIRE(parallel.getIntByPath("m7.leaf.w") == 7);
+        REQUIRE(parallel.getIntByPath("m3.z") == 10);
+        REQUIRE(parallel.getIncludedFiles() == sequential.getIncludedFiles());
+        for (int c = 0; c < COUNTER_COUNT; c++) {
+            REQUIRE(parallel.getStats().counters[c] == sequential.getStats().counters[c]);
+        }
+        int includeParses = 0;
+        for (auto const& event : parallel.getStats().events) {
+            includeParses += event.phase == PHASE_INCLUDE_PARSE;
+        }
+        REQUIRE(includeParses == 24);
+    }
+
+    SECTION( "errors in includes are reported in source order" ) {
+        writeTestFile("par_bad_root.conf", "a { include file(\"par_bad1.conf\") }\nb { include required(file(\"par_absent.conf\")) }\nc { include file(\"par_bad2.conf\") }");
+        writeTestFile("par_bad1.conf", "x = 1\n, = 3");
+        writeTestFile("par_bad2.conf", "z = \"open");
+        ConfigFile sequential((char *) "par_bad_root.conf");
+        sequential.setParallelIncludes(false);
+        ConfigFile parallel((char *) "par_bad_root.conf");
+        LoadResult expected = sequential.load();
+        LoadResult actual = parallel.load();
+        REQUIRE(!actual.ok());
+        REQUIRE(actual.diagnostics.size() >= 3);
+        REQUIRE(actual.diagnostics.size() == expected.diagnostics.size());
+        for (size_t i = 0; i < actual.diagnostics.size(); i++) {
+            REQUIRE(actual.diagnostics[i].str() == expected.diagnostics[i].str());
+            REQUIRE(actual.diagnostics[i].offset == expected.diagnostics[i].offset);
+        }
+        REQUIRE(actual.diagnostics.front().file == "par_bad1.conf");
+        REQUIRE(actual.diagnostics.back().file == "par_bad2.conf");
+    }
+
+    SECTION( "an exception thrown by an include reaches the loading thread" ) {
+        writeTestFile("par_big.conf", "x = 30000000000");
+        writeTestFile("par_big_root.conf", "a { include file(\"par_big.conf\") }");
+        writeTestFile("par_big_nested.conf", "a { include file(\"par_big_root.conf\") }\nb { include file(\"par_0.conf\") }");
+        ConfigFile sequential((char *) "par_big_root.conf");
+        sequential.setParallelIncludes(false);
+        REQUIRE_THROWS_AS(sequential.load(), std::out_of_range);
+        ConfigFile parallel((char *) "par_big_root.conf");
+        REQUIRE_THROWS_AS(parallel.load(), std::out_of_range);
+        ConfigFile nested((char *) "par_big_nested.conf");
+        REQUIRE_THROWS_AS(nested.load(), std::out_of_range);
+    }
+
+    SECTION( "any pool size gives the same tree" ) {
+        HParser reference = initWithString(root);
+        reference.parseTokens();
+        reference.resolveSubstitutions();
+        std::string expected = std::get<HTree*>(reference.rootObject)->str();
+        for (unsigned threads : {0u, 1u, 4u}) {
+            IncludePool pool(threads);
+            HParser parser = initWithString(root);
+            parser.includePool = &pool;
+            parser.parseTokens();
+            REQUIRE(parser.prefetched.empty());
+            parser.resolveSubstitutions();
+            REQUIRE(parser.validConf);
+            REQUIRE(std::get<HTree*>(parser.rootObject)->str() == expected);
+            REQUIRE(parser.dependencies.size() == reference.dependencies.size());
+            delete std::get<HTree*>(parser.rootObject);
+        }
+        delete std::get<HTree*>(reference.rootObject);
+    }
+
+    SECTION( "includes the parser never reaches are discarded" ) {
+        IncludePool pool(2);
+        HParser parser = initWithString("{ a = 1 }\nb { include file(\"par_0.conf\") }\nc { include file(\"par_1.conf\") }");
+        std::vector<Diagnostic> diagnostics;
+        parser.diagnostics = &diagnostics;
+        parser.includePool = &pool;
+        parser.parseTokens();
+        REQUIRE(!parser.validConf);
+        REQUIRE(diagnostics.size() == 1);
+        REQUIRE(parser.prefetched.empty());
+        REQUIRE(parser.dependencies.empty());
+        delete std::get<HTree*>(parser.rootObject);
+    }
+
+    SECTION( "a task runs once, on the pool or in the thread waiting for it" ) {
+        IncludePool pool(0);
+        int runs = 0;
+        std::shared_ptr<IncludeTask> task = pool.submit([&runs] { runs++; });
+        task->wait();
+        task->wait();
+        REQUIRE(runs == 1);
+        std::shared_ptr<IncludeTask> cancelled = pool.submit([&runs] { runs++; });
+        REQUIRE(cancelled->cancel());
+        cancelled->wait();
+        REQUIRE(!task->cancel());
+        REQUIRE(runs == 1);
+    }
+}
+
+/*
+    Reader recording the most of its reads that were in flight at once. They run on a pool without threads, so each
+    one only finishes when the parser waits for it, however loaded the machine is.
+*/
+class InFlightReader : public FileReader {
+    private:
+        ThreadFileReader inner{0};
+        std::mutex mutex;
+        std::vector<std::shared_ptr<FileRead>> started;
+    public:
+        size_t peak = 0;
+        std::vector<std::shared_ptr<FileRead>> readAll(std::vector<std::string> const& paths) override {
+            std::vector<std::shared_ptr<FileRead>> reads = inner.readAll(paths);
+            std::lock_guard<std::mutex> lock(mutex);
+            started.erase(std::remove_if(started.begin(), started.end(), [](auto& read) { return read->ready(); }), started.end());
+            started.insert(started.end(), reads.begin(), reads.end());
+            peak = std::max(peak, started.size());
+            return reads;
+        }
+        const char * name() const override {
+            return "in flight";
+        }
+};
+
+TEST_CASE( "Include file readers" ) {
+    ScratchDirectory scratch;
+    std::string root;
+    for (int i = 0; i < 10; i++) {
+        std::string n = std::to_string(i);
+        writeTestFile("rd_" + n + ".conf", "x = " + n);
+        root += "m" + n + " { include file(\"rd_" + n + ".conf\") }\n";
+    }
+    root += "opt { include file(\"rd_missing.conf\") }\n";
+    writeTestFile("rd_root.conf", root);
+    writeTestFile("rd_empty.conf", "");
+    writeTestFile("rd_large.conf", std::string(1 << 20, 'a'));
+
+    SECTION( "every reader returns what a blocking read does" ) {
+        std::vector<std::unique_ptr<FileReader>> readers;
+        readers.push_back(std::make_unique<ThreadFileReader>(4));
+        if (std::unique_ptr<UringFileReader> uring = UringFileReader::create()) {
+            readers.push_back(std::move(uring));
+        }
+        for (auto& reader : readers) {
+            std::vector<std::string> paths{"rd_3.conf", "rd_missing.conf", "rd_empty.conf", "rd_large.conf"};
+            std::vector<std::shared_ptr<FileRead>> reads = reader->readAll(paths);
+            REQUIRE(reads.size() == paths.size());
+            for (size_t i = 0; i < reads.size(); i++) {
+                reads[i]->wait();
+                REQUIRE(reads[i]->path == paths[i]);
+                REQUIRE(reads[i]->stamp == getIncludeStamp(paths[i]));
+            }
+            REQUIRE(reads[0]->opened);
+            REQUIRE(reads[0]->content == "x = 3");
+            REQUIRE(!reads[1]->opened);
+            REQUIRE(reads[1]->content.empty());
+            REQUIRE(reads[2]->opened);
+            REQUIRE(reads[2]->content.empty());
+            REQUIRE(reads[3]->content == std::string(1 << 20, 'a'));
+        }
+    }
+
+    SECTION( "files without a size, and short reads, are read to the end" ) {
+        std::vector<std::unique_ptr<FileReader>> readers;
+        readers.push_back(std::make_unique<ThreadFileReader>(1));
+        if (std::unique_ptr<UringFileReader> uring = UringFileReader::create()) {
+            readers.push_back(std::move(uring));
+        }
+        std::ifstream version("/proc/version");
+        std::string expected((std::istreambuf_iterator<char>(version)), std::istreambuf_iterator<char>());
+        std::string piped;
+        for (int i = 0; i < 40; i++) {
+            piped += std::string(4096, 'a' + i % 26);
+        }
+        for (auto& reader : readers) {
+            std::shared_ptr<FileRead> proc = reader->read("/proc/version");
+            proc->wait();
+            REQUIRE(proc->opened);
+            REQUIRE(!proc->content.empty());
+            REQUIRE(proc->content == expected);
+
+            unlink("rd_fifo");
+            REQUIRE(mkfifo("rd_fifo", 0600) == 0);
+            std::shared_ptr<FileRead> fifo = reader->read("rd_fifo");
+            std::thread writer([&piped]() { // a pipe hands out what was written so far, so most reads come up short.
+                int fd = open("rd_fifo", O_WRONLY);
+                for (size_t at = 0; at < piped.size(); at += 4096) {
+                    if (write(fd, piped.data() + at, 4096) != 4096) {
+                        break; // the size check below fails.
+                    }
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                }
+                close(fd);
+            });
+            fifo->wait();
+            writer.join();
+            unlink("rd_fifo");
+            REQUIRE(fifo->opened);
+            REQUIRE(fifo->content.size() == piped.size());
+            REQUIRE(fifo->content == piped);
+        }
+    }
+
+    SECTION( "reads of a document's includes overlap" ) {
+        auto reader = std::make_shared<InFlightReader>();
+        ConfigFile file((char *) "rd_root.conf");
+        file.setParallelIncludes(false);
+        file.setFileReader(reader);
+        REQUIRE(file.load().ok());
+        REQUIRE(file.getIntByPath("m7.x") == 7);
+        REQUIRE(reader->peak > 1);
+        REQUIRE(reader->peak == 11); // every include of the document, the missing one too, before the first is spliced.
+    }
+}
+
+TEST_CASE( "Include resolvers" ) {
+    ScratchDirectory scratch;
+    writeTestFile("res_disk.conf", "y = disk");
+    writeTestFile("res_root.conf", "a { include \"common.conf\" }\nb { include file(\"res_disk.conf\") }\nc { include required(file(\"bundled.conf\")) }\nd = ${b.y}");
+    auto bundle = std::make_shared<MemoryResolver>();
+    bundle->add("common.conf", "x = 1\nlist = [1, 2]");
+    bundle->add("bundled.conf", "z = ${?x} \"bundle\"");
+
+    SECTION( "a memory bundle serves includes of any type, ahead of the disk" ) {
+        for (bool parallel : {false, true}) {
+            ConfigFile file((char *) "res_root.conf");
+            file.setParallelIncludes(parallel);
+            file.setIncludeResolvers(std::make_shared<ResolverChain>(std::vector<std::shared_ptr<IncludeResolver>>{bundle, std::make_shared<FileResolver>()}));
+            REQUIRE(file.load().ok());
+            REQUIRE(file.getIntByPath("a.x") == 1);
+            REQUIRE(file.getStringByPath("b.y") == "disk");
+            REQUIRE(file.getStringByPath("d") == "disk");
+            REQUIRE(file.getStringByPath("c.z") == "bundle");
+            REQUIRE(file.getIncludedFiles() == std::vector<std::string>{"res_disk.conf"}); // bundled includes are not watched.
+        }
+        auto overlay = std::make_shared<MemoryResolver>();
+        overlay->add("res_disk.conf", "y = memory");
+        ConfigFile file((char *) "res_root.conf");
+        file.setIncludeResolvers(std::make_shared<ResolverChain>(std::vector<std::shared_ptr<IncludeResolver>>{overlay, bundle, std::make_shared<FileResolver>()}));
+        REQUIRE(file.load().ok());
+        REQUIRE(file.getStringByPath("b.y") == "memory");
+    }
+
+    SECTION( "an include no resolver accepts cannot be opened" ) {
+        ConfigFile file((char *) "res_root.conf");
+        file.setIncludeResolvers(std::make_shared<ResolverChain>(std::vector<std::shared_ptr<IncludeResolver>>{std::make_shared<FileResolver>()}));
+        LoadResult result = file.load();
+        REQUIRE(!result.ok());
+        REQUIRE(result.diagnostics.size() == 1);
+        REQUIRE(result.diagnostics[0].message.find("bundled.conf could not be opened") != std::string::npos);
+    }
+
+    SECTION( "the default chain reads files in place and skips heuristic includes" ) {
+        HParser parser = initWithString("a { include \"res_disk.conf\" }\nb { include file(\"res_disk.conf\") }");
+        parser.parseTokens();
+        parser.resolveSubstitutions();
+        HParser expected = initWithString("b { y = disk }");
+        expected.parseTokens();
+        REQUIRE(parser.validConf);
+        REQUIRE(parser.dependencies.size() == 1);
+        REQUIRE(std::get<HTree*>(parser.rootObject)->str() == std::get<HTree*>(expected.rootObject)->str());
+        delete std::get<HTree*>(parser.rootObject);
+        delete std::get<HTree*>(expected.rootObject);
+    }
+
+    SECTION( "an inline reader reads the file when it is first waited for" ) {
+        InlineFileReader reader;
+        writeTestFile("res_late.conf", "before");
+        std::shared_ptr<FileRead> read = reader.read("res_late.conf");
+        writeTestFile("res_late.conf", "after");
+        read->wait();
+        REQUIRE(read->opened);
+        REQUIRE(read->content == "after");
+        REQUIRE(read->stamp == getIncludeStamp("res_late.conf"));
+    }
+}
+
+#ifdef HOCON_CURL
+/*
+    Stand-in HTTP/1.1 server on a loopback port, one thread per connection, keeping connections alive. /conf answers
+    with an ETag, and a 304 to a request that sends it back; /slow?ms=N answers after N milliseconds; any other path
+    is a 404.
+*/
+class LocalHttpServer {
+    private:
+        int listener = -1;
+        std::atomic<bool> stopping{false};
+        std::thread acceptor;
+        std::mutex mutex;
+        std::vector<int> clients;
+        std::vector<std::thread> handlers;
+
+        void serve(int client) {
+            std::string pending;
+            char buffer[4096];
+            while (true) {
+                size_t end = pending.find("\r\n\r\n");
+                if (end == std::string::npos) {
+                    ssize_t got = recv(client, buffer, sizeof(buffer), 0);
+                    if (got <= 0) {
+                        return;
+                    }
+                    pending.append(buffer, got);
+                    continue;
+                }
+                std::string head = pending.substr(0, end);
+                pending.erase(0, end + 4);
+                requests++;
+                std::string path = head.substr(head.find(' ') + 1);
+                path = path.substr(0, path.find(' '));
+                std::string status = "404 Not Found", headers, body = "missing";
+                if (path == "/conf" && head.find("If-None-Match: \"v1\"") != std::string::npos) {
+                    notModified++;
+                    status = "304 Not Modified";
+                    body = "";
+                } else if (path == "/conf") {
+                    status = "200 OK";
+                    headers = "ETag: \"v1\"\r\n";
+                    body = "x = 7\nname = remote";
+                } else if (path.rfind("/slow?ms=", 0) == 0) {
+                    auto until = std::chrono::steady_clock::now() + std::chrono::milliseconds(std::stoi(path.substr(9)));
+                    while (std::chrono::steady_clock::now() < until && !stopping) {
+                        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+                    }
+                    status = "200 OK";
+                    body = "slow = true";
+                }
+                std::string response = "HTTP/1.1 " + status + "\r\n" + headers + "Content-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+                if (send(client, response.data(), response.size(), MSG_NOSIGNAL) != (ssize_t) response.size()) {
+                    return;
+                }
+            }
+        }
+    public:
+        int port = 0;
+        std::atomic<int> connections{0};
+        std::atomic<int> requests{0};
+        std::atomic<int> notModified{0};
+
+        LocalHttpServer() {
+            listener = socket(AF_INET, SOCK_STREAM, 0);
+            sockaddr_in address{};
+            address.sin_family = AF_INET;
+            address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            socklen_t length = sizeof(address);
+            bind(listener, (sockaddr *) &address, length);
+            listen(listener, 16);
+            getsockname(listener, (sockaddr *) &address, &length);
+            port = ntohs(address.sin_port);
+            acceptor = std::thread([this]() {
+                while (true) {
+                    int client = accept(listener, nullptr, nullptr);
+                    if (client < 0) {
+                        return;
+                    }
+                    connections++;
+                    std::lock_guard<std::mutex> lock(mutex);
+                    clients.push_back(client);
+                    handlers.emplace_back(&LocalHttpServer::serve, this, client);
+                }
+            });
+        }
+
+        ~LocalHttpServer() {
+            stopping = true;
+            shutdown(listener, SHUT_RDWR);
+            acceptor.join();
+            close(listener);
+            for (int client : clients) {
+                shutdown(client, SHUT_RDWR);
+            }
+            for (auto& handler : handlers) {
+                handler.join();
+            }
+            for (int client : clients) {
+                close(client);
+            }
+        }
+
+        std::string url(std::string const& path) const {
+            return "http://127.0.0.1:" + std::to_string(port) + path;
+        }
+};
+
+TEST_CASE( "HTTP includes" ) {
+    ScratchDirectory scratch;
+    LocalHttpServer server;
+
+    SECTION( "an url include loads through the fetcher" ) {
+        writeTestFile("http_root.conf", "remote { include url(\"" + server.url("/conf") + "\") }\nr = ${remote.x}\nopt { include url(\"" + server.url("/none") + "\") }");
+        for (bool parallel : {false, true}) {
+            ConfigFile file((char *) "http_root.conf");
+            file.setParallelIncludes(parallel);
+            file.setHttpFetcher(std::make_shared<HttpFetcher>());
+            REQUIRE(file.load().ok());
+            REQUIRE(file.getIntByPath("r") == 7);
+            REQUIRE(file.getStringByPath("remote.name") == "remote");
+        }
+    }
+
+    SECTION( "an unchanged include costs a 304" ) {
+        HttpFetcher fetcher;
+        std::shared_ptr<FileRead> first = fetcher.read(server.url("/conf"));
+        first->wait();
+        std::shared_ptr<FileRead> second = fetcher.read(server.url("/conf"));
+        second->wait();
+        REQUIRE(first->opened);
+        REQUIRE(second->opened);
+        REQUIRE(second->content == first->content);
+        REQUIRE(second->content == "x = 7\nname = remote");
+        REQUIRE(server.notModified == 1);
+        REQUIRE(fetcher.notModifiedCount() == 1);
+    }
+
+    SECTION( "fetches reuse the connection" ) {
+        HttpFetcher fetcher;
+        for (int i = 0; i < 5; i++) {
+            std::shared_ptr<FileRead> read = fetcher.read(server.url("/none"));
+            read->wait();
+        }
+        REQUIRE(server.requests == 5);
+        REQUIRE(server.connections == 1);
+    }
+
+    SECTION( "fetches of one batch overlap" ) {
+        HttpFetcher fetcher;
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::shared_ptr<FileRead>> reads = fetcher.readAll(std::vector<std::string>(4, server.url("/slow?ms=200")));
+        for (auto& read : reads) {
+            read->wait();
+            REQUIRE(read->opened);
+            REQUIRE(read->content == "slow = true");
+        }
+        REQUIRE(std::chrono::steady_clock::now() - start < std::chrono::milliseconds(600));
+    }
+
+    SECTION( "a fetch fails at the total timeout" ) {
+        HttpOptions options;
+        options.totalTimeoutMs = 100;
+        HttpFetcher fetcher(options);
+        auto start = std::chrono::steady_clock::now();
+        std::shared_ptr<FileRead> read = fetcher.read(server.url("/slow?ms=3000"));
+        read->wait();
+        REQUIRE(!read->opened);
+        REQUIRE(read->content.empty());
+        REQUIRE(std::chrono::steady_clock::now() - start < std::chrono::milliseconds(1500));
+    }
+
+    SECTION( "an error response is not an include" ) {
+        HttpFetcher fetcher;
+        std::shared_ptr<FileRead> read = fetcher.read(server.url("/none"));
+        read->wait();
+        REQUIRE(!read->opened);
+        REQUIRE(read->content.empty());
+        writeTestFile("http_required.conf", "a { include required(url(\"" + server.url("/none") + "\")) }");
+        ConfigFile file((char *) "http_required.conf");
+        file.setHttpFetcher(std::make_shared<HttpFetcher>());
+        REQUIRE(!file.load().ok());
+    }
+}
+#endif
+
 HSimpleValue * debug_create_simple_string(std::string str) {
     Token t = Token(UNQUOTED_STRING, str, str, 0);
     return new HSimpleValue(str, std::vector<Token>{t}, 0);